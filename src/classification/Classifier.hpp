@@ -23,6 +23,7 @@
 #include "MisclassificationCostMatrix.hpp"
 #include "Instance.hpp"
 #include "Dataset.hpp"
+#include "DatasetView.hpp"
 #include "CLI.hpp"
 
 class Classifier {
@@ -45,15 +46,36 @@ public:
   bool learned() { return this->learned_class.empty(); }
 
   // public mutators
-  virtual void learn(const Dataset &training_instances,
+  /**
+   * \brief learn from the given instances; att_mask has one entry per
+   *        attribute in the view, and only attributes whose entry is true
+   *        are used (the class attribute never is).
+   */
+  virtual void learn(const DatasetView &training_instances,
                      const std::string &class_label,
-                     const std::set<size_t> &ig_insts = std::set<size_t>(),
-                     const std::set<std::string> &ig_atts =\
-                       std::set<std::string>()) = 0;
+                     const std::vector<bool> &att_mask) = 0;
+  void learn(const DatasetView &training_instances,
+             const std::string &class_label,
+             const std::set<std::string> &ig_atts = std::set<std::string>()) {
+    this->learn(training_instances, class_label,
+                training_instances.get_attribute_mask(ig_atts));
+  }
   virtual void set_classifier_specific_options(Commandline &cmd) = 0;
   virtual void clear() = 0;
 protected:
   std::string learned_class;
+
+  // protected inspectors
+  static void check_attribute_mask(const DatasetView &training_instances,
+                                   const std::vector<bool> &att_mask) {
+    if (att_mask.size() != training_instances.num_attributes()) {
+      std::stringstream ss;
+      ss << "attribute mask has " << att_mask.size() << " entries, but "
+         << "dataset has " << training_instances.num_attributes()
+         << " attributes";
+      throw CognoscoError(ss.str());
+    }
+  }
 };
 
 #endif
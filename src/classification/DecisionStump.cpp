@@ -23,6 +23,7 @@
 #include <cassert>
 #include <sstream>
 #include <set>
+#include <cmath>
 
 // local Cognosco includes
 #include "DecisionStump.hpp"
@@ -38,7 +39,7 @@ using std::set;
 
 string
 Classifiers::DecisionStump::to_string() const {
-  if (this->learned_class.empty() || this->rule == NULL)
+  if (this->learned_class.empty() || !this->rule)
     return "[UNTRAINED DecisionStump CLASSIFIER]";
 
   return this->rule->to_string();
@@ -53,7 +54,7 @@ double
 Classifiers::DecisionStump::class_probability(const Instance &test_instance,
                                               const string &class_label,
                                               const set<string> &exclude_atts) const {
-  if (this->rule == NULL) {
+  if (!this->rule) {
     throw DecisionStumpError("not trained");
   }
   if (this->rule->get_predicted_label() == class_label)
@@ -62,22 +63,45 @@ Classifiers::DecisionStump::class_probability(const Instance &test_instance,
     return 1 - this->rule->get_prob(test_instance);
 }
 
+/**
+ * \brief compute the expected misclassification cost of the given rule over
+ *        a dataset; cost_table is indexed by the codes of the class labels in
+ *        the dataset (see MisclassificationCostMatrix::get_cost_table).
+ * \throw DecisionStumpError if the cost of a prediction the rule can make
+ *        for an instance in the dataset isn't in the table.
+ */
 double
-Classifiers::DecisionStump::get_cost(const Dataset &d,
-                                     const std::set<size_t> &ig_instance_ids) const {
+Classifiers::DecisionStump::get_cost(const DatasetView &d,
+                                     const BinaryDecisionRule &r,
+                                     const vector<vector<double> > &cost_table) const {
+  const Column &class_col =\
+    d.get_column(d.get_attribute_index(r.get_class_attribute_name()));
+  const Column &att_col =\
+    d.get_column(d.get_attribute_index(r.get_attribute_name()));
+  uint32_t predicted_code, other_code;
+  if (!class_col.find_code(r.get_predicted_label(), predicted_code) ||
+      !class_col.find_code(r.get_other_label(), other_code)) {
+    throw DecisionStumpError("rule predicts class that isn't in dataset: " +
+                             r.to_string());
+  }
+
   double cost = 0;
-  for (auto inst_it = d.begin(); inst_it != d.end(); ++inst_it) {
-    size_t inst_id = inst_it->get_instance_id();
-    if (ig_instance_ids.find(inst_id) != ig_instance_ids.end()) continue;
-    string actual_class((*inst_it)[this->rule->get_class_attribute_name()]->to_string());
-    string predicted_label(this->rule->get_predicted_label());
-    string other_label(this->rule->get_other_label());
-    double pr_pos_class = this->rule->get_prob(*inst_it);
-
-    auto act_pred_pair = std::make_pair(actual_class, predicted_label);
-    auto act_other_pair = std::make_pair(actual_class, other_label);
-    cost += (pr_pos_class * cost_matrix[act_pred_pair]);
-    cost += ((1-pr_pos_class) * cost_matrix[act_other_pair]);
+  for (size_t i = 0; i < d.size(); ++i) {
+    const size_t row = d.get_row(i);
+    const uint32_t actual_code = class_col.get_code(row);
+    const double pred_cost = cost_table[actual_code][predicted_code];
+    const double other_cost = cost_table[actual_code][other_code];
+    if (std::isnan(pred_cost) || std::isnan(other_cost)) {
+      throw DecisionStumpError("no misclassification cost for actual class " +
+                               class_col.decode(actual_code) +
+                               " and predicted class " +
+                               (std::isnan(pred_cost) ?
+                                r.get_predicted_label() :
+                                r.get_other_label()));
+    }
+    double pr_pos_class = r.get_prob(att_col.get_numeric(row));
+    cost += (pr_pos_class * pred_cost);
+    cost += ((1-pr_pos_class) * other_cost);
   }
   return cost;
 }
@@ -88,73 +112,76 @@ Classifiers::DecisionStump::get_cost(const Dataset &d,
  *****************************************************************************/
 
 void
-Classifiers::DecisionStump::learn(const Dataset &train_insts,
+Classifiers::DecisionStump::learn(const DatasetView &train_insts,
                                   const string &class_label,
-                                  const set<size_t> &ignore_inst_ids,
-                                  const set<string> &ig_atts) {
+                                  const vector<bool> &att_mask) {
   const bool DEBUG = false;
   this->clear();
+  check_attribute_mask(train_insts, att_mask);
 
-  set<string> class_labels;
-  string pos_class_lab = "";
-  string neg_class_lab = "";
-  for (auto inst_it = train_insts.begin(); inst_it != train_insts.end(); ++inst_it) {
-    string val = (*inst_it)[class_label]->to_string();
-    if (DEBUG)
-      std::cerr << "examining instance with class " << val << std::endl;
-    class_labels.insert(val);
-    if (pos_class_lab.empty()) {
-      if (DEBUG)
-        std::cerr << "selected " << val << " as positive class" << std::endl;
-      pos_class_lab = val;
-    } else if (neg_class_lab.empty() && val != pos_class_lab) {
-      if (DEBUG)
-        std::cerr << "selected " << val << " as negative class" << std::endl;
-      neg_class_lab = val;
-    }
+  const size_t class_k = train_insts.get_attribute_index(class_label);
+  const Column &class_col = train_insts.get_column(class_k);
+  if (class_col.get_type() != NOMINAL) {
+    throw DecisionStumpError("class attribute " + class_label +
+                             " is not nominal");
   }
-  assert(pos_class_lab != neg_class_lab);
-
-  if (class_labels.size() != 2) {
+  if (class_col.num_labels() != 2) {
     std::stringstream ss;
-    ss << "expected two classes, found " << class_labels.size();
+    ss << "expected two classes, found " << class_col.num_labels();
     throw DecisionStumpError(ss.str());
   }
 
-  BinaryDecisionRule *candidate;
-  for (auto at_it = train_insts.begin_attributes(); at_it != train_insts.end_attributes(); ++at_it) {
-    Attribute* at_ptr (*at_it);
-    string att_name (at_ptr->get_name());
+  if (train_insts.size() == 0)
+    throw DecisionStumpError("cannot learn from an empty dataset");
 
-    if (att_name == class_label || (ig_atts.find(att_name) != ig_atts.end())) continue;
-
-    for (auto inst_it = train_insts.begin(); inst_it != train_insts.end(); ++inst_it) {
-      size_t inst_id (inst_it->get_instance_id());
-      if (ignore_inst_ids.find(inst_id) != ignore_inst_ids.end()) continue;
-
-      // nasty hack to make double
-      const AttributeOccurrence* att_occ_ptr((*inst_it)[att_name]);
-      double at_value ((*att_occ_ptr) * 1.0);
+  // the positive class is the one the first instance has
+  const uint32_t pos_code = class_col.get_code(train_insts.get_row(0));
+  const string pos_class_lab = class_col.decode(pos_code);
+  const string neg_class_lab = class_col.decode(1 - pos_code);
+  if (DEBUG) {
+    std::cerr << "selected " << pos_class_lab << " as positive class and "
+              << neg_class_lab << " as negative class" << std::endl;
+  }
+  const vector<vector<double> > cost_table =\
+    this->cost_matrix.get_cost_table(class_col);
+
+  double best_cost = 0;
+  for (size_t k = 0; k < train_insts.num_attributes(); ++k) {
+    if ((k == class_k) || !att_mask[k]) continue;
+    const string &att_name =\
+      train_insts.get_attribute_description_ptr(k)->get_name();
+
+    const Column &att_col = train_insts.get_column(k);
+    for (size_t i = 0; i < train_insts.size(); ++i) {
+      if (att_col.get_type() != NUMERIC) {
+        std::stringstream ss;
+        ss << "multiplication by double for attribute " << att_name
+           << " undefined";
+        throw CognoscoError(ss.str());
+      }
+      double at_value (att_col.get_numeric(train_insts.get_row(i)));
 
       // if att_name > thresh --> pos_class
-      candidate = new BinaryDecisionRule(class_label, pos_class_lab,
-                                         neg_class_lab, att_name, at_value);
-      if (this->rule == NULL) {
-        this->rule = candidate;
-      } else {
-        double old_cost = this->get_cost(train_insts);
-        std::swap(this->rule, candidate);
-        if (this->get_cost(train_insts) >= old_cost) std::swap(this->rule, candidate);
-        delete candidate;
+      BinaryDecisionRule candidate(class_label, pos_class_lab, neg_class_lab,
+                                   att_name, at_value);
+      double candidate_cost = this->get_cost(train_insts, candidate,
+                                             cost_table);
+      if (!this->rule) {
+        this->rule.reset(new BinaryDecisionRule(candidate));
+        best_cost = candidate_cost;
+      } else if (candidate_cost < best_cost) {
+        *(this->rule) = candidate;
+        best_cost = candidate_cost;
       }
 
       // if att_name > thresh --> neg_class
-      candidate = new BinaryDecisionRule(class_label, neg_class_lab,
-                                         pos_class_lab, att_name, at_value);
-      double old_cost = this->get_cost(train_insts);
-      std::swap(this->rule, candidate);
-      if (this->get_cost(train_insts) >= old_cost) std::swap(this->rule, candidate);
-      delete candidate;
+      candidate = BinaryDecisionRule(class_label, neg_class_lab,
+                                     pos_class_lab, att_name, at_value);
+      candidate_cost = this->get_cost(train_insts, candidate, cost_table);
+      if (candidate_cost < best_cost) {
+        *(this->rule) = candidate;
+        best_cost = candidate_cost;
+      }
     }
   }
   this->learned_class = class_label;
@@ -167,9 +194,6 @@ Classifiers::DecisionStump::set_classifier_specific_options(Commandline &cmdline
 
 void
 Classifiers::DecisionStump::clear() {
-  if (this->rule != NULL) {
-    delete this->rule;
-    this->rule = NULL;
-  }
+  this->rule.reset();
   this->learned_class = "";
 }
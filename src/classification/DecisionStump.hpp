@@ -25,6 +25,8 @@
 #include <string>
 #include <vector>
 #include <unordered_map>
+#include <memory>
+#include <utility>
 
 // local Cognosco includes
 #include "CLI.hpp"
@@ -64,18 +66,20 @@ namespace Classifiers {
                        const double thresh) :
                     class_att_name (cls_name), predicted_label (predicted_label),
                     other_label(other_label), att_name(att_name), thresh(thresh) {};
-    BinaryDecisionRule(const BinaryDecisionRule &bcr) :
-      class_att_name(bcr.class_att_name), predicted_label(bcr.predicted_label),
-      other_label(bcr.other_label),
-      att_name(bcr.att_name), thresh(bcr.thresh) {};
 
     // public inspectors
     double get_prob(const Instance &inst) const {
-      const AttributeOccurrence *att_oc_ptr = inst[att_name];
+      const AttributeOccurrence att_oc = inst[att_name];
       // nasty hack tog et double...
-      if (((*att_oc_ptr) * 1.0) > thresh) return 1.0;
+      return this->get_prob(att_oc * 1.0);
+    }
+    double get_prob(const double att_value) const {
+      if (att_value > thresh) return 1.0;
       else return 0.0;
     }
+    const std::string &get_attribute_name() const {
+      return att_name;
+    }
     const std::string &get_class_attribute_name() const {
       return class_att_name;
     }
@@ -106,13 +110,20 @@ namespace Classifiers {
     // constructors
     using Classifier::Classifier;
     DecisionStump() :
-      rule(NULL), cost_matrix(MisclassificationCostMatrix()) {}
+      cost_matrix(MisclassificationCostMatrix()) {}
     DecisionStump(const DecisionStump &ds) :
-      rule(new BinaryDecisionRule((*ds.rule))),
-      cost_matrix(MisclassificationCostMatrix(ds.cost_matrix)) {};
+      Classifier(ds),
+      rule(ds.rule ? new BinaryDecisionRule(*(ds.rule)) : NULL),
+      cost_matrix(ds.cost_matrix) {};
+    DecisionStump(DecisionStump &&ds) = default;
     DecisionStump(const MisclassificationCostMatrix &m) :
-      rule(NULL), cost_matrix(m) {}
-    ~DecisionStump() { delete rule; }
+      cost_matrix(m) {}
+    DecisionStump& operator=(const DecisionStump &ds) {
+      DecisionStump tmp(ds);
+      this->swap(tmp);
+      return *this;
+    }
+    DecisionStump& operator=(DecisionStump &&ds) = default;
 
     // public inspectors
     std::string to_string() const;
@@ -123,20 +134,25 @@ namespace Classifiers {
     std::string usage() const;
 
     // public mutators
-    void learn(const Dataset &training_instances,
+    using Classifier::learn;
+    void learn(const DatasetView &training_instances,
                const std::string &class_label,
-               const std::set<size_t> &ignore_instance_ids = std::set<size_t>(),
-               const std::set<std::string> &ig_atts = std::set<std::string>());
+               const std::vector<bool> &att_mask);
     void set_classifier_specific_options(Commandline &cmdline);
     void clear();
+    void swap(DecisionStump &ds) {
+      std::swap(this->learned_class, ds.learned_class);
+      this->rule.swap(ds.rule);
+      std::swap(this->cost_matrix, ds.cost_matrix);
+    }
   private:
     // private instance variables
-    BinaryDecisionRule *rule;
+    std::unique_ptr<BinaryDecisionRule> rule;
     MisclassificationCostMatrix cost_matrix;
 
     // private inspectors
-    double get_cost(const Dataset &d, const std::set<size_t> &ig_instance_ids =\
-                    std::set<size_t>()) const;
+    double get_cost(const DatasetView &d, const BinaryDecisionRule &r,
+                    const std::vector<std::vector<double> > &cost_table) const;
   };
 }
 
@@ -20,6 +20,7 @@
 // stl includes
 #include <string>
 #include <vector>
+#include <algorithm>
 
 // local includes
 #include "Dataset.hpp"
@@ -51,6 +52,12 @@ get_cli() {
   cli.add_string_option("name-attribute", 'n', "the attribute which provides "
                         "the name of the instances");
   cli.add_size_option("k", 'k', "number of clusters to use", 2);
+  cli.add_boolean_option("symmetric", 'y', "the distances are symmetric, so "
+                         "only hold one of d(a, b) and d(b, a) when "
+                         "clustering", false);
+  cli.add_string_option("distance-storage", 'q', "precision to store "
+                        "distances at when clustering", set<string>{"double",
+                        "float", "quantized16", "quantized8"}, "double");
   return cli;
 }
 
@@ -59,33 +66,22 @@ get_cli() {
  *****************************************************************************/
 
 /**
- * convert a dataset that gives the distance
  * Instances in the intial dataset have  N + 2 attributes, where N of these
  * are distances to the other N instances in the dataset and the extra two are
  * the name of the instance and the class. The names must match the attributes.
- * A new dataset is constructed where each instance is described only by the
- * attributes named in medoids.
+ * Instances are to be described only by the attributes named in medoids; get
+ * the names of those attributes, plus the class, in dataset order.
  */
-static void
-build_new_dataset(const Dataset &exist_ds, Dataset &new_ds,
-                  const set<string> &medoids,
-                  const set<size_t> &ignore_inst_ids,
-                  const string &inst_name_att_name,
+static vector<string>
+medoid_attributes(const DatasetView &ds, const set<string> &medoids,
                   const string &class_label) {
-  new_ds = Dataset(exist_ds, ignore_inst_ids);
-
-  vector<string> att_names;
-  for (auto it = new_ds.begin_attributes(); it != new_ds.end_attributes(); ++it) {
-    Attribute* att_ptr = (*it);
-    att_names.push_back(att_ptr->get_name());
-  }
-
-  for (auto name : att_names) {
-    if (name == class_label) continue;
-    if (std::find(medoids.begin(), medoids.end(), name) == medoids.end()) {
-      new_ds.delete_attribute(name);
-    }
+  vector<string> res;
+  for (auto it = ds.begin_attributes(); it != ds.end_attributes(); ++it) {
+    const string &name = (*it)->get_name();
+    if ((name == class_label) || (medoids.find(name) != medoids.end()))
+      res.push_back(name);
   }
+  return res;
 }
 
 
@@ -103,50 +99,83 @@ Classifiers::KMedoids::to_string() const {
 }
 
 void
-Classifiers::KMedoids::learn(const Dataset &train_instances,
+Classifiers::KMedoids::learn(const DatasetView &train_instances,
                              const string &class_label,
-                             const set<size_t> &ignore_inst_ids,
-                             const set<string> &ig_atts) {
-  // need to know the value of the name_att for the instances to be ignored
+                             const vector<bool> &att_mask) {
+  check_attribute_mask(train_instances, att_mask);
+
+  // instances in the dataset that aren't part of the view we're learning
+  // from are held out; need to know the value of the name_att for them
   // so that when we encounter the attributes that give the distances to those
   // instances, we can skip those too.
+  const Dataset &full_ds = train_instances.get_dataset();
+  vector<bool> in_view(full_ds.size(), false);
+  for (auto row : train_instances.get_rows()) in_view[row] = true;
   set<string> ignore_inst_nms;
-  for (auto inst_id : ignore_inst_ids) {
-    const Instance &inst(train_instances[inst_id]);
-    ignore_inst_nms.insert(inst[this->name_att]->to_string());
+  for (size_t row = 0; row < full_ds.size(); ++row) {
+    if (in_view[row]) continue;
+    const Instance inst(&full_ds, row);
+    ignore_inst_nms.insert(inst[this->name_att].to_string());
   }
 
-  // convert the dataset into a distance matrix
+  // decide once which attributes give distances we can use; i.e. all except
+  // the class and name attributes, those masked out, and the distances to
+  // held-out instances. An instance whose distance attribute is masked out
+  // isn't a point to cluster, so it can't become a medoid.
+  const size_t class_k = train_instances.get_attribute_index(class_label);
+  const size_t name_k = train_instances.get_attribute_index(this->name_att);
+  vector<bool> is_distance(train_instances.num_attributes(), false);
+  for (size_t k = 0; k < train_instances.num_attributes(); ++k) {
+    if ((k == class_k) || (k == name_k) || !att_mask[k]) continue;
+    const string &att_name =\
+      train_instances.get_attribute_description_ptr(k)->get_name();
+    is_distance[k] = (ignore_inst_nms.find(att_name) == ignore_inst_nms.end());
+  }
+
+  // convert the dataset into a distance matrix, with a point for each
+  // distance attribute; the distance from a to b is the value of attribute
+  // a for the instance named b. Symmetric distances are condensed, so the
+  // value of b for a sets the same entry. The matrix is filled at double or
+  // single precision, and quantized once complete.
   std::cerr << "building distance matrix " << std::endl;
-  DistanceMatrix m;
-  size_t skipped = 0;
+  vector<string> inst_names;
+  for (auto it = train_instances.begin(); it != train_instances.end(); ++it)
+    inst_names.push_back((*it)[this->name_att].to_string());
   set<string> inst_ids_set;
-  for (auto it = train_instances.begin(); it != train_instances.end(); ++it) {
-    if (ignore_inst_ids.find(it->get_instance_id()) != ignore_inst_ids.end()) {
-      skipped += 1;
-      continue;
+  for (size_t k = 0; k < train_instances.num_attributes(); ++k) {
+    if (!is_distance[k] || inst_names.empty()) continue;
+    const string &att_name =\
+      train_instances.get_attribute_description_ptr(k)->get_name();
+    if (train_instances.get_column(k).get_type() != NUMERIC) {
+      std::stringstream ss;
+      ss << "multiplication by double for attribute " << att_name
+         << " undefined";
+      throw CognoscoError(ss.str());
     }
-
-    string name_att_val = it->get_att_occurrence(this->name_att)->to_string();
-    for (auto ait = it->begin(); ait != it->end(); ++ait) {
-      AttributeOccurrence* aoc_ptr = (*ait);
-      const string this_att_name(aoc_ptr->get_attribute_name());
-
-      // skip class and name attributes
-      if ((this_att_name == class_label) || (this_att_name == this->name_att) ||
-          (ignore_inst_nms.find(this_att_name) != ignore_inst_nms.end())) {
-        continue;
-      }
-
-      m[std::make_pair(this_att_name, name_att_val)] = ((*aoc_ptr) * 1.0);
-      inst_ids_set.insert(aoc_ptr->get_attribute_name());
+    inst_ids_set.insert(att_name);
+  }
+  vector<string> inst_ids;
+  std::copy(inst_ids_set.begin(), inst_ids_set.end(), std::back_inserter(inst_ids));
+  DistanceMatrix m(inst_ids, this->symmetric,
+                   (this->distance_storage == DOUBLE_STORAGE) ?
+                     DOUBLE_STORAGE : FLOAT_STORAGE);
+  vector<size_t> inst_points(inst_names.size(), m.size());
+  for (size_t i = 0; i < inst_names.size(); ++i)
+    m.find_index(inst_names[i], inst_points[i]);
+  for (size_t k = 0; k < train_instances.num_attributes(); ++k) {
+    if (!is_distance[k] || inst_names.empty()) continue;
+    const size_t from = m.get_index(
+      train_instances.get_attribute_description_ptr(k)->get_name());
+    const Column &col = train_instances.get_column(k);
+    for (size_t i = 0; i < train_instances.size(); ++i) {
+      if (inst_points[i] == m.size()) continue;
+      m.set(from, inst_points[i], col.get_numeric(train_instances.get_row(i)));
     }
   }
+  m.set_storage(this->distance_storage);
 
   // perform k-medoids clustering on the distance matrix
   std::cerr << "perform clustering " << std::endl;
-  vector<string> inst_ids;
-  std::copy(inst_ids_set.begin(), inst_ids_set.end(), std::back_inserter(inst_ids));
   KMedoidsClusterer clstr(this->k, m, inst_ids);
   clstr.train();
   this->medoid_names = clstr.get_medoids();
@@ -154,16 +183,13 @@ Classifiers::KMedoids::learn(const Dataset &train_instances,
     cerr << m << endl;
   cerr << " --- " << endl;
 
-  // build new dataset characterized by distance to the medoids from
-  // the clustering
-  std::cerr << "transofrm dataset " << std::endl;
-  Dataset nds;
-  build_new_dataset(train_instances, nds, this->medoid_names,
-                    ignore_inst_ids, this->name_att, class_label);
-
-  // build a NB classifier from the new instances
+  // build a NB classifier from the projection of the training instances
+  // onto the distances to the medoids from the clustering
   std::cerr << "build nb classifier " << std::endl;
-  this->nb_classifier.learn(nds, class_label);
+  DatasetView projected(train_instances,
+                        medoid_attributes(train_instances, this->medoid_names,
+                                          class_label));
+  this->nb_classifier.learn(projected, class_label);
 }
 
 
@@ -175,18 +201,9 @@ double
 Classifiers::KMedoids::class_probability(const Instance &test_instance,
                                          const string &class_label,
                                          const set<string> &exclude_atts) const {
-  Instance t_cp(test_instance); // !!!!!!!!!! make sure copy constructor is set up for instance!!!
-  vector<string> att_names;
-  for (auto it = t_cp.begin(); it != t_cp.end(); ++it) {
-    AttributeOccurrence *att_oc_ptr = (*it);
-    att_names.push_back(att_oc_ptr->get_attribute_name());
-  }
-  for (auto it = att_names.begin(); it != att_names.end(); ++it) {
-    if (this->medoid_names.find(*it) == this->medoid_names.end())
-      t_cp.delete_attribute_occurrence(*it);
-  }
-
-  return this->nb_classifier.class_probability(t_cp, class_label);
+  // the NB classifier only looks at the distances to the medoids, which it
+  // was trained on, so the instance can be given to it as-is
+  return this->nb_classifier.class_probability(test_instance, class_label);
 }
 
 std::string
@@ -202,6 +219,10 @@ Classifiers::KMedoids::set_classifier_specific_options(Commandline &cmdline) {
   CommandlineInterface cli (get_cli());
   cli.consume('n', cmdline, this->name_att);
   cli.consume('k', cmdline, this->k);
+  cli.consume('y', cmdline, this->symmetric);
+  string storage_str;
+  cli.consume('q', cmdline, storage_str);
+  this->distance_storage = parse_numeric_storage(storage_str);
 }
 
 void
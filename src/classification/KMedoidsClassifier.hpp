@@ -36,7 +36,8 @@ namespace Classifiers {
     using Classifier::Classifier;
     KMedoids() : Classifier(), nb_classifier(NaiveBayes()),
                  medoid_names(std::set<std::string>()),
-                 name_att("") {}
+                 name_att(""), k(2), symmetric(false),
+                 distance_storage(DOUBLE_STORAGE) {}
     ~KMedoids() {}
 
     // public inspectors
@@ -48,10 +49,10 @@ namespace Classifiers {
     std::string usage() const;
 
     // public mutators
-    void learn(const Dataset &training_instances,
+    using Classifier::learn;
+    void learn(const DatasetView &training_instances,
                const std::string &class_label,
-               const std::set<size_t> &ignore_instance_ids = std::set<size_t>(),
-               const std::set<std::string> &ig_atts = std::set<std::string>());
+               const std::vector<bool> &att_mask);
     void set_name_att(const std::string &s) { this->name_att = s; }
     void set_classifier_specific_options(Commandline &cmdline);
     void clear();
@@ -60,6 +61,8 @@ namespace Classifiers {
     std::set<std::string> medoid_names;
     std::string name_att;
     size_t k;
+    bool symmetric;
+    NumericStorage distance_storage;
   };
 }
 
@@ -24,6 +24,7 @@
 #include <sstream>
 #include <cmath>
 #include <set>
+#include <limits>
 
 // local Cognosco includes
 #include "NaiveBayes.hpp"
@@ -34,20 +35,40 @@ using std::pair;
 using std::string;
 using std::unordered_map;
 
+/*****************************************************************************
+ *                         STATIC HELPER FUNCTIONS                           *
+ *****************************************************************************/
+
+/**
+ * \brief push the values of the instances in a view onto the running stats
+ *        for their class, reading straight from a column's storage at
+ *        whatever precision it is held; value = offset + scale * data[row].
+ */
+template <class T>
+static void
+push_values(const T *data, const double offset, const double scale,
+            const DatasetView &instances,
+            const std::vector<size_t> &inst_classes,
+            std::vector<RunningStat> &running_stats) {
+  for (size_t i = 0; i < instances.size(); ++i) {
+    running_stats[inst_classes[i]].push(offset +
+                                        scale * data[instances.get_row(i)]);
+  }
+}
+
+
 /*****************************************************************************
  *                               INSPECTORS                                  *
  *****************************************************************************/
 
 /**
- * \brief Get the prior probability of the given class label. Classifier must
- *        have already been trained, otherwise these priors have not been
- *        computed.
+ * \brief Get the index of the given class label amongst the classes learned
+ *        by this classifier.
  */
-double
-NaiveBayes::get_prior_prob(const string &class_label) const {
-  unordered_map<string, double>::const_iterator it =\
-    this->class_priors.find(class_label);
-  if (it == this->class_priors.end()) {
+size_t
+NaiveBayes::get_class_index(const string &class_label) const {
+  auto it = this->class_indices.find(class_label);
+  if (it == this->class_indices.end()) {
     std::stringstream ss;
     ss << "Failed to get prior probability for class "
        << class_label << "; no such class";
@@ -56,27 +77,43 @@ NaiveBayes::get_prior_prob(const string &class_label) const {
   return it->second;
 }
 
+/**
+ * \brief Get the index of the given attribute amongst the attributes learned
+ *        by this classifier; the class is only used for error reporting.
+ */
+size_t
+NaiveBayes::get_att_index(const size_t class_idx,
+                          const string &att_name) const {
+  auto it = this->att_indices.find(att_name);
+  if (it == this->att_indices.end()) {
+    throw NaiveBayesError("unknown class and attribute pair: " +
+                          this->class_labels[class_idx] + ", " + att_name);
+  }
+  return it->second;
+}
+
+/**
+ * \brief Get the prior probability of the given class label. Classifier must
+ *        have already been trained, otherwise these priors have not been
+ *        computed.
+ */
+double
+NaiveBayes::get_prior_prob(const string &class_label) const {
+  return this->class_priors[this->get_class_index(class_label)];
+}
+
 double
 NaiveBayes::get_mean(const string &class_name, const string &att_name) const {
-  pair<string, string> cls_att_pair = std::make_pair(class_name, att_name);
-  AttClassMap::const_iterator m_it = this->class_means.find(cls_att_pair);
-  if (m_it == this->class_means.end()) {
-    throw NaiveBayesError("unknown class and attribute pair: " + class_name
-                          + ", " + att_name);
-  }
-  return m_it->second;
+  const size_t class_idx = this->get_class_index(class_name);
+  return this->class_means[class_idx][this->get_att_index(class_idx, att_name)];
 }
 
 
 double
 NaiveBayes::get_variance(const string &class_name, const string &att_name) const {
-  pair<string, string> cls_att_pair = std::make_pair(class_name, att_name);
-  AttClassMap::const_iterator v_it = this->class_variances.find(cls_att_pair);
-  if (v_it == this->class_variances.end()) {
-    throw NaiveBayesError("unknown class and attribute pair: " + class_name
-                          + ", " + att_name);
-  }
-  return v_it->second;
+  const size_t class_idx = this->get_class_index(class_name);
+  return this->class_variances[class_idx][this->get_att_index(class_idx,
+                                                              att_name)];
 }
 
 /**
@@ -88,20 +125,19 @@ NaiveBayes::get_variance(const string &class_name, const string &att_name) const
  * TODO should do this in log space... not numerically stable
  */
 double
-NaiveBayes::get_conditional_prob(const AttributeOccurrence *value,
+NaiveBayes::get_conditional_prob(const AttributeOccurrence &value,
                                  const string &class_name) const {
-  const string &att_name (value->get_attribute_name());
-  pair<string, string> cls_att_pair = std::make_pair(class_name, att_name);
-  AttClassMap::const_iterator v_it = this->class_variances.find(cls_att_pair);
-  AttClassMap::const_iterator m_it = this->class_means.find(cls_att_pair);
-  if ((v_it == this->class_variances.end()) ||
-      (m_it == this->class_means.end())) {
-    throw NaiveBayesError("unknown class and attribute pair: " + class_name
-                          + ", " + att_name);
-  }
-  const double mu(m_it->second);
-  const double var(v_it->second);
-  const double val((*value) * 1.0);
+  const size_t class_idx = this->get_class_index(class_name);
+  const size_t att_idx = this->get_att_index(class_idx,
+                                             value.get_attribute_name());
+  return this->conditional_prob(value * 1.0, class_idx, att_idx);
+}
+
+double
+NaiveBayes::conditional_prob(const double val, const size_t class_idx,
+                             const size_t att_idx) const {
+  const double mu(this->class_means[class_idx][att_idx]);
+  const double var(this->class_variances[class_idx][att_idx]);
   const double exponent((val-mu) * (val-mu) / (2*var));
   return exp(-exponent) / sqrt(2 * M_PI * var);
 }
@@ -115,28 +151,39 @@ double
 NaiveBayes::posterior_probability(const Instance &test_instance,
                                   const string &class_label,
                                   const std::set<std::string> &ig_atts) const {
+  return this->posterior_probability(test_instance,
+                                     this->get_class_index(class_label),
+                                     ig_atts);
+}
+
+double
+NaiveBayes::posterior_probability(const Instance &test_instance,
+                                  const size_t class_idx,
+                                  const std::set<std::string> &ig_atts) const {
+  // only the attributes we learned are looked up in the instance, so it can
+  // have others (e.g. it may come from a dataset we were trained on a
+  // projection of).
   double res = 1;
-  for (auto it = test_instance.begin(); it != test_instance.end(); ++it) {
-    string att_name ((*it)->get_attribute_name());
-    if ((att_name == this->learned_class) ||
-        (ig_atts.find(att_name) != ig_atts.end())) {
-      continue;
-    }
-    res *= this->get_conditional_prob(*it, class_label);
+  for (size_t j = 0; j < this->att_names.size(); ++j) {
+    const string &att_name (this->att_names[j]);
+    if (ig_atts.find(att_name) != ig_atts.end()) continue;
+    res *= this->conditional_prob(test_instance[att_name] * 1.0, class_idx, j);
   }
-  return res * this->get_prior_prob(class_label);
+  return res * this->class_priors[class_idx];
 }
 
 double
 NaiveBayes::membership_probability(const Instance &test_instance,
                                    const string &class_label,
                                    const set<string> &ig_atts) const {
-  double sum = 0;
-  std::vector<string> class_labels;
-  for (auto p : this->class_priors) class_labels.push_back(p.first);
-  for (size_t i = 0; i < class_labels.size(); ++i)
-    sum += this->posterior_probability(test_instance, class_labels[i], ig_atts);
-  return this->posterior_probability(test_instance, class_label, ig_atts) / sum;
+  const size_t class_idx = this->get_class_index(class_label);
+  double sum = 0, res = 0;
+  for (size_t i = 0; i < this->class_labels.size(); ++i) {
+    const double p = this->posterior_probability(test_instance, i, ig_atts);
+    if (i == class_idx) res = p;
+    sum += p;
+  }
+  return res / sum;
 }
 
 
@@ -145,17 +192,14 @@ NaiveBayes::to_string() const {
   if (this->learned_class.empty()) return "[NULL NB CLASSIFIER]";
 
   std::stringstream ss;
-
-  std::vector<string> class_labels;
-  for (auto p : this->class_priors) class_labels.push_back(p.first);
-  for (size_t i = 0; i < class_labels.size(); ++i) {
+  for (size_t i = 0; i < this->class_labels.size(); ++i) {
     ss << "[" << class_labels[i] << "]" << std::endl;
-    ss << "prior: " << this->get_prior_prob(class_labels[i]) << std::endl;
-    for (auto cm : this->class_means) {
-      if (cm.first.first != class_labels[i]) continue;
-      ss << "mean " << cm.first.second << ": " << cm.second << "; ";
-      ss << "variance " << cm.first.second << ": "
-         << this->get_variance(cm.first.first, cm.first.second) << std::endl;
+    ss << "prior: " << this->class_priors[i] << std::endl;
+    for (size_t j = 0; j < this->att_names.size(); ++j) {
+      ss << "mean " << this->att_names[j] << ": "
+         << this->class_means[i][j] << "; ";
+      ss << "variance " << this->att_names[j] << ": "
+         << this->class_variances[i][j] << std::endl;
     }
   }
   return ss.str();
@@ -172,52 +216,113 @@ NaiveBayes::usage() const {
  *****************************************************************************/
 
 void
-NaiveBayes::learn(const Dataset &training_instances,
+NaiveBayes::learn(const DatasetView &training_instances,
                   const string &class_label,
-                  const set<size_t> &ignore_inst_ids,
-                  const set<string> &ig_atts) {
-  // for computing class prior probabilities
-  unordered_map<string, double> class_counts;
-
-  // for computing mean and variance
-  typedef unordered_map<pair<string, string>, RunningStat, string_pair_hash> ClsAttMap;
-  ClsAttMap running_stats;
-
-  size_t skipped = 0;
-  for (Dataset::const_iterator inst = training_instances.begin();
-       inst != training_instances.end(); ++inst) {
-    if (ignore_inst_ids.find(inst->get_instance_id()) != ignore_inst_ids.end()) {
-      skipped += 1;
-      continue;
+                  const std::vector<bool> &att_mask) {
+  this->clear();
+  check_attribute_mask(training_instances, att_mask);
+  const size_t class_k = training_instances.get_attribute_index(class_label);
+  const Column &class_col = training_instances.get_column(class_k);
+  if (class_col.get_type() != NOMINAL) {
+    throw NaiveBayesError("class attribute " + class_label +
+                          " is not nominal");
+  }
+
+  // find the class of each instance in the view; classes are numbered in
+  // the order we find them, so only those present in the view are learned.
+  const size_t NO_CLASS = std::numeric_limits<size_t>::max();
+  const size_t num_insts = training_instances.size();
+  std::vector<size_t> code_to_class(class_col.num_labels(), NO_CLASS);
+  std::vector<size_t> inst_classes(num_insts);
+  std::vector<double> class_counts;
+  for (size_t i = 0; i < num_insts; ++i) {
+    const uint32_t code = class_col.get_code(training_instances.get_row(i));
+    if (code_to_class[code] == NO_CLASS) {
+      code_to_class[code] = this->class_labels.size();
+      this->class_indices[class_col.decode(code)] = this->class_labels.size();
+      this->class_labels.push_back(class_col.decode(code));
+      class_counts.push_back(0);
     }
-    const string &instance_class_label =\
-      inst->get_att_occurrence(class_label)->to_string();
-    class_counts[instance_class_label] += 1;
-
-    for (Instance::const_iterator it = inst->begin(); it != inst->end(); ++it) {
-      const string& attribute_name = (*it)->get_attribute_name();
-      if ((attribute_name == class_label) ||
-          (ig_atts.find(attribute_name) != ig_atts.end())) {
-        continue;
+    inst_classes[i] = code_to_class[code];
+    class_counts[inst_classes[i]] += 1;
+  }
+  const size_t num_classes = this->class_labels.size();
+  this->class_means.resize(num_classes);
+  this->class_variances.resize(num_classes);
+
+  // walk down each attribute's column, rather than across each instance, so
+  // that we read the values contiguously. For sparse columns we need the
+  // class of, and the number of times the view includes, each row of the
+  // dataset; these are only worked out if there are any such columns.
+  std::vector<size_t> row_classes;
+  std::vector<int> row_counts;
+  for (size_t k = 0; k < training_instances.num_attributes(); ++k) {
+    if ((k == class_k) || !att_mask[k]) continue;
+    const string &attribute_name =\
+      training_instances.get_attribute_description_ptr(k)->get_name();
+    const Column &col = training_instances.get_column(k);
+    if ((col.get_type() != NUMERIC) && (num_insts > 0)) {
+      std::stringstream ss;
+      ss << "multiplication by double for attribute "
+         << attribute_name << " undefined";
+      throw CognoscoError(ss.str());
+    }
+    std::vector<RunningStat> running_stats(num_classes);
+    if (col.is_sparse()) {
+      // visit only the non-zeros, then account for each class's zeros in one
+      // go; rows may appear in the view more than once.
+      if (row_counts.empty()) {
+        const size_t num_rows = training_instances.get_dataset().size();
+        row_classes.resize(num_rows, NO_CLASS);
+        row_counts.resize(num_rows, 0);
+        for (size_t i = 0; i < num_insts; ++i) {
+          row_classes[training_instances.get_row(i)] = inst_classes[i];
+          row_counts[training_instances.get_row(i)] += 1;
+        }
+      }
+      std::vector<int> nonzero_counts(num_classes, 0);
+      const MappableVector<uint32_t> &nz_rows = col.nonzero_rows();
+      const NumericBuffer &nz_values = col.nonzero_values();
+      for (size_t j = 0; j < nz_rows.size(); ++j) {
+        const size_t r = nz_rows[j];
+        if (row_counts[r] == 0) continue;
+        running_stats[row_classes[r]].push(nz_values.get(j), row_counts[r]);
+        nonzero_counts[row_classes[r]] += row_counts[r];
+      }
+      for (size_t c = 0; c < num_classes; ++c)
+        running_stats[c].push(0.0, class_counts[c] - nonzero_counts[c]);
+    } else {
+      const NumericBuffer &vals = col.numeric_values();
+      switch (vals.get_storage()) {
+        case DOUBLE_STORAGE:
+          push_values(vals.double_data(), vals.get_offset(), vals.get_scale(),
+                      training_instances, inst_classes, running_stats);
+          break;
+        case FLOAT_STORAGE:
+          push_values(vals.float_data(), vals.get_offset(), vals.get_scale(),
+                      training_instances, inst_classes, running_stats);
+          break;
+        case QUANTIZED_16_STORAGE:
+          push_values(vals.q16_data(), vals.get_offset(), vals.get_scale(),
+                      training_instances, inst_classes, running_stats);
+          break;
+        case QUANTIZED_8_STORAGE:
+          push_values(vals.q8_data(), vals.get_offset(), vals.get_scale(),
+                      training_instances, inst_classes, running_stats);
+          break;
       }
-      const double att_value = (**it) * 1.0;
-      std::pair<string, string> att_class_pair =\
-        std::make_pair(instance_class_label, attribute_name);
-      running_stats[att_class_pair].push(att_value);
     }
-  }
 
-  for (ClsAttMap::const_iterator it = running_stats.begin();
-       it != running_stats.end(); ++it) {
-    const pair<string, string> class_attr_pair(it->first);
-    this->class_means[class_attr_pair] = it->second.mean();
-    this->class_variances[class_attr_pair] = it->second.variance();
+    this->att_indices[attribute_name] = this->att_names.size();
+    this->att_names.push_back(attribute_name);
+    for (size_t i = 0; i < num_classes; ++i) {
+      this->class_means[i].push_back(running_stats[i].mean());
+      this->class_variances[i].push_back(running_stats[i].variance());
+    }
   }
 
-  const size_t effective_size = training_instances.size() - skipped;
-  for (unordered_map<string,double>::iterator it = class_counts.begin();
-       it != class_counts.end(); ++it) {
-    this->class_priors[it->first] = it->second / effective_size;
+  for (size_t i = 0; i < num_classes; ++i) {
+    this->class_priors.push_back(class_counts[i] / num_insts);
   }
 
   this->learned_class = class_label;
@@ -230,7 +335,11 @@ NaiveBayes::set_classifier_specific_options(Commandline &cmdline) {
 
 void
 NaiveBayes::clear() {
+  this->class_labels.clear();
+  this->class_indices.clear();
   this->class_priors.clear();
+  this->att_names.clear();
+  this->att_indices.clear();
   this->class_variances.clear();
   this->class_means.clear();
 }
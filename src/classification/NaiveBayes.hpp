@@ -25,6 +25,7 @@
 #include <string>
 #include <vector>
 #include <unordered_map>
+#include <cmath>
 
 // local Cognosco includes
 #include "CLI.hpp"
@@ -33,14 +34,6 @@
 #include "CognoscoError.hpp"
 #include "StringUtils.hpp"
 
-/******************************************************************************
- *                                   TYPES                                    *
- ******************************************************************************/
-
-typedef std::unordered_map<std::pair<std::string, std::string>,
-                           double, string_pair_hash> AttClassMap;
-
-
 /*****************************************************************************
  *                                ERROR-HANDLING                             *
  *****************************************************************************/
@@ -70,7 +63,7 @@ public:
                                const std::set<std::string> &exclude_atts =\
                                  std::set<std::string>()) const;
   double get_prior_prob(const std::string &class_label) const;
-  double get_conditional_prob(const AttributeOccurrence *value,
+  double get_conditional_prob(const AttributeOccurrence &value,
                               const std::string &class_label) const;
   std::string to_string() const;
   double get_variance(const std::string &class_name,
@@ -87,18 +80,35 @@ public:
   std::string usage() const;
 
   // public mutators
-  void learn(const Dataset &training_instances,
+  using Classifier::learn;
+  void learn(const DatasetView &training_instances,
              const std::string &class_label,
-             const std::set<size_t> &ignore_instance_ids = std::set<size_t>(),
-             const std::set<std::string> &ig_atts = std::set<std::string>());
+             const std::vector<bool> &att_mask);
   void set_classifier_specific_options(Commandline &cmdline);
   void clear();
 
 
 private:
-  std::unordered_map<std::string, double> class_priors;
-  AttClassMap class_variances;
-  AttClassMap class_means;
+  // private instance variables -- classes and attributes are numbered in
+  // the order they were seen during learning; means and variances are
+  // indexed first by class, then by attribute.
+  std::vector<std::string> class_labels;
+  std::unordered_map<std::string, size_t> class_indices;
+  std::vector<double> class_priors;
+  std::vector<std::string> att_names;
+  std::unordered_map<std::string, size_t> att_indices;
+  std::vector<std::vector<double> > class_means;
+  std::vector<std::vector<double> > class_variances;
+
+  // private inspectors
+  size_t get_class_index(const std::string &class_label) const;
+  size_t get_att_index(const size_t class_idx,
+                       const std::string &att_name) const;
+  double conditional_prob(const double val, const size_t class_idx,
+                          const size_t att_idx) const;
+  double posterior_probability(const Instance &test_instance,
+                               const size_t class_idx,
+                               const std::set<std::string> &ig_atts) const;
 };
 
 /**
@@ -132,6 +142,29 @@ public:
     }
   }
 
+  /**
+   * \brief push the value x, n times; merges a block of n identical values
+   *        into the running mean and variance (Chan et al.'s update).
+   */
+  void push(const double x, const int n) {
+    if (n <= 0) return;
+    if (m_n == 0) {
+      m_n = n;
+      m_oldM = m_newM = x;
+      m_oldS = m_newS = 0.0;
+      return;
+    }
+    const double delta = x - m_oldM;
+    const int total = m_n + n;
+    m_newM = m_oldM + delta * n / total;
+    m_newS = m_oldS + delta * delta * m_n * n / total;
+    m_n = total;
+
+    // set up for next iteration
+    m_oldM = m_newM;
+    m_oldS = m_newS;
+  }
+
   int numDataValues() const { return m_n;}
   double mean() const { return (m_n > 0) ? m_newM : 0.0; }
   double variance() const { return ( (m_n > 1) ? m_newS/(m_n - 1) : 0.0 ); }
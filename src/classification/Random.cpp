@@ -64,21 +64,24 @@ Classifiers::Random::usage() const {
  *****************************************************************************/
 
 void
-Classifiers::Random::learn(const Dataset &train_insts,
+Classifiers::Random::learn(const DatasetView &train_insts,
                            const string &class_label,
-                           const set<size_t> &ignore_inst_ids,
-                           const set<string> &ig_atts) {
-  set<string> class_labels;
-  for (auto inst = train_insts.begin(); inst != train_insts.end(); ++inst) {
-    if (ignore_inst_ids.find(inst->get_instance_id()) != ignore_inst_ids.end()) {
-      continue;
-    }
-
-    const string &instance_class_label =\
-      inst->get_att_occurrence(class_label)->to_string();
-    class_labels.insert(instance_class_label);
+                           const std::vector<bool> &att_mask) {
+  check_attribute_mask(train_insts, att_mask);
+  const Column &class_col =\
+    train_insts.get_column(train_insts.get_attribute_index(class_label));
+  if (class_col.get_type() != NOMINAL) {
+    throw CognoscoError("Random: class attribute " + class_label +
+                        " is not nominal");
+  }
+  std::vector<bool> seen(class_col.num_labels(), false);
+  size_t num_labels = 0;
+  for (size_t i = 0; i < train_insts.size(); ++i) {
+    const uint32_t code = class_col.get_code(train_insts.get_row(i));
+    if (!seen[code]) num_labels += 1;
+    seen[code] = true;
   }
-  this->prob = 1.0 / class_labels.size();
+  this->prob = 1.0 / num_labels;
   this->learned_class = class_label;
 }
 
@@ -49,10 +49,10 @@ namespace Classifiers {
     std::string usage() const;
 
     // public mutators
-    void learn(const Dataset &training_instances,
+    using Classifier::learn;
+    void learn(const DatasetView &training_instances,
                const std::string &class_label,
-               const std::set<size_t> &ignore_instance_ids = std::set<size_t>(),
-               const std::set<std::string> &ig_atts = std::set<std::string>());
+               const std::vector<bool> &att_mask);
     void set_classifier_specific_options(Commandline &cmdline);
     void clear();
 
@@ -72,28 +72,26 @@ Classifiers::ZeroR::usage() const {
  *****************************************************************************/
 
 void
-Classifiers::ZeroR::learn(const Dataset &train_insts,
+Classifiers::ZeroR::learn(const DatasetView &train_insts,
                            const string &class_label,
-                           const set<size_t> &ignore_inst_ids,
-                           const set<string> &ig_atts) {
+                           const std::vector<bool> &att_mask) {
   this->clear();
+  check_attribute_mask(train_insts, att_mask);
 
-  std::unordered_map<std::string, double> counts;
-  size_t num_insts = 0;
-  for (auto inst = train_insts.begin(); inst != train_insts.end(); ++inst) {
-    if (ignore_inst_ids.find(inst->get_instance_id()) != ignore_inst_ids.end()) {
-      continue;
-    }
-
-    const string &instance_class_label =\
-      inst->get_att_occurrence(class_label)->to_string();
-
-    counts[instance_class_label] += 1;
-    num_insts += 1;
+  const Column &class_col =\
+    train_insts.get_column(train_insts.get_attribute_index(class_label));
+  if (class_col.get_type() != NOMINAL) {
+    throw CognoscoError("ZeroR: class attribute " + class_label +
+                        " is not nominal");
   }
-
-  for (auto kvp : counts) {
-    this->priors[kvp.first] = kvp.second / num_insts;
+  std::vector<double> counts(class_col.num_labels(), 0);
+  const size_t num_insts = train_insts.size();
+  for (size_t i = 0; i < num_insts; ++i)
+    counts[class_col.get_code(train_insts.get_row(i))] += 1;
+
+  for (uint32_t code = 0; code < counts.size(); ++code) {
+    if (counts[code] == 0) continue;
+    this->priors[class_col.decode(code)] = counts[code] / num_insts;
   }
 
   this->learned_class = class_label;
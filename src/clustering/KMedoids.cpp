@@ -22,6 +22,9 @@
 #include <vector>
 #include <set>
 #include <cstdlib>
+#include <cmath>
+#include <numeric>
+#include <algorithm>
 #include <unordered_map>
 
 // Cognosco includes
@@ -42,12 +45,21 @@ using std::unordered_map;
 KMedoidsClusterer::KMedoidsClusterer(const size_t k,
                                      const DistanceMatrix &dist_m,
                                      const vector<string> &instance_ids) :
-  distance_matrix(dist_m), instance_ids(instance_ids) {
+  distance_matrix(dist_m), instance_ids(instance_ids),
+  points(instance_ids.size()), cluster_assignments(instance_ids.size()) {
+  for (size_t i = 0; i < instance_ids.size(); ++i) {
+    if (!dist_m.find_index(instance_ids[i], this->points[i])) {
+      throw CognoscoError("no such instance in distance matrix: " +
+                          instance_ids[i]);
+    }
+    this->instance_index[instance_ids[i]] = i;
+  }
+
   // randomly assign k of the instances as medoids
   while (this->medoids.size() < k) {
     int r = rand() % instance_ids.size();
-    if (medoids.find(instance_ids[r]) == medoids.end())
-      medoids.insert(instance_ids[r]);
+    if (medoids.find(r) == medoids.end())
+      medoids.insert(r);
   }
 
   // compute cluster assignments
@@ -59,19 +71,20 @@ KMedoidsClusterer::KMedoidsClusterer(const size_t k,
  *                                INSPECTORS                                 *
  *****************************************************************************/
 
-const set<string>&
+set<string>
 KMedoidsClusterer::get_medoids() const {
-  return this->medoids;
+  set<string> res;
+  for (auto m : this->medoids) res.insert(this->instance_ids[m]);
+  return res;
 }
 
 set<string>
 KMedoidsClusterer::get_medoid_members(const string medoid) const {
   set<string> res;
-  typedef unordered_map<string, string>::const_iterator AssigIter;
-  for (AssigIter it = this->cluster_assignments.begin();
-       it != this->cluster_assignments.end(); ++it) {
-    if (it->second == medoid)
-      res.insert(it->first);
+  const size_t m = this->get_instance(medoid);
+  for (size_t i = 0; i < this->cluster_assignments.size(); ++i) {
+    if (this->cluster_assignments[i] == m)
+      res.insert(this->instance_ids[i]);
   }
   return res;
 }
@@ -81,13 +94,13 @@ KMedoidsClusterer::get_medoid_members(const string medoid) const {
  */
 string
 KMedoidsClusterer::get_cluster_assignment(const string &instance_name) const {
-  unordered_map<string, string>::const_iterator it =\
-    this->cluster_assignments.find(instance_name);
-  if (it == this->cluster_assignments.end()) {
+  unordered_map<string, size_t>::const_iterator it =\
+    this->instance_index.find(instance_name);
+  if (it == this->instance_index.end()) {
     throw CognoscoError("no such instance in cluster assignments: "
                             + instance_name);
   }
-  return it->second;
+  return this->instance_ids[this->cluster_assignments[it->second]];
 }
 
 
@@ -98,12 +111,13 @@ KMedoidsClusterer::get_cluster_assignment(const string &instance_name) const {
 double
 KMedoidsClusterer::compute_membership_probability(const string &instance,
                                                   const string &medoid) const {
+  const size_t inst = this->get_instance(instance);
   double sum = 0;
-  for (set<string>::const_iterator it = this->medoids.begin();
+  for (set<size_t>::const_iterator it = this->medoids.begin();
        it != this->medoids.end(); ++it) {
-    sum += (1/get_distance(*it, instance));
+    sum += (1/distance(*it, inst));
   }
-  return (1 / get_distance(instance, medoid)) / sum;
+  return (1 / distance(inst, this->get_instance(medoid))) / sum;
 };
 
 
@@ -113,12 +127,61 @@ KMedoidsClusterer::compute_membership_probability(const string &instance,
  */
 string
 KMedoidsClusterer::find_closest_medoid(const string &instance_name) const {
-  string closest_medoid;
-  double closest_medoid_distance;
+  return this->instance_ids[this->closest_medoid(
+    this->get_instance(instance_name))];
+}
+
+
+/**
+ * Get the distance between two instances.
+ */
+double
+KMedoidsClusterer::get_distance(const string &s, const string &t) const {
+  if (s == t) return 0;
+  return this->distance(this->get_instance(s), this->get_instance(t));
+}
+
+
+/**
+ * Get the position of the named instance.
+ */
+size_t
+KMedoidsClusterer::get_instance(const string &name) const {
+  unordered_map<string, size_t>::const_iterator it =\
+    this->instance_index.find(name);
+  if (it == this->instance_index.end())
+    throw CognoscoError("no such instance: " + name);
+  return it->second;
+}
+
+
+/**
+ * Get the distance between two instances, given by position.
+ */
+double
+KMedoidsClusterer::distance(const size_t s, const size_t t) const {
+  if (s == t) return 0;
+  const double d = this->distance_matrix.get(this->points[s], this->points[t]);
+  if (std::isnan(d)) {
+    throw CognoscoError("no such distance pair: " + this->instance_ids[s] +
+                        ", " + this->instance_ids[t]);
+  }
+  return d;
+}
+
+
+/**
+ * Find the medoid the given instance is closest to; ties go to the first
+ * medoid.
+ */
+size_t
+KMedoidsClusterer::closest_medoid(const size_t instance) const {
+  size_t closest_medoid = 0;
+  double closest_medoid_distance = 0;
   bool first = true;
-  typedef set<string>::iterator Miter;
+  typedef set<size_t>::const_iterator Miter;
   for (Miter it = this->medoids.begin(); it != this->medoids.end(); ++it) {
-    double d = this->get_distance(*it, instance_name);
+    double d = this->distance(*it, instance);
     if (first || (d < closest_medoid_distance)) {
       closest_medoid = *it;
       closest_medoid_distance = d;
@@ -129,90 +192,103 @@ KMedoidsClusterer::find_closest_medoid(const string &instance_name) const {
 }
 
 
-/**
- * Get the distance between two instances.
- */
-double
-KMedoidsClusterer::get_distance(const string &s, const string &t) const {
-  if (s == t) return 0;
-  DistanceMatrix::const_iterator dist_iter =\
-    this->distance_matrix.find(std::make_pair(s, t));
-  if (dist_iter == this->distance_matrix.end()) {
-    throw CognoscoError("no such distance pair: " + s + ", " + t);
-  }
-  return dist_iter->second;
+bool
+KMedoidsClusterer::is_medoid(const size_t instance) const {
+  return (this->medoids.find(instance) != this->medoids.end());
 }
 
-
 /**
- * compute the cost of the current configuration
+ * \brief give the scorer the given medoids.
+ * \return the cost of the medoids.
  */
 double
-KMedoidsClusterer::cost() const {
-  double res = 0;
-  for (size_t i = 0; i < this->instance_ids.size(); ++i) {
-    string instance_name(this->instance_ids[i]);
-    string medoid = this->get_cluster_assignment(instance_name);
-    res += this->get_distance(instance_name, medoid);
+KMedoidsClusterer::add_medoids(const vector<size_t> &medoids,
+                               MedoidSwapScorer &scorer) const {
+  scorer.clear();
+  for (size_t s = 0; s < medoids.size(); ++s) {
+    scorer.add_medoid(s, [&](size_t i) {
+      return this->distance(medoids[s], i);
+    });
   }
-  return res;
+  return scorer.cost();
 }
 
-bool
-KMedoidsClusterer::is_medoid(const string &id) const {
-  return (this->medoids.find(id) != this->medoids.end());
+/**
+ * \brief find the change in cost from swapping the given instance for each
+ *        of the scorer's medoids.
+ */
+void
+KMedoidsClusterer::score_swaps(const size_t instance, MedoidSwapScorer &scorer,
+                               vector<double> &deltas) const {
+  scorer.score([&](size_t i) { return this->distance(instance, i); }, deltas);
 }
 
 /*****************************************************************************
  *                                 MUTATORS                                  *
  *****************************************************************************/
 
+/**
+ * \brief improve the medoids by swapping medoids for other instances for as
+ *        long as that lowers the cost, as FastPAM does. Each pass scores
+ *        swapping each instance for every medoid at once, from a single
+ *        pass over its distances, and keeps the best instance to swap for
+ *        each medoid. Those swaps are then made, best first; each after the
+ *        first is rescored, since the swaps before it change its effect, and
+ *        is made only if it still lowers the cost. Training stops after a
+ *        pass that makes no swap.
+ */
 void
 KMedoidsClusterer::train() {
-  set<string> best_medoids(this->medoids);
-  double best_cost = this->cost();
-  vector<string> medoids_vec;
-  std::copy(this->medoids.begin(), this->medoids.end(),
-            std::back_inserter(medoids_vec));
-  for (size_t i = 0; i < medoids_vec.size(); ++i) {
-    string medoid_name(medoids_vec[i]);
-    for (size_t j = 0; j < this->instance_ids.size(); ++j) {
-      string instance_name(this->instance_ids[j]);
-      if (this->is_medoid(instance_name)) continue;
-      //cerr << "trying to swap medoid " << medoid_name << " with instance " << instance_name << endl;
-      this->swap_medoid(instance_name, medoid_name);
-      double new_cost = this->cost();
-      //cerr << "gives new cost of " << new_cost << endl;
-      if (new_cost < best_cost) {
-        medoids_vec[i] = instance_name;
-        medoid_name = medoids_vec[i];
-        best_cost = new_cost;
-        best_medoids = this->medoids;
-      } else {
-        //cerr << "no better than " << best_cost << endl;
-        this->swap_medoid(medoid_name, instance_name);
+  const size_t n = this->instance_ids.size();
+  vector<size_t> medoids(this->medoids.begin(), this->medoids.end());
+  const size_t k = medoids.size();
+  MedoidSwapScorer scorer(k, n);
+  double cost = this->add_medoids(medoids, scorer);
+  vector<double> deltas(k);
+  bool swapped = true;
+  while (swapped) {
+    vector<double> best_delta(k, 0);
+    vector<size_t> best_instance(k, n);
+    for (size_t j = 0; j < n; ++j) {
+      if (this->is_medoid(j)) continue;
+      this->score_swaps(j, scorer, deltas);
+      for (size_t s = 0; s < k; ++s) {
+        if (deltas[s] < best_delta[s]) {
+          best_delta[s] = deltas[s];
+          best_instance[s] = j;
+        }
       }
     }
-  }
-  this->medoids = best_medoids;
-  update_cluster_assignments();
-};
 
-/**
- * swap a non-medoid with a medoid and update all of the cluster assignments
- */
-void
-KMedoidsClusterer::swap_medoid(const string &non_medoid, const string &medoid) {
-  if (this->medoids.find(non_medoid) != this->medoids.end()) {
-    throw CognoscoError("cannot swap, " + non_medoid + " is a medoid!");
-  }
-  if (this->medoids.find(medoid) == this->medoids.end()) {
-    throw CognoscoError("cannot swap, " + medoid + " is not a medoid!");
-  }
+    vector<size_t> order(k);
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+      return best_delta[a] < best_delta[b];
+    });
+    swapped = false;
+    for (auto s : order) {
+      const size_t j = best_instance[s];
+      if ((j == n) || this->is_medoid(j)) continue;
+      if (swapped) {
+        this->score_swaps(j, scorer, deltas);
+        if (!(deltas[s] < 0)) continue;
+      }
 
-  set<string>::iterator miter = this->medoids.find(medoid);
-  this->medoids.erase(miter);
-  this->medoids.insert(non_medoid);
+      // make the swap, keeping it only if it really lowers the cost, so
+      // rounding can't make the search cycle
+      const size_t old_medoid = medoids[s];
+      medoids[s] = j;
+      const double new_cost = this->add_medoids(medoids, scorer);
+      if (!(new_cost < cost)) {
+        medoids[s] = old_medoid;
+        this->add_medoids(medoids, scorer);
+        continue;
+      }
+      cost = new_cost;
+      this->medoids = set<size_t>(medoids.begin(), medoids.end());
+      swapped = true;
+    }
+  }
   this->update_cluster_assignments();
 }
 
@@ -222,22 +298,6 @@ KMedoidsClusterer::swap_medoid(const string &non_medoid, const string &medoid) {
  */
 void
 KMedoidsClusterer::update_cluster_assignments() {
-  for (size_t i = 0; i < this->instance_ids.size(); ++i) {
-    string instance_name(this->instance_ids[i]);
-    string closest_medoid = this->find_closest_medoid(instance_name);
-    this->assign_to_medoid(instance_name, closest_medoid);
-  }
-}
-
-/**
- * Assign this instance tot he given medoid
- */
-void
-KMedoidsClusterer::assign_to_medoid(const string &instance,
-                                    const string &medoid) {
-  set<string>::const_iterator it2 = this->medoids.find(medoid);
-  if (it2 == this->medoids.end()) {
-    throw CognoscoError("no such medoid: " + medoid);
-  }
-  this->cluster_assignments[instance] = medoid;
+  for (size_t i = 0; i < this->instance_ids.size(); ++i)
+    this->cluster_assignments[i] = this->closest_medoid(i);
 }
@@ -24,10 +24,20 @@
 #include <set>
 #include <string>
 #include <vector>
+#include <unordered_map>
 
 // Cognosco includes
 #include "DistanceMatrix.hpp"
+#include "MedoidSwap.hpp"
 
+/**
+ * \brief k-medoids clustering of a set of instances, given by name, using
+ *        the distances between them in a DistanceMatrix. The matrix is not
+ *        copied, so it must outlive the clusterer. Instances are referred to
+ *        internally by their position in the list given, and distances are
+ *        looked up by the instances' indexes in the matrix; medoids are kept
+ *        in instance order.
+ */
 class KMedoidsClusterer {
 public:
   // constructors
@@ -35,7 +45,7 @@ public:
                     const std::vector<std::string> &instance_ids);
 
   // public inspectors
-  const std::set<std::string>&  get_medoids() const;
+  std::set<std::string> get_medoids() const;
   std::set<std::string> get_medoid_members(const std::string medoid) const;
   std::string get_cluster_assignment(const std::string &instance_name) const;
   double compute_membership_probability(const std::string &instance,
@@ -48,19 +58,26 @@ public:
 
 private:
   // private inspectors
-  double cost() const;
-  bool is_medoid(const std::string &id) const;
+  size_t get_instance(const std::string &name) const;
+  double distance(const size_t s, const size_t t) const;
+  size_t closest_medoid(const size_t instance) const;
+  bool is_medoid(const size_t instance) const;
+  double add_medoids(const std::vector<size_t> &medoids,
+                     MedoidSwapScorer &scorer) const;
+  void score_swaps(const size_t instance, MedoidSwapScorer &scorer,
+                   std::vector<double> &deltas) const;
 
   // private mutators
-  void swap_medoid(const std::string &non_medoid, const std::string &medoid);
   void update_cluster_assignments();
-  void assign_to_medoid(const std::string &instance, const std::string &medoid);
 
-  // private instance variables
-  std::set<std::string> medoids;
-  DistanceMatrix distance_matrix;
+  // private instance variables; points[i] is the index in the distance
+  // matrix of instance i, and cluster_assignments[i] is its medoid
+  const DistanceMatrix &distance_matrix;
   std::vector<std::string> instance_ids;
-  std::unordered_map<std::string, std::string> cluster_assignments;
+  std::vector<size_t> points;
+  std::unordered_map<std::string, size_t> instance_index;
+  std::set<size_t> medoids;
+  std::vector<size_t> cluster_assignments;
 };
 
 #endif
@@ -0,0 +1,118 @@
+/* The following applys to this software package and all subparts therein
+ *
+ * Cognosco Copyright (C) 2015 Philip J. Uren
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or (at
+ * your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef MEDOID_SWAP_HPP_
+#define MEDOID_SWAP_HPP_
+
+// stl includes
+#include <vector>
+#include <limits>
+#include <algorithm>
+
+/**
+ * \brief Scores swaps of a medoid for another instance, as FastPAM does.
+ *        For the current medoids, it keeps each instance's closest medoid,
+ *        and its distances to that and to its second closest. Given the
+ *        distances from a candidate instance to every instance, one pass
+ *        then gives the change in cost from swapping the candidate for each
+ *        of the medoids: instances closest to the medoid swapped out go to
+ *        whichever is closer of the candidate and their second closest, and
+ *        all others to whichever is closer of the candidate and their
+ *        closest. Medoids and instances are both referred to by position,
+ *        and distances are given by functions of an instance's position, so
+ *        any distance matrix can be used.
+ */
+class MedoidSwapScorer {
+public:
+  MedoidSwapScorer(const size_t num_medoids, const size_t num_instances) :
+    num_medoids(num_medoids), nearest(num_instances),
+    nearest_dist(num_instances), second_dist(num_instances),
+    removal_loss(num_medoids) { this->clear(); }
+
+  /**
+   * \brief forget the medoids; every instance is then infinitely far from
+   *        its closest and second closest medoid.
+   */
+  void clear() {
+    const double inf = std::numeric_limits<double>::infinity();
+    std::fill(this->nearest.begin(), this->nearest.end(), 0);
+    std::fill(this->nearest_dist.begin(), this->nearest_dist.end(), inf);
+    std::fill(this->second_dist.begin(), this->second_dist.end(), inf);
+  }
+
+  /**
+   * \brief add medoid s, whose distance to instance i is distance(i). Ties
+   *        go to the medoid added first.
+   */
+  template <typename Distance> void
+  add_medoid(const size_t s, const Distance &distance) {
+    for (size_t i = 0; i < this->nearest.size(); ++i) {
+      const double d = distance(i);
+      if (d < this->nearest_dist[i]) {
+        this->second_dist[i] = this->nearest_dist[i];
+        this->nearest_dist[i] = d;
+        this->nearest[i] = s;
+      } else if (d < this->second_dist[i]) {
+        this->second_dist[i] = d;
+      }
+    }
+  }
+
+  /**
+   * \brief the sum of the distances from each instance to its closest
+   *        medoid.
+   */
+  double cost() const {
+    double res = 0;
+    for (auto d : this->nearest_dist) res += d;
+    return res;
+  }
+
+  /**
+   * \brief find the change in cost from swapping a candidate, whose distance
+   *        to instance i is distance(i), for each medoid; deltas[s] is the
+   *        change for medoid s.
+   */
+  template <typename Distance> void
+  score(const Distance &distance, std::vector<double> &deltas) {
+    // the change from adding the candidate, plus the extra change from
+    // then removing each medoid
+    double gain = 0;
+    std::fill(this->removal_loss.begin(), this->removal_loss.end(), 0);
+    for (size_t i = 0; i < this->nearest.size(); ++i) {
+      const double d = distance(i);
+      const double with_candidate = std::min(d, this->nearest_dist[i]);
+      gain += with_candidate - this->nearest_dist[i];
+      this->removal_loss[this->nearest[i]] +=
+        std::min(d, this->second_dist[i]) - with_candidate;
+    }
+    deltas.resize(this->num_medoids);
+    for (size_t s = 0; s < this->num_medoids; ++s)
+      deltas[s] = gain + this->removal_loss[s];
+  }
+
+private:
+  size_t num_medoids;
+  std::vector<size_t> nearest;
+  std::vector<double> nearest_dist;
+  std::vector<double> second_dist;
+  std::vector<double> removal_loss;
+};
+
+#endif
@@ -0,0 +1,198 @@
+/* The following applys to this software package and all subparts therein
+ *
+ * Cognosco Copyright (C) 2015 Philip J. Uren
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or (at
+ * your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+// stl includes
+#include <string>
+#include <vector>
+#include <set>
+#include <algorithm>
+#include <cstdlib>
+#include <cmath>
+
+// Cognosco includes
+#include "TiledKMedoids.hpp"
+#include "CognoscoError.hpp"
+
+// bring these into the name space...
+using std::string;
+using std::vector;
+using std::set;
+using std::shared_ptr;
+
+
+/*****************************************************************************
+ *                              CONSTRUCTORS                                 *
+ *****************************************************************************/
+
+TiledKMedoidsClusterer::TiledKMedoidsClusterer(
+    const size_t k, const TiledDistanceMatrix &dist_m,
+    const vector<string> &instance_ids) :
+  distance_matrix(dist_m), instance_ids(instance_ids),
+  points(instance_ids.size()),
+  row_instances(dist_m.size(), instance_ids.size()) {
+  for (size_t i = 0; i < instance_ids.size(); ++i) {
+    if (!dist_m.find_index(instance_ids[i], this->points[i])) {
+      throw CognoscoError("no such instance in distance matrix: " +
+                          instance_ids[i]);
+    }
+    this->row_instances[this->points[i]] = i;
+  }
+
+  // randomly assign k of the instances as medoids, as KMedoidsClusterer does
+  while (this->medoids.size() < k) {
+    int r = rand() % instance_ids.size();
+    if (medoids.find(r) == medoids.end())
+      medoids.insert(r);
+  }
+}
+
+
+/*****************************************************************************
+ *                                INSPECTORS                                 *
+ *****************************************************************************/
+
+set<string>
+TiledKMedoidsClusterer::get_medoids() const {
+  set<string> res;
+  for (auto m : this->medoids) res.insert(this->instance_ids[m]);
+  return res;
+}
+
+/**
+ * \brief get the distance from each instance to each medoid, with the
+ *        medoids in the order get_medoids() gives them; the distance from
+ *        instance i to the jth medoid is element i * k + j. Each instance's
+ *        row is read once, in order.
+ */
+vector<double>
+TiledKMedoidsClusterer::get_medoid_distances() const {
+  vector<size_t> medoids(this->medoids.begin(), this->medoids.end());
+  std::sort(medoids.begin(), medoids.end(), [this](size_t a, size_t b) {
+    return this->instance_ids[a] < this->instance_ids[b];
+  });
+  const size_t k = medoids.size();
+  vector<double> res(this->instance_ids.size() * k);
+  for (size_t b = 0; b < this->distance_matrix.num_blocks(); ++b) {
+    shared_ptr<const TiledDistanceMatrix::Block>
+      block(this->distance_matrix.get_block(b));
+    for (size_t r = block->get_first_row(); r < block->get_end_row(); ++r) {
+      const size_t i = this->row_instances[r];
+      if (i == this->instance_ids.size()) continue;
+      const float *row = block->row(r);
+      for (size_t j = 0; j < k; ++j) {
+        res[i * k + j] = (i == medoids[j]) ? 0 :
+          this->checked(row[this->points[medoids[j]]], i, medoids[j]);
+      }
+    }
+  }
+  return res;
+}
+
+/**
+ * \brief check that the distance d from instance s to instance t isn't
+ *        missing.
+ */
+double
+TiledKMedoidsClusterer::checked(const float d, const size_t s,
+                                const size_t t) const {
+  if (std::isnan(d)) {
+    throw CognoscoError("no such distance pair: " + this->instance_ids[s] +
+                        ", " + this->instance_ids[t]);
+  }
+  return d;
+}
+
+/**
+ * \brief give the scorer the given medoids, reading only their rows.
+ * \return the cost of the medoids.
+ */
+double
+TiledKMedoidsClusterer::add_medoids(const vector<size_t> &medoids,
+                                    MedoidSwapScorer &scorer) const {
+  const size_t rows_per_block = this->distance_matrix.get_rows_per_block();
+  scorer.clear();
+  for (size_t s = 0; s < medoids.size(); ++s) {
+    const size_t m = medoids[s];
+    shared_ptr<const TiledDistanceMatrix::Block> block(
+      this->distance_matrix.get_block(this->points[m] / rows_per_block));
+    const float *row = block->row(this->points[m]);
+    scorer.add_medoid(s, [&](size_t i) {
+      return (i == m) ? 0 : this->checked(row[this->points[i]], m, i);
+    });
+  }
+  return scorer.cost();
+}
+
+
+/*****************************************************************************
+ *                                 MUTATORS                                  *
+ *****************************************************************************/
+
+/**
+ * \brief improve the medoids by swapping a medoid for another instance for
+ *        as long as that lowers the cost. Each pass reads every instance's
+ *        row, in order, and scores swapping it for each medoid; the best
+ *        swap is then made, unless none lowers the cost.
+ */
+void
+TiledKMedoidsClusterer::train() {
+  const size_t n = this->instance_ids.size();
+  vector<size_t> medoids(this->medoids.begin(), this->medoids.end());
+  const size_t k = medoids.size();
+  MedoidSwapScorer scorer(k, n);
+  double cost = this->add_medoids(medoids, scorer);
+  vector<double> deltas(k);
+  while (true) {
+    double best_delta = 0;
+    size_t best_instance = n, best_medoid = 0;
+    for (size_t b = 0; b < this->distance_matrix.num_blocks(); ++b) {
+      shared_ptr<const TiledDistanceMatrix::Block>
+        block(this->distance_matrix.get_block(b));
+      for (size_t r = block->get_first_row(); r < block->get_end_row(); ++r) {
+        const size_t j = this->row_instances[r];
+        if ((j == n) || (this->medoids.find(j) != this->medoids.end()))
+          continue;
+        const float *row = block->row(r);
+        scorer.score([&](size_t i) {
+          return (i == j) ? 0 : this->checked(row[this->points[i]], j, i);
+        }, deltas);
+        for (size_t s = 0; s < k; ++s) {
+          if (deltas[s] < best_delta) {
+            best_delta = deltas[s];
+            best_instance = j;
+            best_medoid = s;
+          }
+        }
+      }
+    }
+    if (best_instance == n) break;
+
+    // make the swap, keeping it only if it really lowers the cost, so
+    // rounding can't make the search cycle
+    const size_t old_medoid = medoids[best_medoid];
+    medoids[best_medoid] = best_instance;
+    const double new_cost = this->add_medoids(medoids, scorer);
+    if (!(new_cost < cost)) {
+      medoids[best_medoid] = old_medoid;
+      break;
+    }
+    cost = new_cost;
+    this->medoids = set<size_t>(medoids.begin(), medoids.end());
+  }
+}
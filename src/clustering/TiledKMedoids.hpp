@@ -0,0 +1,77 @@
+/* The following applys to this software package and all subparts therein
+ *
+ * Cognosco Copyright (C) 2015 Philip J. Uren
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or (at
+ * your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef TILED_KMEDOIDS_HPP_
+#define TILED_KMEDOIDS_HPP_
+
+// stl includes
+#include <set>
+#include <string>
+#include <vector>
+
+// Cognosco includes
+#include "TiledDistanceMatrix.hpp"
+#include "MedoidSwap.hpp"
+
+/**
+ * \brief k-medoids clustering of a set of instances, given by name, using
+ *        the distances between them in a TiledDistanceMatrix, for matrices
+ *        too large to hold in memory. The matrix is not copied, so it must
+ *        outlive the clusterer. The initial medoids are chosen at random,
+ *        as by KMedoidsClusterer, and train() improves them by repeatedly
+ *        making whichever swap of a medoid for another instance most lowers
+ *        the cost; the sum of the distances from each medoid to the
+ *        instances closest to it.
+ *
+ *        The distance from medoid m to instance i is taken from m's row, so
+ *        the rows of the k medoids give every instance's closest and second
+ *        closest medoid. With those, one instance's row is enough to score
+ *        swapping it for each of the medoids, so train() reads the matrix a
+ *        block of rows at a time, in order, once for each swap it makes.
+ */
+class TiledKMedoidsClusterer {
+public:
+  // constructors
+  TiledKMedoidsClusterer(const size_t k, const TiledDistanceMatrix &dist_m,
+                         const std::vector<std::string> &instance_ids);
+
+  // public inspectors
+  std::set<std::string> get_medoids() const;
+  std::vector<double> get_medoid_distances() const;
+
+  // public mutators
+  void train();
+
+private:
+  // private inspectors
+  double checked(const float d, const size_t s, const size_t t) const;
+  double add_medoids(const std::vector<size_t> &medoids,
+                     MedoidSwapScorer &scorer) const;
+
+  // private instance variables; points[i] is the index in the distance
+  // matrix of instance i, and row_instances[p] is the instance whose index
+  // is p, or the number of instances if there isn't one
+  const TiledDistanceMatrix &distance_matrix;
+  std::vector<std::string> instance_ids;
+  std::vector<size_t> points;
+  std::vector<size_t> row_instances;
+  std::set<size_t> medoids;
+};
+
+#endif
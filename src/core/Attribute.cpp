@@ -62,40 +62,16 @@ Attribute::get_attribute_type_string() const {
 
 
 /*****************************************************************************
- *                      BASE ATTRIBTUE OCCURRENCE CLASS                      *
+ *                         ATTRIBTUE OCCURRENCE CLASS                        *
  *****************************************************************************/
 
-AttributeOccurrence::AttributeOccurrence(const Attribute *attr_desc) :
-    attr_desc(attr_desc) {};
-
 const string&
 AttributeOccurrence::get_attribute_name() const {
   return attr_desc->get_name();
 }
 
-
-/*****************************************************************************
- *                     NUMERIC ATTRIBTUE OCCURRENCE CLASS                    *
- *****************************************************************************/
-
-NumericAttributeOccurrence::NumericAttributeOccurrence(const double val,
-                             const Attribute *attr_desc) :
-                             AttributeOccurrence(attr_desc), value(val) {};
-
 string
-NumericAttributeOccurrence::to_string() const {
+AttributeOccurrence::to_string() const {
+  if (this->label != NULL) return *(this->label);
   return std::to_string(this->value);
 }
-
-
-/*****************************************************************************
- *                     NOMINAL ATTRIBTUE OCCURRENCE CLASS                    *
- *****************************************************************************/
-
-NominalAttributeOccurrence::NominalAttributeOccurrence(const std::string &val,
-                           const Attribute *attr_desc) :
-                           AttributeOccurrence(attr_desc), value(val) {};
-
-string NominalAttributeOccurrence::to_string() const {
-  return this->value;
-}
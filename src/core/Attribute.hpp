@@ -29,8 +29,6 @@
 // local Cognosco includes
 #include "CognoscoError.hpp"
 
-// TODO probably not required; occurrences have virtual behavior, so just
-// do what you want to do and if it isn't possible, it'll fail
 enum AttributeType {NUMERIC, ORDINAL, NOMINAL, NULL_ATTRIBUTE_TYPE};
 
 class Attribute {
@@ -52,81 +50,48 @@ private:
   AttributeType attr_type;
 };
 
+/**
+ * \brief A single value of an attribute in an instance. Occurrences are
+ *        lightweight handles built on demand from the column storage of a
+ *        Dataset (or from the values held by a detached Instance); nominal
+ *        values refer to their label rather than holding a copy of it.
+ */
 class AttributeOccurrence {
 public:
   // constructors and destructors
-  AttributeOccurrence(const Attribute *attr_desc);
-  virtual ~AttributeOccurrence() {};
-  virtual AttributeOccurrence *clone() const = 0;
+  AttributeOccurrence() : attr_desc(NULL), value(0), label(NULL) {}
+  AttributeOccurrence(const Attribute *attr_desc, const double val) :
+    attr_desc(attr_desc), value(val), label(NULL) {}
+  AttributeOccurrence(const Attribute *attr_desc, const std::string *label) :
+    attr_desc(attr_desc), value(0), label(label) {}
 
   // inspectors
-  virtual std::string to_string() const = 0;
+  std::string to_string() const;
   const std::string& get_attribute_name() const;
+  bool is_numeric() const { return this->label == NULL; }
+  const std::string& get_label() const {
+    if (this->label == NULL) {
+      throw CognoscoError("attribute " + this->get_attribute_name() +
+                          " is numeric and has no label");
+    }
+    return *(this->label);
+  }
 
   // numeric operations
-  virtual double operator *(const double d) {
-    std::stringstream ss;
-    ss << "multiplication by double for attribute "
-       << this->get_attribute_name() << " undefined";
-    throw CognoscoError(ss.str());
-  }
-  virtual double operator *(const double d) const {
-    std::stringstream ss;
-    ss << "multiplication by double for attribute "
-       << this->get_attribute_name() << " undefined";
-    throw CognoscoError(ss.str());
+  double operator *(const double d) const {
+    if (this->label != NULL) {
+      std::stringstream ss;
+      ss << "multiplication by double for attribute "
+         << this->get_attribute_name() << " undefined";
+      throw CognoscoError(ss.str());
+    }
+    return d * this->value;
   }
 
-protected:
-  // constructors
-  AttributeOccurrence(const AttributeOccurrence &ac) :
-    attr_desc(ac.attr_desc) {};
-
 private:
   const Attribute *attr_desc;
-};
-
-class NumericAttributeOccurrence : public AttributeOccurrence {
-public:
-  // constructors
-  NumericAttributeOccurrence(const double val,
-                             const Attribute *attr_desc);
-  ~NumericAttributeOccurrence() {};
-
-
-  // inspectors
-  std::string to_string() const override;
-  NumericAttributeOccurrence *clone() const {
-    return new NumericAttributeOccurrence(*this);
-  }
-
-  // numeric operations
-  double operator *(const double d) { return d * this->value; }
-  double operator *(const double d) const { return d * this->value; }
-protected:
-  NumericAttributeOccurrence(const NumericAttributeOccurrence &o) :
-    AttributeOccurrence(o), value(o.value) {}
-private:
   double value;
-};
-
-class NominalAttributeOccurrence : public AttributeOccurrence {
-public:
-  // constructors
-  NominalAttributeOccurrence(const std::string &val,
-                             const Attribute *attr_desc);
-  ~NominalAttributeOccurrence() {};
-
-  // inspectors
-  std::string to_string() const override;
-  NominalAttributeOccurrence *clone() const {
-    return new NominalAttributeOccurrence(*this);
-  }
-protected:
-  NominalAttributeOccurrence(const NominalAttributeOccurrence &o) :
-    AttributeOccurrence(o), value(o.value) {}
-private:
-  std::string value;
+  const std::string *label;
 };
 
 #endif
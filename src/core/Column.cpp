@@ -0,0 +1,379 @@
+/* The following applies to this software package and all subparts therein
+ *
+ * Cognosco Copyright (C) 2015 Philip J. Uren
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or (at
+ * your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+// stl includes
+#include <string>
+#include <vector>
+#include <sstream>
+#include <algorithm>
+#include <limits>
+
+// local Cognosco includes
+#include "Column.hpp"
+#include "CognoscoError.hpp"
+
+// bring these into the local namespace
+using std::string;
+using std::vector;
+
+/*****************************************************************************
+ *                               INSPECTORS                                  *
+ *****************************************************************************/
+
+size_t
+Column::size() const {
+  if (this->col_type == NOMINAL) return this->codes.size();
+  if (this->sparse) return this->sparse_size;
+  return this->values.size();
+}
+
+/**
+ * \brief get the value at the given row of a sparsely stored column.
+ */
+double
+Column::get_sparse_numeric(const size_t row) const {
+  auto it = std::lower_bound(this->nz_rows.begin(), this->nz_rows.end(), row);
+  if ((it == this->nz_rows.end()) || (*it != row)) return 0;
+  return this->nz_values.get(it - this->nz_rows.begin());
+}
+
+const string&
+Column::decode(const uint32_t code) const {
+  if (code >= this->dictionary.size()) {
+    std::stringstream ss;
+    ss << "cannot decode nominal value " << code << "; column has only "
+       << this->dictionary.size() << " distinct values";
+    throw CognoscoError(ss.str());
+  }
+  return this->strings->get(this->dictionary[code]);
+}
+
+/**
+ * \brief find the code used in this column for the given nominal value.
+ * \return false if the value doesn't occur in this column.
+ */
+bool
+Column::find_code(const string &label, uint32_t &code) const {
+  uint32_t string_id;
+  if (!this->strings->find(label, string_id)) return false;
+  auto it = this->string_codes.find(string_id);
+  if (it == this->string_codes.end()) return false;
+  code = it->second;
+  return true;
+}
+
+
+/*****************************************************************************
+ *                                MUTATORS                                   *
+ *****************************************************************************/
+
+/**
+ * \brief set the type of this column. Once a column holds values, its type
+ *        can no longer be changed.
+ */
+void
+Column::set_type(const AttributeType &type) {
+  if (type == this->col_type) return;
+  if (this->size() != 0) {
+    throw CognoscoError("cannot change the type of a column that already "
+                        "holds values");
+  }
+  this->col_type = type;
+}
+
+/**
+ * \brief set the precision numeric values are stored at in this column,
+ *        converting any values it already holds.
+ */
+void
+Column::set_storage(const NumericStorage &storage) {
+  this->values.set_storage(storage);
+  this->nz_values.set_storage(storage);
+}
+
+void
+Column::push_back(const double val) {
+  if (this->col_type == NULL_ATTRIBUTE_TYPE) this->col_type = NUMERIC;
+  if (this->col_type == NOMINAL) {
+    std::stringstream ss;
+    ss << "cannot add numeric value " << val << " to nominal column";
+    throw CognoscoError(ss.str());
+  }
+  if (!this->sparse) {
+    this->values.push_back(val);
+    return;
+  }
+
+  if (val != 0) {
+    this->nz_rows.push_back(this->sparse_size);
+    this->nz_values.push_back(val);
+  }
+  this->sparse_size += 1;
+  if ((this->sparse_size >= SPARSE_MIN_ROWS &&
+       this->nz_rows.size() > MAX_SPARSE_DENSITY * this->sparse_size) ||
+      (this->sparse_size == std::numeric_limits<uint32_t>::max())) {
+    this->make_dense();
+  }
+}
+
+void
+Column::push_back(const string &val) {
+  this->push_string_id(this->strings->intern(val));
+}
+
+/**
+ * \brief append a nominal value, given by its code in this column's
+ *        dictionary.
+ */
+void
+Column::push_code(const uint32_t code) {
+  if (this->col_type != NOMINAL)
+    throw CognoscoError("cannot add nominal code to non-nominal column");
+  if (code >= this->dictionary.size()) {
+    std::stringstream ss;
+    ss << "cannot add nominal code " << code << " to column with "
+       << this->dictionary.size() << " values";
+    throw CognoscoError(ss.str());
+  }
+  this->codes.push_back(code);
+}
+
+/**
+ * \brief extend this column to n rows, if it's shorter. Numeric columns are
+ *        padded with zeros, which for a sparse column only means adding to
+ *        its size; nominal columns are padded with the first value in their
+ *        dictionary.
+ */
+void
+Column::fill(const size_t n) {
+  const size_t cur_size = this->size();
+  if (n <= cur_size) return;
+  if (this->col_type == NOMINAL) {
+    if (this->dictionary.empty())
+      throw CognoscoError("cannot fill nominal column that has no values");
+    for (size_t r = cur_size; r < n; ++r) this->codes.push_back(0);
+  } else if (this->sparse && (n < std::numeric_limits<uint32_t>::max())) {
+    this->col_type = NUMERIC;
+    this->sparse_size = n;
+  } else {
+    for (size_t r = cur_size; r < n; ++r) this->push_back(0.0);
+  }
+}
+
+/**
+ * \brief append the value held at the given row of another column to this
+ *        one. Nominal values are re-encoded using this column's dictionary;
+ *        when both columns share a string table, that needs no string
+ *        hashing.
+ */
+void
+Column::push_back(const Column &other, const size_t row) {
+  if (other.col_type != NOMINAL)
+    this->push_back(other.get_numeric(row));
+  else if (other.strings != this->strings)
+    this->push_back(other.get_label(row));
+  else
+    this->push_string_id(other.dictionary[other.codes[row]]);
+}
+
+/**
+ * \brief append every value of another column to this one. Nominal values
+ *        are re-encoded through a table built from the other column's
+ *        dictionary, so each distinct value is looked up only once. Numeric
+ *        values are appended in order, exactly as push_back would, so the
+ *        result is stored sparsely or densely just as if the values had
+ *        been added one at a time; once this column is dense, the rest of
+ *        a dense column is copied in bulk.
+ */
+void
+Column::append(const Column &other) {
+  if (other.col_type == NULL_ATTRIBUTE_TYPE) return;
+  if (other.col_type == NOMINAL) {
+    if (this->col_type == NULL_ATTRIBUTE_TYPE) this->col_type = NOMINAL;
+    if (this->col_type != NOMINAL)
+      throw CognoscoError("cannot append nominal column to numeric column");
+    vector<uint32_t> recode(other.dictionary.size());
+    for (size_t c = 0; c < recode.size(); ++c) {
+      const string &label = other.strings->get(other.dictionary[c]);
+      recode[c] = this->intern_code(this->strings->intern(label));
+    }
+    for (auto code : other.codes) this->codes.push_back(recode[code]);
+    return;
+  }
+
+  if (this->col_type == NOMINAL)
+    throw CognoscoError("cannot append numeric column to nominal column");
+  const size_t n = other.size();
+  size_t r = 0, nz = 0;
+  for (; (r < n) && this->sparse; ++r) {
+    if (!other.sparse) {
+      this->push_back(other.values.get(r));
+    } else if ((nz < other.nz_rows.size()) && (other.nz_rows[nz] == r)) {
+      this->push_back(other.nz_values.get(nz));
+      nz += 1;
+    } else {
+      this->push_back(0.0);
+    }
+  }
+  if (r == n) return;
+
+  // this column is now dense
+  if (!other.sparse) {
+    this->values.append(other.values, r, n);
+    return;
+  }
+  for (; r < n; ++r) {
+    if ((nz < other.nz_rows.size()) && (other.nz_rows[nz] == r)) {
+      this->values.push_back(other.nz_values.get(nz));
+      nz += 1;
+    } else {
+      this->values.push_back(0);
+    }
+  }
+}
+
+void
+Column::reserve(const size_t n) {
+  if (this->col_type == NOMINAL) this->codes.reserve(n);
+  else if (!this->sparse) this->values.reserve(n);
+}
+
+/**
+ * \brief replace the contents of this nominal column with the given codes,
+ *        which index into the given list of distinct labels. The codes are
+ *        not checked against the labels, since that would mean touching
+ *        every one of them; callers must make sure they're in range.
+ */
+void
+Column::assign_nominal(const vector<string> &labels,
+                       const MappableVector<uint32_t> &codes) {
+  this->set_type(NOMINAL);
+  this->dictionary.clear();
+  this->string_codes.clear();
+  for (auto &label : labels) {
+    const uint32_t string_id = this->strings->intern(label);
+    if (!this->string_codes.emplace(string_id, this->dictionary.size()).second)
+      throw CognoscoError("duplicate nominal value in column: " + label);
+    this->dictionary.push_back(string_id);
+  }
+  this->codes = codes;
+}
+
+/**
+ * \brief replace the contents of this numeric column with the given
+ *        values, held densely.
+ */
+void
+Column::assign_dense(const NumericBuffer &vals) {
+  if (this->col_type == NULL_ATTRIBUTE_TYPE) this->col_type = NUMERIC;
+  if (this->col_type == NOMINAL)
+    throw CognoscoError("cannot assign numeric values to nominal column");
+  this->values = vals;
+  this->sparse = false;
+  this->sparse_size = 0;
+  this->nz_rows.clear();
+  this->nz_values.clear();
+  this->nz_values.set_storage(vals.get_storage());
+}
+
+/**
+ * \brief replace the contents of this numeric column with n values, held
+ *        sparsely as the given (sorted) rows and values of the non-zeros.
+ */
+void
+Column::assign_sparse(const size_t n, const MappableVector<uint32_t> &rows,
+                      const NumericBuffer &vals) {
+  if (rows.size() != vals.size()) {
+    std::stringstream ss;
+    ss << "cannot assign " << vals.size() << " non-zero values to "
+       << rows.size() << " rows of sparse column";
+    throw CognoscoError(ss.str());
+  }
+  if (n >= std::numeric_limits<uint32_t>::max()) {
+    std::stringstream ss;
+    ss << "cannot store " << n << " rows in a sparse column";
+    throw CognoscoError(ss.str());
+  }
+  if (this->col_type == NULL_ATTRIBUTE_TYPE) this->col_type = NUMERIC;
+  if (this->col_type == NOMINAL)
+    throw CognoscoError("cannot assign numeric values to nominal column");
+  this->sparse = true;
+  this->sparse_size = n;
+  this->nz_rows = rows;
+  this->nz_values = vals;
+  this->values.clear();
+  this->values.set_storage(vals.get_storage());
+}
+
+/**
+ * \brief move this column's nominal values to a different string table;
+ *        only the column's distinct values need re-interning.
+ */
+void
+Column::set_string_table(const std::shared_ptr<StringTable> &strings) {
+  if (strings == this->strings) return;
+  this->string_codes.clear();
+  for (uint32_t code = 0; code < this->dictionary.size(); ++code) {
+    const uint32_t string_id =
+      strings->intern(this->strings->get(this->dictionary[code]));
+    this->dictionary[code] = string_id;
+    this->string_codes.emplace(string_id, code);
+  }
+  this->strings = strings;
+}
+
+/**
+ * \brief switch a sparsely stored column to dense storage.
+ */
+void
+Column::make_dense() {
+  vector<double> dense(this->sparse_size, 0);
+  for (size_t i = 0; i < this->nz_rows.size(); ++i)
+    dense[this->nz_rows[i]] = this->nz_values.get(i);
+  this->values.assign(dense);
+  this->sparse = false;
+  this->sparse_size = 0;
+  this->nz_rows.clear();
+  this->nz_values.clear();
+}
+
+/**
+ * \brief append a nominal value, given by its id in this column's string
+ *        table.
+ */
+void
+Column::push_string_id(const uint32_t string_id) {
+  if (this->col_type == NULL_ATTRIBUTE_TYPE) this->col_type = NOMINAL;
+  if (this->col_type != NOMINAL) {
+    throw CognoscoError("cannot add nominal value " +
+                        this->strings->get(string_id) + " to numeric column");
+  }
+  this->codes.push_back(this->intern_code(string_id));
+}
+
+/**
+ * \brief get the code for a nominal value, given by its id in this
+ *        column's string table, adding it to the dictionary if it's new.
+ */
+uint32_t
+Column::intern_code(const uint32_t string_id) {
+  auto res = this->string_codes.emplace(string_id, this->dictionary.size());
+  if (res.second) this->dictionary.push_back(string_id);
+  return res.first->second;
+}
@@ -0,0 +1,140 @@
+/* The following applies to this software package and all subparts therein
+ *
+ * Cognosco Copyright (C) 2015 Philip J. Uren
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or (at
+ * your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef COLUMN_HPP_
+#define COLUMN_HPP_
+
+// stl includes
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <unordered_map>
+#include <memory>
+
+// local Cognosco includes
+#include "Attribute.hpp"
+#include "StringTable.hpp"
+#include "NumericBuffer.hpp"
+#include "MappableVector.hpp"
+#include "CognoscoError.hpp"
+
+/**
+ * \brief Storage for every value of a single attribute in a Dataset. NUMERIC
+ *        columns are a contiguous array of doubles; NOMINAL columns are a
+ *        contiguous array of codes into the column's dictionary of distinct
+ *        values. Codes are numbered from 0 in order of first appearance.
+ *        The strings themselves live in a StringTable that is normally
+ *        shared by every column of a dataset. The column type is fixed by
+ *        the first value added if it wasn't given up-front.
+ *
+ *        NUMERIC columns that are mostly zeros are stored sparsely, as the
+ *        (sorted) rows and values of their non-zero entries. Numeric columns
+ *        start out sparse and switch to dense storage once enough of their
+ *        values are non-zero, so wide mostly-zero datasets only ever take
+ *        space proportional to their number of non-zeros. Numeric values,
+ *        dense or sparse, are held at the column's chosen NumericStorage
+ *        precision.
+ *
+ *        A column's values can also be assigned in bulk, including as arrays
+ *        mapped from a dataset snapshot, in which case nothing is copied
+ *        until the column is modified.
+ */
+class Column {
+public:
+  // constructors
+  Column() : col_type(NULL_ATTRIBUTE_TYPE), sparse(true), sparse_size(0),
+             strings(new StringTable()) {}
+  explicit Column(const AttributeType &type) :
+    col_type(type), sparse(true), sparse_size(0),
+    strings(new StringTable()) {}
+  Column(const AttributeType &type,
+         const std::shared_ptr<StringTable> &strings) :
+    col_type(type), sparse(true), sparse_size(0), strings(strings) {}
+
+  // inspectors
+  const AttributeType& get_type() const { return this->col_type; }
+  size_t size() const;
+  double get_numeric(const size_t row) const {
+    if (!this->sparse) return this->values.get(row);
+    return this->get_sparse_numeric(row);
+  }
+  uint32_t get_code(const size_t row) const { return this->codes[row]; }
+  const std::string& get_label(const size_t row) const {
+    return this->strings->get(this->dictionary[this->codes[row]]);
+  }
+  const std::string& decode(const uint32_t code) const;
+  bool find_code(const std::string &label, uint32_t &code) const;
+  size_t num_labels() const { return this->dictionary.size(); }
+  NumericStorage get_storage() const { return this->values.get_storage(); }
+  const NumericBuffer& numeric_values() const { return this->values; }
+  const uint32_t* code_data() const { return this->codes.data(); }
+  bool is_sparse() const {
+    return (this->col_type == NUMERIC) && this->sparse;
+  }
+  const MappableVector<uint32_t>& nonzero_rows() const {
+    return this->nz_rows;
+  }
+  const NumericBuffer& nonzero_values() const { return this->nz_values; }
+
+  // mutators
+  void set_type(const AttributeType &type);
+  void set_storage(const NumericStorage &storage);
+  void push_back(const double val);
+  void push_back(const std::string &val);
+  void push_code(const uint32_t code);
+  void fill(const size_t n);
+  void reserve(const size_t n);
+  void push_back(const Column &other, const size_t row);
+  void append(const Column &other);
+  void assign_nominal(const std::vector<std::string> &labels,
+                      const MappableVector<uint32_t> &codes);
+  void assign_dense(const NumericBuffer &vals);
+  void assign_sparse(const size_t n, const MappableVector<uint32_t> &rows,
+                     const NumericBuffer &vals);
+  void set_string_table(const std::shared_ptr<StringTable> &strings);
+
+private:
+  // private instance variables
+  AttributeType col_type;
+  NumericBuffer values;
+  MappableVector<uint32_t> codes;
+  bool sparse;
+  size_t sparse_size;
+  MappableVector<uint32_t> nz_rows;
+  NumericBuffer nz_values;
+  std::shared_ptr<StringTable> strings;
+  std::vector<uint32_t> dictionary;
+  std::unordered_map<uint32_t, uint32_t> string_codes;
+
+  // private constants -- a sparse column becomes dense once it has at least
+  // SPARSE_MIN_ROWS rows, and more than MAX_SPARSE_DENSITY of them are
+  // non-zero.
+  static const size_t SPARSE_MIN_ROWS = 64;
+  static constexpr double MAX_SPARSE_DENSITY = 0.5;
+
+  // private inspectors
+  double get_sparse_numeric(const size_t row) const;
+
+  // private mutators
+  void push_string_id(const uint32_t string_id);
+  uint32_t intern_code(const uint32_t string_id);
+  void make_dense();
+};
+
+#endif
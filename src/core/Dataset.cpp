@@ -24,6 +24,9 @@
 #include <string>
 #include <vector>
 #include <cassert>
+#include <cmath>
+#include <algorithm>
+#include <utility>
 
 // local Cognosco includes
 #include "Dataset.hpp"
@@ -34,25 +37,234 @@
 using std::string;
 using std::vector;
 
-Dataset::Dataset(const Dataset &d, const std::set<size_t> exclude_insts) {
-  for (auto it = d.instances.begin(); it != d.instances.end(); ++it) {
-    if (exclude_insts.find(it->get_instance_id()) == exclude_insts.end()) {
-      this->instances.push_back(*it);
-    }
-  }
-  for (auto att_descr : d.att_descr_ptrs) {
+/*****************************************************************************
+ *                       CONSTRUCTORS AND DESTRUCTORS                        *
+ *****************************************************************************/
+
+/**
+ * \brief copy a dataset; the copy has its own attribute descriptions and
+ *        columns, but shares the (append-only) string table of the original.
+ */
+Dataset::Dataset(const Dataset &d) :
+  columns(d.columns), instance_ids(d.instance_ids), att_index(d.att_index),
+  row_index(d.row_index), string_table(d.string_table),
+  numeric_storage(d.numeric_storage) {
+  this->att_descr_ptrs.reserve(d.att_descr_ptrs.size());
+  for (auto att_descr : d.att_descr_ptrs)
     this->att_descr_ptrs.push_back(new Attribute(*att_descr));
-  }
 }
 
+Dataset::~Dataset() {
+  for (auto att_descr : this->att_descr_ptrs) delete att_descr;
+}
+
+
+/*****************************************************************************
+ *                                MUTATORS                                   *
+ *****************************************************************************/
+
+void
+Dataset::swap(Dataset &d) {
+  std::swap(this->att_descr_ptrs, d.att_descr_ptrs);
+  std::swap(this->columns, d.columns);
+  std::swap(this->instance_ids, d.instance_ids);
+  std::swap(this->att_index, d.att_index);
+  std::swap(this->row_index, d.row_index);
+  std::swap(this->string_table, d.string_table);
+  std::swap(this->numeric_storage, d.numeric_storage);
+}
+
+/**
+ * \brief add a copy of the given instance's values to the dataset. The
+ *        instance must have one value per attribute in the dataset, given
+ *        in the same order as the dataset's attributes.
+ */
 void
 Dataset::add_instance(const Instance &inst) {
-  this->instances.push_back(inst);
+  if (inst.size() != this->num_attributes()) {
+    std::stringstream ss;
+    ss << "cannot add instance with " << inst.size() << " attributes to "
+       << "dataset with " << this->num_attributes() << " attributes";
+    throw CognoscoError(ss.str());
+  }
+  size_t k = 0;
+  for (auto it = inst.begin(); it != inst.end(); ++it, ++k)
+    this->add_value(k, *it);
+  this->add_instance_id(inst.get_instance_id());
+}
+
+/**
+ * \brief add a new instance with the given values, one per attribute in the
+ *        same order as the dataset's attributes. The values are written
+ *        straight into the dataset's columns, so no Instance is built; this
+ *        is the cheaper way for loaders to fill a dataset. The new instance
+ *        is given a fresh id.
+ */
+void
+Dataset::add_instance(const vector<AttributeOccurrence> &values) {
+  if (values.size() != this->num_attributes()) {
+    std::stringstream ss;
+    ss << "cannot add instance with " << values.size() << " attributes to "
+       << "dataset with " << this->num_attributes() << " attributes";
+    throw CognoscoError(ss.str());
+  }
+  for (size_t k = 0; k < values.size(); ++k)
+    this->add_value(k, values[k]);
+  this->add_instance_id(Instance::new_instance_id());
+}
+
+/**
+ * \brief reserve space for n instances in every column, so a dataset of
+ *        known size is filled without re-allocating its storage.
+ */
+void
+Dataset::reserve(const size_t n) {
+  for (auto &col : this->columns) col.reserve(n);
+  this->instance_ids.reserve(n);
+}
+
+/**
+ * \brief append the given value to the kth column. Doesn't update the
+ *        instance ids; callers must add a value to every column and then
+ *        call add_instance_id.
+ */
+void
+Dataset::add_value(const size_t k, const AttributeOccurrence &occ) {
+  if (occ.get_attribute_name() != this->att_descr_ptrs[k]->get_name()) {
+    throw CognoscoError("cannot add instance to dataset; expected "
+                        "attribute " + this->att_descr_ptrs[k]->get_name() +
+                        " but found " + occ.get_attribute_name());
+  }
+  if (occ.is_numeric()) this->columns[k].push_back(occ * 1.0);
+  else this->columns[k].push_back(occ.get_label());
+  if (this->att_descr_ptrs[k]->get_attribute_type() == NULL_ATTRIBUTE_TYPE)
+    this->att_descr_ptrs[k]->set_type(this->columns[k].get_type());
+}
+
+/**
+ * \brief record the id of the instance in the next row. Loaders hand out
+ *        consecutive ids, so only ids that break the run started by the
+ *        first row need to go in the row index; see get_row.
+ */
+void
+Dataset::add_instance_id(const size_t instance_id) {
+  if (!this->instance_ids.empty() &&
+      (instance_id != this->instance_ids.front() + this->instance_ids.size()))
+    this->row_index.emplace(instance_id, this->instance_ids.size());
+  this->instance_ids.push_back(instance_id);
 }
 
 void
 Dataset::add_attribute(const Attribute &att_desc) {
+  if (this->size() != 0) {
+    throw CognoscoError("cannot add attribute " + att_desc.get_name() +
+                        " to a dataset that already has instances");
+  }
+  if (this->has_attribute(att_desc.get_name())) {
+    throw CognoscoError("cannot add attribute " + att_desc.get_name() +
+                        " to dataset; an attribute with that name exists");
+  }
+  this->att_index[att_desc.get_name()] = this->att_descr_ptrs.size();
   att_descr_ptrs.push_back(new Attribute(att_desc));
+  this->columns.push_back(Column(att_desc.get_attribute_type(),
+                                 this->string_table));
+  this->columns.back().set_storage(this->numeric_storage);
+}
+
+/**
+ * \brief set the precision numeric values are stored at, for every column
+ *        in the dataset and any added to it later. Values already held are
+ *        converted. Quantized columns are re-quantized whenever a value
+ *        outside their range is added, so that storage is best chosen once
+ *        the dataset is loaded; single precision can be chosen up-front.
+ */
+void
+Dataset::set_numeric_storage(const NumericStorage &storage) {
+  this->numeric_storage = storage;
+  for (auto &col : this->columns) col.set_storage(storage);
+}
+
+/**
+ * \brief fill a dataset that has attributes but no instances with the given
+ *        columns, one per attribute and in the same order; the columns are
+ *        taken from the vector, which is left holding empty ones. This lets
+ *        loaders build whole columns (for example, mapped from a snapshot)
+ *        without going through add_instance. The new instances are given
+ *        fresh, consecutive ids.
+ */
+void
+Dataset::set_columns(vector<Column> &cols) {
+  if (this->size() != 0) {
+    throw CognoscoError("cannot set the columns of a dataset that already "
+                        "has instances");
+  }
+  if (cols.size() != this->num_attributes()) {
+    std::stringstream ss;
+    ss << "cannot set " << cols.size() << " columns in dataset with "
+       << this->num_attributes() << " attributes";
+    throw CognoscoError(ss.str());
+  }
+
+  const size_t n = cols.empty() ? 0 : cols.front().size();
+  for (size_t k = 0; k < cols.size(); ++k) {
+    const AttributeType &att_type = this->get_attribute_type(k);
+    if (cols[k].size() != n) {
+      std::stringstream ss;
+      ss << "cannot set columns of differing sizes; column " << k << " has "
+         << cols[k].size() << " values, but column 0 has " << n;
+      throw CognoscoError(ss.str());
+    }
+    if ((att_type != NULL_ATTRIBUTE_TYPE) && (cols[k].get_type() != att_type)) {
+      throw CognoscoError("cannot set column for attribute " +
+                          this->att_descr_ptrs[k]->get_name() +
+                          "; column has the wrong type");
+    }
+  }
+
+  for (size_t k = 0; k < cols.size(); ++k) {
+    cols[k].set_string_table(this->string_table);
+    cols[k].set_storage(this->numeric_storage);
+    std::swap(this->columns[k], cols[k]);
+    if (this->columns[k].get_type() != NULL_ATTRIBUTE_TYPE)
+      this->att_descr_ptrs[k]->set_type(this->columns[k].get_type());
+  }
+  const size_t first_id = Instance::new_instance_ids(n);
+  this->instance_ids.resize(n);
+  for (size_t r = 0; r < n; ++r) this->instance_ids[r] = first_id + r;
+}
+
+/**
+ * \brief append the rows held in the given columns, one per attribute and
+ *        in the same order, to the dataset. This lets loaders that build
+ *        blocks of rows separately (on worker threads, for example) add
+ *        them a whole column at a time. The new instances are given fresh,
+ *        consecutive ids in row order.
+ */
+void
+Dataset::append_columns(const vector<Column> &cols) {
+  if (cols.size() != this->num_attributes()) {
+    std::stringstream ss;
+    ss << "cannot append " << cols.size() << " columns to dataset with "
+       << this->num_attributes() << " attributes";
+    throw CognoscoError(ss.str());
+  }
+  const size_t n = cols.empty() ? 0 : cols.front().size();
+  for (size_t k = 0; k < cols.size(); ++k) {
+    if (cols[k].size() != n) {
+      std::stringstream ss;
+      ss << "cannot append columns of differing sizes; column " << k
+         << " has " << cols[k].size() << " values, but column 0 has " << n;
+      throw CognoscoError(ss.str());
+    }
+  }
+
+  for (size_t k = 0; k < cols.size(); ++k) {
+    this->columns[k].append(cols[k]);
+    if (this->att_descr_ptrs[k]->get_attribute_type() == NULL_ATTRIBUTE_TYPE)
+      this->att_descr_ptrs[k]->set_type(this->columns[k].get_type());
+  }
+  const size_t first_id = Instance::new_instance_ids(n);
+  for (size_t r = 0; r < n; ++r) this->add_instance_id(first_id + r);
 }
 
 void
@@ -65,29 +277,66 @@ Dataset::delete_attribute(const Attribute *att_desc) {
        << " from dataset; no such attribute";
     throw CognoscoError(ss.str());
   }
-  for (auto it = instances.begin(); it != instances.end(); ++it) {
-    it->delete_attribute_occurrence(att_desc->get_name());
-  }
 
+  const size_t k = to_del - this->att_descr_ptrs.begin();
+  this->columns.erase(this->columns.begin() + k);
   this->att_descr_ptrs.erase(to_del);
   delete (att_desc);
+  this->index_attributes();
 }
 
 void
 Dataset::delete_attribute(const string &name) {
-  Attribute* ptr = NULL;
-  for (auto at_ptr : this->att_descr_ptrs) {
-    if (at_ptr->get_name() == name) {
-      ptr = at_ptr;
-    }
-  }
-  if (ptr == NULL) {
+  auto it = this->att_index.find(name);
+  if (it == this->att_index.end()) {
     std::stringstream ss;
     ss << "Cannot delete attribute " << name
        << " from dataset; no such attribute";
     throw CognoscoError(ss.str());
   }
-  this->delete_attribute(ptr);
+  this->delete_attribute(this->att_descr_ptrs[it->second]);
+}
+
+/**
+ * \brief rebuild the index from attribute name to column number
+ */
+void
+Dataset::index_attributes() {
+  this->att_index.clear();
+  for (size_t k = 0; k < this->att_descr_ptrs.size(); ++k) {
+    this->att_index[this->att_descr_ptrs[k]->get_name()] = k;
+  }
+}
+
+size_t
+Dataset::get_attribute_index(const string &name) const {
+  auto it = this->att_index.find(name);
+  if (it == this->att_index.end()) {
+    std::stringstream ss;
+    ss << "No such attribute: " << name;
+    throw CognoscoError(ss.str());
+  }
+  return it->second;
+}
+
+/**
+ * \brief get the row in this dataset that holds the instance with the given
+ *        id.
+ */
+size_t
+Dataset::get_row(const size_t instance_id) const {
+  if (!this->instance_ids.empty()) {
+    const size_t row = instance_id - this->instance_ids.front();
+    if ((row < this->size()) && (this->instance_ids[row] == instance_id))
+      return row;
+  }
+  auto it = this->row_index.find(instance_id);
+  if (it == this->row_index.end()) {
+    std::stringstream ss;
+    ss << "No instance with id " << instance_id;
+    throw CognoscoError(ss.str());
+  }
+  return it->second;
 }
 
 const Attribute*
@@ -109,11 +358,10 @@ Dataset::to_csv(const string &sep) const {
     ss << this->att_descr_ptrs[i]->get_name();
   }
   ss << std::endl;
-  for (size_t i = 0; i < this->instances.size(); ++i) {
+  for (auto inst = this->begin(); inst != this->end(); ++inst) {
     for (size_t j = 0; j < this->att_descr_ptrs.size(); ++j) {
-      std::cerr << "instance " << i << "; attribute " << j << std::endl;
       if (j != 0) ss << sep << " ";
-      ss << this->instances[i].get_att_occurrence(j)->to_string();
+      ss << inst->get_att_occurrence(j).to_string();
     }
     ss << std::endl;
   }
@@ -129,6 +377,7 @@ Dataset::set_attribute_type(const size_t k, const AttributeType &type) {
        << " attributes";
     throw CognoscoError(ss.str());
   }
+  this->columns[k].set_type(type);
   this->att_descr_ptrs[k]->set_type(type);
 }
 
@@ -164,33 +413,37 @@ DatasetSplit::DatasetSplit(const Dataset &d, const size_t k,
   this->update_label_counts(d);
 }
 
+/**
+ * get the column holding the attribute this split is stratified on; it must
+ * be nominal.
+ */
+const Column&
+DatasetSplit::get_label_column(const Dataset &d) const {
+  const Column &col = d.get_column(d.get_attribute_index(this->label_split_upon));
+  if (col.get_type() != NOMINAL) {
+    throw CognoscoError("cannot stratify dataset on attribute " +
+                        this->label_split_upon + "; it is not nominal");
+  }
+  return col;
+}
+
 /**
  * for a given attribute, count the number of times each of its values appears
  * in each fold.
  *
- * \return unordered_map indexed first by attribute-value, then by fold number
+ * \return vector indexed first by attribute-value code, then by fold number
  *         the value being the count of occurrences for that label in that
  *         fold.
  */
 void
 DatasetSplit::update_label_counts(const Dataset &d) {
-  // set everything back to 0
-  for (auto c_iter = this->att_counts_per_fold.begin();
-       c_iter != this->att_counts_per_fold.end(); ++c_iter) {
-    for (size_t i = 0; i < c_iter->second.size(); ++i) {
-      c_iter->second[i] = 0;
-    }
-  }
-
+  const Column &col = this->get_label_column(d);
+  this->att_counts_per_fold.assign(col.num_labels(),
+    vector<double>(this->assignments.size(), 0));
   for (size_t k = 0; k < this->assignments.size(); ++k) {
     for (size_t j = 0; j < this->assignments[k].size(); ++j) {
       const size_t inst_id (this->assignments[k][j]);
-      const string inst_label = d[inst_id][this->label_split_upon]->to_string();
-      if (this->att_counts_per_fold.find(inst_label) ==\
-          this->att_counts_per_fold.end()) {
-        this->att_counts_per_fold[inst_label].resize(this->assignments.size());
-      }
-      this->att_counts_per_fold[inst_label][k] += 1;
+      this->att_counts_per_fold[col.get_code(d.get_row(inst_id))][k] += 1;
     }
   }
 }
@@ -198,12 +451,10 @@ DatasetSplit::update_label_counts(const Dataset &d) {
 double
 DatasetSplit::distance(const AttFoldCounts &fcs) const {
   double dist = 0;
-  for (auto att_counts : fcs) {
-    const string attribute_name (att_counts.first);
-    const vector<double> fold_counts_other (att_counts.second);
-    const vector<double> &fold_counts_this =\
-      this->get_fold_counts(attribute_name);
-    this->att_counts_per_fold.find(attribute_name);
+  assert(fcs.size() == this->att_counts_per_fold.size());
+  for (size_t code = 0; code < fcs.size(); ++code) {
+    const vector<double> &fold_counts_other (fcs[code]);
+    const vector<double> &fold_counts_this (this->att_counts_per_fold[code]);
     assert(fold_counts_other.size() == fold_counts_this.size());
     for (size_t i = 0; i < fold_counts_other.size(); ++i) {
       dist += fabs(fold_counts_other[i] - fold_counts_this[i]);
@@ -213,29 +464,26 @@ DatasetSplit::distance(const AttFoldCounts &fcs) const {
 }
 
 
-const vector<double>&
-DatasetSplit::get_fold_counts(const string &att_label) const {
-  auto it = this->att_counts_per_fold.find(att_label);
-  if (it == this->att_counts_per_fold.end()) {
-    std::stringstream ss;
-    ss << "no such label " << att_label;
-    throw CognoscoError(ss.str());
-  }
-  return it->second;
-}
-
-
+/**
+ * swap two instances between folds; the label counts for the two folds are
+ * adjusted for the instances that moved.
+ */
 void
 DatasetSplit::swap(const FoldInstancePair &one,
                    const FoldInstancePair &two,
                    const Dataset &d) {
-  size_t tmp_instance_id = this->assignments[one.first][one.second];
-  this->assignments[one.first][one.second] =\
-    this->assignments[two.first][two.second];
-  this->assignments[two.first][two.second] = tmp_instance_id;
-
-  // lazy .. could just update the ones we changed -- TODO
-  this->update_label_counts(d);
+  const Column &col = this->get_label_column(d);
+  const size_t id_one = this->assignments[one.first][one.second];
+  const size_t id_two = this->assignments[two.first][two.second];
+  this->assignments[one.first][one.second] = id_two;
+  this->assignments[two.first][two.second] = id_one;
+
+  const uint32_t code_one = col.get_code(d.get_row(id_one));
+  const uint32_t code_two = col.get_code(d.get_row(id_two));
+  this->att_counts_per_fold[code_one][one.first] -= 1;
+  this->att_counts_per_fold[code_one][two.first] += 1;
+  this->att_counts_per_fold[code_two][two.first] -= 1;
+  this->att_counts_per_fold[code_two][one.first] += 1;
 }
 
 std::pair<FoldInstancePair, FoldInstancePair>
@@ -264,8 +512,9 @@ DatasetSplitter::split(const Dataset &d,
   AttFoldCounts ideal_counts =\
     this->compute_ideal_counts(d, class_label);
   if (DEBUG) {
-    for (auto kvp : ideal_counts) {
-      std::cerr << kvp.first << ": " << join(kvp.second, ",");
+    const Column &col = d.get_column(d.get_attribute_index(class_label));
+    for (size_t code = 0; code < ideal_counts.size(); ++code) {
+      std::cerr << col.decode(code) << ": " << join(ideal_counts[code], ",");
     }
   }
   double current_score = assignments.distance(ideal_counts);
@@ -306,16 +555,19 @@ DatasetSplitter::split(const Dataset &d,
 AttFoldCounts
 DatasetSplitter::compute_ideal_counts(const Dataset &d,
                                       const string &att_name) const {
-  AttFoldCounts r_count;
-  for (Dataset::const_iterator inst = d.begin(); inst != d.end(); ++inst) {
-    const string att_value = (*inst)[att_name]->to_string();
-    r_count[att_value].resize(this->num_folds);
+  const Column &col = d.get_column(d.get_attribute_index(att_name));
+  if (col.get_type() != NOMINAL) {
+    throw CognoscoError("cannot stratify dataset on attribute " + att_name +
+                        "; it is not nominal");
+  }
+  AttFoldCounts r_count(col.num_labels(), vector<double>(this->num_folds, 0));
+  for (size_t r = 0; r < d.size(); ++r) {
     for (size_t j = 0; j < this->num_folds; ++j)
-      r_count[att_value][j] += 1;
+      r_count[col.get_code(r)][j] += 1;
   }
   for (auto it = r_count.begin(); it != r_count.end(); ++it) {
     for (size_t j = 0; j < this->num_folds; ++j)
-      it->second[j] /= this->num_folds;
+      (*it)[j] /= this->num_folds;
   }
   return r_count;
 }
@@ -25,72 +25,114 @@
 #include <sstream>
 #include <unordered_map>
 #include <set>
+#include <memory>
 
 #include "Instance.hpp"
+#include "Column.hpp"
+#include "StringTable.hpp"
+#include "NumericBuffer.hpp"
 #include "Attribute.hpp"
 #include "CognoscoError.hpp"
 
+/**
+ * \brief A Dataset stores its values column-wise; one Column per attribute.
+ *        Instances handed out by a Dataset (by iteration or by id) are views
+ *        onto a row of that column storage. A Dataset owns its attribute
+ *        descriptions; copying a dataset copies those and its columns, and
+ *        moving one transfers them. Views of a dataset aren't carried over
+ *        by either.
+ */
 class Dataset {
 public:
   // constructors and destructors
-  Dataset() : instances(std::vector<Instance>()),
-              att_descr_ptrs(std::vector<Attribute*>()) {}
+  Dataset() : att_descr_ptrs(std::vector<Attribute*>()),
+              string_table(new StringTable()),
+              numeric_storage(DOUBLE_STORAGE) {}
   Dataset(const Dataset &d);
-  Dataset(const Dataset &d, const std::set<size_t> exclude_insts);
-  //~Dataset();
+  Dataset(Dataset &&d) : Dataset() { this->swap(d); }
+  Dataset& operator=(Dataset d) { this->swap(d); return *this; }
+  ~Dataset();
 
   // types
-  typedef std::vector<Instance>::iterator iterator;
-  typedef std::vector<Instance>::const_iterator const_iterator;
+  class const_iterator {
+  public:
+    const_iterator(const Dataset *d, const size_t row) :
+      d(d), row(row), current(Instance::Unbound()) {}
+    const Instance& operator*() const {
+      this->current = Instance(this->d, this->row);
+      return this->current;
+    }
+    const Instance* operator->() const { return &(**this); }
+    const_iterator& operator++() { this->row += 1; return *this; }
+    bool operator==(const const_iterator &o) const { return row == o.row; }
+    bool operator!=(const const_iterator &o) const { return row != o.row; }
+  private:
+    const Dataset *d;
+    size_t row;
+    mutable Instance current;
+  };
   typedef std::vector<Attribute*>::const_iterator const_attribute_iterator;
 
   // inspectors
   bool has_attribute(const std::string &name) const {
-    // TODO fix nasty O(n)
-    for (size_t i = 0; i < this->att_descr_ptrs.size(); ++i) {
-      if (this->att_descr_ptrs[i]->get_name() == name)
-        return true;
-    }
-    return false;
+    return this->att_index.find(name) != this->att_index.end();
   }
+  size_t get_attribute_index(const std::string &name) const;
   const Attribute* get_attribute_description_ptr(size_t k) const;
+  const Column& get_column(const size_t k) const { return this->columns[k]; }
+  size_t get_instance_id(const size_t row) const {
+    return this->instance_ids[row];
+  }
   std::string to_csv(const std::string &sep = ",") const;
-  const_iterator begin() const { return this->instances.begin(); }
-  const_iterator end() const { return this->instances.end(); }
+  const_iterator begin() const { return const_iterator(this, 0); }
+  const_iterator end() const { return const_iterator(this, this->size()); }
   const_attribute_iterator begin_attributes() const { return this->att_descr_ptrs.begin(); }
   const_attribute_iterator end_attributes() const { return this->att_descr_ptrs.end(); }
-  size_t size() const { return instances.size(); }
+  size_t size() const { return this->instance_ids.size(); }
   size_t num_attributes() const { return this->att_descr_ptrs.size(); }
   const AttributeType& get_attribute_type(const size_t k) const;
-  const Instance& operator[] (const int instance_id) const {
-    // TODO fix nasty O(n)
-    for (size_t i = 0; i < this->instances.size(); ++i) {
-      if (this->instances[i].get_instance_id() == instance_id)
-        return this->instances[i];
-    }
-    std::stringstream ss;
-    ss << "No instance with id " << instance_id;
-    throw CognoscoError(ss.str());
+  NumericStorage get_numeric_storage() const {
+    return this->numeric_storage;
+  }
+  size_t get_row(const size_t instance_id) const;
+  Instance operator[] (const size_t instance_id) const {
+    return Instance(this, this->get_row(instance_id));
   }
 
   // mutators
+  void swap(Dataset &d);
   void add_attribute(const Attribute &att_desc);
   void add_instance(const Instance &instance);
+  void add_instance(const std::vector<AttributeOccurrence> &values);
+  void reserve(const size_t n);
   void set_attribute_type(const size_t k, const AttributeType &type);
+  void set_numeric_storage(const NumericStorage &storage);
+  void set_columns(std::vector<Column> &cols);
+  void append_columns(const std::vector<Column> &cols);
   void delete_attribute(const std::string &name);
-  iterator begin() { return this->instances.begin(); }
-  iterator end() { return this->instances.end(); }
 
 private:
   // private instance variables
-  std::vector<Instance> instances;
   std::vector<Attribute*> att_descr_ptrs;
+  std::vector<Column> columns;
+  std::vector<size_t> instance_ids;
+  std::unordered_map<std::string, size_t> att_index;
+  std::unordered_map<size_t, size_t> row_index;
+  std::shared_ptr<StringTable> string_table;
+  NumericStorage numeric_storage;
 
   // private mutators
+  void add_value(const size_t k, const AttributeOccurrence &occ);
+  void add_instance_id(const size_t instance_id);
   void delete_attribute(const Attribute *att_desc);
+  void index_attributes();
 };
 
-typedef std::unordered_map<std::string, std::vector<double> > AttFoldCounts;
+/**
+ * counts of each value of a nominal attribute per fold; indexed first by the
+ * value's code in the dataset's column for that attribute, then by fold.
+ */
+typedef std::vector<std::vector<double> > AttFoldCounts;
 typedef std::pair<size_t, size_t> FoldInstancePair;
 
 class DatasetSplit {
@@ -124,7 +166,7 @@ private:
   AttFoldCounts att_counts_per_fold;
 
   // private inspectors
-  const std::vector<double>& get_fold_counts(const std::string &att_label) const;
+  const Column& get_label_column(const Dataset &d) const;
 
   // private mutators
   void update_label_counts(const Dataset &d);
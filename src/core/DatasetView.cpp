@@ -0,0 +1,149 @@
+/* The following applies to this software package and all subparts therein
+ *
+ * Cognosco Copyright (C) 2015 Philip J. Uren
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or (at
+ * your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+// stl includes
+#include <string>
+#include <vector>
+#include <set>
+#include <sstream>
+#include <unordered_map>
+
+// local Cognosco includes
+#include "DatasetView.hpp"
+#include "CognoscoError.hpp"
+
+// bring these into the local namespace
+using std::string;
+using std::vector;
+using std::set;
+
+/*****************************************************************************
+ *                       CONSTRUCTORS AND DESTRUCTORS                        *
+ *****************************************************************************/
+
+/**
+ * \brief a view of every row of the given dataset.
+ */
+DatasetView::DatasetView(const Dataset &d) :
+  dataset(&d), rows(d.size()), projected(false) {
+  for (size_t r = 0; r < this->rows.size(); ++r) this->rows[r] = r;
+}
+
+/**
+ * \brief a view of the given rows of the dataset.
+ */
+DatasetView::DatasetView(const Dataset &d, const vector<size_t> &rows) :
+  dataset(&d), rows(rows), projected(false) {
+  for (auto r : this->rows) {
+    if (r >= d.size()) {
+      std::stringstream ss;
+      ss << "cannot view row " << r << " of dataset with only " << d.size()
+         << " rows";
+      throw CognoscoError(ss.str());
+    }
+  }
+}
+
+/**
+ * \brief a view of every row of the dataset except those holding the given
+ *        instances (given by instance ID). Rows keep their dataset order.
+ */
+DatasetView::DatasetView(const Dataset &d, const set<size_t> &exclude_insts) :
+  dataset(&d), projected(false) {
+  vector<bool> excluded(d.size(), false);
+  for (auto inst_id : exclude_insts) excluded[d.get_row(inst_id)] = true;
+  this->rows.reserve(d.size() - exclude_insts.size());
+  for (size_t r = 0; r < d.size(); ++r)
+    if (!excluded[r]) this->rows.push_back(r);
+}
+
+/**
+ * \brief a view of the rows of the dataset whose entry in the mask is true.
+ *        The mask must have one entry per row.
+ */
+DatasetView::DatasetView(const Dataset &d, const vector<bool> &row_mask) :
+  dataset(&d), projected(false) {
+  if (row_mask.size() != d.size()) {
+    std::stringstream ss;
+    ss << "row mask has " << row_mask.size() << " entries, but dataset has "
+       << d.size() << " rows";
+    throw CognoscoError(ss.str());
+  }
+  for (size_t r = 0; r < d.size(); ++r)
+    if (row_mask[r]) this->rows.push_back(r);
+}
+
+/**
+ * \brief a projection of a view onto the named attributes; the result has
+ *        the same rows as the view, and its attributes are those named, in
+ *        the order given. Nothing is copied from the dataset.
+ */
+DatasetView::DatasetView(const DatasetView &v, const vector<string> &att_names) :
+  dataset(v.dataset), rows(v.rows), projected(true) {
+  for (auto &name : att_names) {
+    if (this->att_index.find(name) != this->att_index.end()) {
+      throw CognoscoError("cannot project dataset onto attribute " + name +
+                          " more than once");
+    }
+    const size_t k = v.get_column_index(v.get_attribute_index(name));
+    this->att_index[name] = this->columns.size();
+    this->columns.push_back(k);
+    this->att_descr_ptrs.push_back(
+      const_cast<Attribute*>(this->dataset->get_attribute_description_ptr(k)));
+  }
+}
+
+
+/*****************************************************************************
+ *                               INSPECTORS                                  *
+ *****************************************************************************/
+
+size_t
+DatasetView::num_attributes() const {
+  if (this->projected) return this->columns.size();
+  return this->dataset->num_attributes();
+}
+
+bool
+DatasetView::has_attribute(const string &name) const {
+  if (this->projected) return this->att_index.find(name) != this->att_index.end();
+  return this->dataset->has_attribute(name);
+}
+
+size_t
+DatasetView::get_attribute_index(const string &name) const {
+  if (!this->projected) return this->dataset->get_attribute_index(name);
+  auto it = this->att_index.find(name);
+  if (it == this->att_index.end()) {
+    throw CognoscoError("No such attribute: " + name);
+  }
+  return it->second;
+}
+
+/**
+ * \brief get a mask over the attributes of this view that is true for every
+ *        attribute except those named; names not in the view are ignored.
+ */
+vector<bool>
+DatasetView::get_attribute_mask(const set<string> &exclude_atts) const {
+  vector<bool> mask(this->num_attributes(), true);
+  for (auto &name : exclude_atts)
+    if (this->has_attribute(name)) mask[this->get_attribute_index(name)] = false;
+  return mask;
+}
@@ -0,0 +1,124 @@
+/* The following applies to this software package and all subparts therein
+ *
+ * Cognosco Copyright (C) 2015 Philip J. Uren
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or (at
+ * your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef DATASET_VIEW_HPP_
+#define DATASET_VIEW_HPP_
+
+// stl includes
+#include <string>
+#include <vector>
+#include <set>
+#include <unordered_map>
+
+// local Cognosco includes
+#include "Dataset.hpp"
+#include "Instance.hpp"
+#include "Column.hpp"
+#include "Attribute.hpp"
+
+/**
+ * \brief A DatasetView is a subset of the rows of a Dataset, given as a list
+ *        of row indices into that dataset; nothing is copied from the
+ *        dataset itself. Rows are seen in the order they appear in the
+ *        list. A view can also be a projection onto a subset of the
+ *        dataset's attributes, in which case it maps each of its attributes
+ *        to a column of the dataset and exposes only those attributes,
+ *        including in the instances it hands out. A Dataset converts
+ *        implicitly to a view of all of its rows and attributes. A view is
+ *        only valid for as long as the Dataset it refers to is alive and
+ *        unmodified.
+ */
+class DatasetView {
+public:
+  // constructors
+  DatasetView(const Dataset &d);
+  DatasetView(const Dataset &d, const std::vector<size_t> &rows);
+  DatasetView(const Dataset &d, const std::set<size_t> &exclude_insts);
+  DatasetView(const Dataset &d, const std::vector<bool> &row_mask);
+  DatasetView(const DatasetView &v, const std::vector<std::string> &att_names);
+
+  // types
+  class const_iterator {
+  public:
+    const_iterator(const DatasetView *v, const size_t i) :
+      v(v), i(i), current(Instance::Unbound()) {}
+    const Instance& operator*() const {
+      this->current = Instance(&(this->v->get_dataset()), this->v->rows[i],
+                               this->v->projected ? this->v : NULL);
+      return this->current;
+    }
+    const Instance* operator->() const { return &(**this); }
+    const_iterator& operator++() { this->i += 1; return *this; }
+    bool operator==(const const_iterator &o) const { return i == o.i; }
+    bool operator!=(const const_iterator &o) const { return i != o.i; }
+  private:
+    const DatasetView *v;
+    size_t i;
+    mutable Instance current;
+  };
+  typedef Dataset::const_attribute_iterator const_attribute_iterator;
+
+  // inspectors
+  const Dataset& get_dataset() const { return *(this->dataset); }
+  size_t size() const { return this->rows.size(); }
+  size_t get_row(const size_t i) const { return this->rows[i]; }
+  const std::vector<size_t>& get_rows() const { return this->rows; }
+  size_t get_instance_id(const size_t i) const {
+    return this->dataset->get_instance_id(this->rows[i]);
+  }
+  size_t num_attributes() const;
+  bool has_attribute(const std::string &name) const;
+  size_t get_attribute_index(const std::string &name) const;
+  std::vector<bool>
+  get_attribute_mask(const std::set<std::string> &exclude_atts) const;
+  size_t get_column_index(const size_t k) const {
+    return this->projected ? this->columns[k] : k;
+  }
+  const Attribute* get_attribute_description_ptr(const size_t k) const {
+    return this->dataset->get_attribute_description_ptr(
+      this->get_column_index(k));
+  }
+  const Column& get_column(const size_t k) const {
+    return this->dataset->get_column(this->get_column_index(k));
+  }
+  const_iterator begin() const { return const_iterator(this, 0); }
+  const_iterator end() const { return const_iterator(this, this->size()); }
+  const_attribute_iterator begin_attributes() const {
+    if (this->projected) return this->att_descr_ptrs.begin();
+    return this->dataset->begin_attributes();
+  }
+  const_attribute_iterator end_attributes() const {
+    if (this->projected) return this->att_descr_ptrs.end();
+    return this->dataset->end_attributes();
+  }
+
+private:
+  // private instance variables
+  const Dataset *dataset;
+  std::vector<size_t> rows;
+
+  // the projection, if there is one; view attribute k is held in dataset
+  // column columns[k].
+  bool projected;
+  std::vector<size_t> columns;
+  std::vector<Attribute*> att_descr_ptrs;
+  std::unordered_map<std::string, size_t> att_index;
+};
+
+#endif
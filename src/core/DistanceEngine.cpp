@@ -0,0 +1,627 @@
+/* The following applys to this software package and all subparts therein
+ *
+ * Cognosco Copyright (C) 2015 Philip J. Uren
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or (at
+ * your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+// stl includes
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <functional>
+#include <utility>
+#include <cmath>
+#include <algorithm>
+
+// local Cognosco includes
+#include "DistanceEngine.hpp"
+#include "Column.hpp"
+#include "Attribute.hpp"
+#include "CognoscoError.hpp"
+
+// the vectorised kernels are compiled for the CPUs that have them, and
+// chosen between when the program runs
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define COGNOSCO_X86_KERNELS
+#include <immintrin.h>
+#endif
+
+// bring these into the local namespace
+using std::string;
+using std::vector;
+using std::pair;
+
+// rows are padded to a multiple of this many values, so the kernels never
+// need a remainder loop
+static const size_t ROW_ALIGNMENT = 16;
+
+// the rows of two blocks of instances should fit in this many bytes
+static const size_t BLOCK_BYTES = 128 * 1024;
+
+// rows in each block, and values of each row at a time, when distances are
+// computed from dot products; the two panels of rows and the products for
+// a pair of blocks take about 700KB
+static const size_t GEMM_BLOCK_ROWS = 240;
+static const size_t GEMM_DEPTH = 256;
+
+// squared Euclidean distances from dot products that come to less than this
+// fraction of the rows' squared norms have lost too much to cancellation, and
+// are recomputed directly
+static const double GEMM_CANCELLATION = 1e-3;
+
+DistanceMetric
+parse_distance_metric(const string &s) {
+  if (s == "euclidean") return EUCLIDEAN_DISTANCE;
+  if (s == "sqeuclidean") return SQUARED_EUCLIDEAN_DISTANCE;
+  if (s == "manhattan") return MANHATTAN_DISTANCE;
+  if (s == "cosine") return COSINE_DISTANCE;
+  if (s == "pearson") return PEARSON_DISTANCE;
+  throw CognoscoError("unknown distance metric: " + s);
+}
+
+DistanceMethod
+parse_distance_method(const string &s) {
+  if (s == "auto") return AUTO_METHOD;
+  if (s == "direct") return DIRECT_METHOD;
+  if (s == "gemm") return GEMM_METHOD;
+  throw CognoscoError("unknown distance method: " + s);
+}
+
+/*****************************************************************************
+ *                                  KERNELS                                  *
+ *****************************************************************************/
+
+/**
+ * A kernel reduces two rows of n values, n a multiple of ROW_ALIGNMENT, to
+ * the sum of squared differences, of absolute differences, or of products.
+ */
+typedef float (*Kernel)(const float*, const float*, const size_t);
+
+static float
+squared_euclidean_scalar(const float *a, const float *b, const size_t n) {
+  float sum = 0;
+  for (size_t i = 0; i < n; ++i) sum += (a[i] - b[i]) * (a[i] - b[i]);
+  return sum;
+}
+
+static float
+manhattan_scalar(const float *a, const float *b, const size_t n) {
+  float sum = 0;
+  for (size_t i = 0; i < n; ++i) sum += std::fabs(a[i] - b[i]);
+  return sum;
+}
+
+static float
+dot_scalar(const float *a, const float *b, const size_t n) {
+  float sum = 0;
+  for (size_t i = 0; i < n; ++i) sum += a[i] * b[i];
+  return sum;
+}
+
+/**
+ * A micro-kernel multiplies a panel of MR rows by a panel of NR rows, over
+ * kc values of each, adding the MR x NR dot products into c, whose rows are
+ * ldc apart. Panels are packed so that the rows' values for each k are
+ * together, and the products are held in registers until the end.
+ */
+typedef void (*MicroKernel)(const float*, const float*, const size_t,
+                            float*, const size_t);
+static const size_t MR = 6;
+static const size_t NR = 16;
+
+static void
+dot_panels_scalar(const float *a, const float *b, const size_t kc, float *c,
+                  const size_t ldc) {
+  // a quarter of the panel at a time, so the sums fit in SSE registers
+  static const size_t NQ = NR / 4;
+  for (size_t q = 0; q < NR; q += NQ) {
+    float acc[MR][NQ] = {};
+    for (size_t k = 0; k < kc; ++k) {
+      for (size_t r = 0; r < MR; ++r) {
+        const float x = a[k * MR + r];
+        for (size_t j = 0; j < NQ; ++j) acc[r][j] += x * b[k * NR + q + j];
+      }
+    }
+    for (size_t r = 0; r < MR; ++r)
+      for (size_t j = 0; j < NQ; ++j) c[r * ldc + q + j] += acc[r][j];
+  }
+}
+
+#ifdef COGNOSCO_X86_KERNELS
+
+__attribute__((target("avx2,fma"))) static inline float
+horizontal_sum(const __m256 v) {
+  const __m128 x = _mm_add_ps(_mm256_castps256_ps128(v),
+                              _mm256_extractf128_ps(v, 1));
+  const __m128 y = _mm_add_ps(x, _mm_movehl_ps(x, x));
+  return _mm_cvtss_f32(_mm_add_ss(y, _mm_movehdup_ps(y)));
+}
+
+__attribute__((target("avx2,fma"))) static float
+squared_euclidean_avx2(const float *a, const float *b, const size_t n) {
+  __m256 s0 = _mm256_setzero_ps(), s1 = _mm256_setzero_ps();
+  for (size_t i = 0; i < n; i += 16) {
+    const __m256 d0 = _mm256_sub_ps(_mm256_loadu_ps(a + i),
+                                    _mm256_loadu_ps(b + i));
+    const __m256 d1 = _mm256_sub_ps(_mm256_loadu_ps(a + i + 8),
+                                    _mm256_loadu_ps(b + i + 8));
+    s0 = _mm256_fmadd_ps(d0, d0, s0);
+    s1 = _mm256_fmadd_ps(d1, d1, s1);
+  }
+  return horizontal_sum(_mm256_add_ps(s0, s1));
+}
+
+__attribute__((target("avx2,fma"))) static float
+manhattan_avx2(const float *a, const float *b, const size_t n) {
+  const __m256 sign = _mm256_set1_ps(-0.0f);
+  __m256 s0 = _mm256_setzero_ps(), s1 = _mm256_setzero_ps();
+  for (size_t i = 0; i < n; i += 16) {
+    const __m256 d0 = _mm256_sub_ps(_mm256_loadu_ps(a + i),
+                                    _mm256_loadu_ps(b + i));
+    const __m256 d1 = _mm256_sub_ps(_mm256_loadu_ps(a + i + 8),
+                                    _mm256_loadu_ps(b + i + 8));
+    s0 = _mm256_add_ps(s0, _mm256_andnot_ps(sign, d0));
+    s1 = _mm256_add_ps(s1, _mm256_andnot_ps(sign, d1));
+  }
+  return horizontal_sum(_mm256_add_ps(s0, s1));
+}
+
+__attribute__((target("avx2,fma"))) static float
+dot_avx2(const float *a, const float *b, const size_t n) {
+  __m256 s0 = _mm256_setzero_ps(), s1 = _mm256_setzero_ps();
+  for (size_t i = 0; i < n; i += 16) {
+    s0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), s0);
+    s1 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i + 8),
+                         _mm256_loadu_ps(b + i + 8), s1);
+  }
+  return horizontal_sum(_mm256_add_ps(s0, s1));
+}
+
+// _mm512_reduce_add_ps and _mm512_castps512_ps256 trip a spurious
+// uninitialised value warning in some versions of gcc, so the two halves are
+// taken with zero-masked extracts instead
+__attribute__((target("avx512f"))) static inline float
+horizontal_sum(const __m512 v) {
+  const __m512d u = _mm512_castps_pd(v);
+  const __m256 w = _mm256_add_ps(
+      _mm256_castpd_ps(_mm512_maskz_extractf64x4_pd(0xff, u, 0)),
+      _mm256_castpd_ps(_mm512_maskz_extractf64x4_pd(0xff, u, 1)));
+  const __m128 x = _mm_add_ps(_mm256_castps256_ps128(w),
+                              _mm256_extractf128_ps(w, 1));
+  const __m128 y = _mm_add_ps(x, _mm_movehl_ps(x, x));
+  return _mm_cvtss_f32(_mm_add_ss(y, _mm_movehdup_ps(y)));
+}
+
+__attribute__((target("avx512f"))) static float
+squared_euclidean_avx512(const float *a, const float *b, const size_t n) {
+  __m512 sum = _mm512_setzero_ps();
+  for (size_t i = 0; i < n; i += 16) {
+    const __m512 d = _mm512_sub_ps(_mm512_loadu_ps(a + i),
+                                   _mm512_loadu_ps(b + i));
+    sum = _mm512_fmadd_ps(d, d, sum);
+  }
+  return horizontal_sum(sum);
+}
+
+__attribute__((target("avx512f"))) static float
+manhattan_avx512(const float *a, const float *b, const size_t n) {
+  __m512 sum = _mm512_setzero_ps();
+  for (size_t i = 0; i < n; i += 16) {
+    sum = _mm512_add_ps(sum, _mm512_abs_ps(
+        _mm512_sub_ps(_mm512_loadu_ps(a + i), _mm512_loadu_ps(b + i))));
+  }
+  return horizontal_sum(sum);
+}
+
+__attribute__((target("avx512f"))) static float
+dot_avx512(const float *a, const float *b, const size_t n) {
+  __m512 sum = _mm512_setzero_ps();
+  for (size_t i = 0; i < n; i += 16)
+    sum = _mm512_fmadd_ps(_mm512_loadu_ps(a + i), _mm512_loadu_ps(b + i), sum);
+  return horizontal_sum(sum);
+}
+
+__attribute__((target("avx2,fma"))) static void
+dot_panels_avx2(const float *a, const float *b, const size_t kc, float *c,
+                const size_t ldc) {
+  __m256 acc[MR][2];
+  for (size_t r = 0; r < MR; ++r)
+    acc[r][0] = acc[r][1] = _mm256_setzero_ps();
+  for (size_t k = 0; k < kc; ++k) {
+    const __m256 b0 = _mm256_loadu_ps(b + k * NR);
+    const __m256 b1 = _mm256_loadu_ps(b + k * NR + 8);
+    for (size_t r = 0; r < MR; ++r) {
+      const __m256 x = _mm256_broadcast_ss(a + k * MR + r);
+      acc[r][0] = _mm256_fmadd_ps(x, b0, acc[r][0]);
+      acc[r][1] = _mm256_fmadd_ps(x, b1, acc[r][1]);
+    }
+  }
+  for (size_t r = 0; r < MR; ++r) {
+    float *row = c + r * ldc;
+    _mm256_storeu_ps(row, _mm256_add_ps(_mm256_loadu_ps(row), acc[r][0]));
+    _mm256_storeu_ps(row + 8, _mm256_add_ps(_mm256_loadu_ps(row + 8),
+                                            acc[r][1]));
+  }
+}
+
+__attribute__((target("avx512f"))) static void
+dot_panels_avx512(const float *a, const float *b, const size_t kc, float *c,
+                  const size_t ldc) {
+  __m512 acc[MR];
+  for (size_t r = 0; r < MR; ++r) acc[r] = _mm512_setzero_ps();
+  for (size_t k = 0; k < kc; ++k) {
+    const __m512 y = _mm512_loadu_ps(b + k * NR);
+    for (size_t r = 0; r < MR; ++r)
+      acc[r] = _mm512_fmadd_ps(_mm512_set1_ps(a[k * MR + r]), y, acc[r]);
+  }
+  for (size_t r = 0; r < MR; ++r) {
+    float *row = c + r * ldc;
+    _mm512_storeu_ps(row, _mm512_add_ps(_mm512_loadu_ps(row), acc[r]));
+  }
+}
+
+#endif
+
+/**
+ * \brief pick the kernel for a metric, using the widest vector instructions
+ *        this CPU has.
+ */
+static Kernel
+select_kernel(const DistanceMetric &metric) {
+  enum {SCALAR, AVX2, AVX512} isa = SCALAR;
+#ifdef COGNOSCO_X86_KERNELS
+  if (__builtin_cpu_supports("avx512f")) isa = AVX512;
+  else if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+    isa = AVX2;
+#endif
+  switch (metric) {
+    case MANHATTAN_DISTANCE:
+#ifdef COGNOSCO_X86_KERNELS
+      if (isa == AVX512) return manhattan_avx512;
+      if (isa == AVX2) return manhattan_avx2;
+#endif
+      return manhattan_scalar;
+    case COSINE_DISTANCE:
+    case PEARSON_DISTANCE:
+#ifdef COGNOSCO_X86_KERNELS
+      if (isa == AVX512) return dot_avx512;
+      if (isa == AVX2) return dot_avx2;
+#endif
+      return dot_scalar;
+    default:
+#ifdef COGNOSCO_X86_KERNELS
+      if (isa == AVX512) return squared_euclidean_avx512;
+      if (isa == AVX2) return squared_euclidean_avx2;
+#endif
+      return squared_euclidean_scalar;
+  }
+}
+
+/**
+ * \brief pick the GEMM micro-kernel, using the widest vector instructions
+ *        this CPU has.
+ */
+static MicroKernel
+select_micro_kernel() {
+#ifdef COGNOSCO_X86_KERNELS
+  if (__builtin_cpu_supports("avx512f")) return dot_panels_avx512;
+  if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+    return dot_panels_avx2;
+#endif
+  return dot_panels_scalar;
+}
+
+/*****************************************************************************
+ *                              STATIC HELPERS                               *
+ *****************************************************************************/
+
+/**
+ * \brief copy the given attributes of each instance into row-major rows of
+ *        width values, which must be at least the number of attributes;
+ *        the rest of each row is zero. Rows are centred (for Pearson
+ *        distance) and scaled to unit length (for cosine and Pearson), and
+ *        rows with a missing value are flagged.
+ */
+static void
+get_rows(const Dataset &d, const vector<size_t> &attributes,
+         const DistanceMetric &metric, const size_t width,
+         vector<float> &rows, vector<char> &missing) {
+  const size_t n = d.size();
+  rows.assign(n * width, 0);
+  for (size_t k = 0; k < attributes.size(); ++k) {
+    const Column &col = d.get_column(attributes[k]);
+    if (col.get_type() != NUMERIC) {
+      throw CognoscoError("cannot compute distances from non-numeric "
+                          "attribute " + d.get_attribute_description_ptr(
+                          attributes[k])->get_name());
+    }
+    if (col.is_sparse()) {
+      const MappableVector<uint32_t> &nz_rows = col.nonzero_rows();
+      const NumericBuffer &nz_values = col.nonzero_values();
+      for (size_t i = 0; i < nz_rows.size(); ++i)
+        rows[nz_rows[i] * width + k] = nz_values.get(i);
+    } else {
+      const NumericBuffer &values = col.numeric_values();
+      for (size_t i = 0; i < n; ++i) rows[i * width + k] = values.get(i);
+    }
+  }
+
+  missing.assign(n, false);
+  const size_t dims = attributes.size();
+  for (size_t i = 0; i < n; ++i) {
+    float *row = rows.data() + i * width;
+    double sum = 0;
+    for (size_t k = 0; k < dims; ++k) {
+      if (std::isnan(row[k])) missing[i] = true;
+      sum += row[k];
+    }
+    if (missing[i]) continue;
+    if ((metric == PEARSON_DISTANCE) && (dims > 0)) {
+      const double mean = sum / dims;
+      for (size_t k = 0; k < dims; ++k) row[k] -= mean;
+    }
+    if ((metric == COSINE_DISTANCE) || (metric == PEARSON_DISTANCE)) {
+      double norm = 0;
+      for (size_t k = 0; k < dims; ++k) norm += double(row[k]) * row[k];
+      norm = std::sqrt(norm);
+      if (norm > 0)
+        for (size_t k = 0; k < dims; ++k) row[k] /= norm;
+    }
+  }
+}
+
+/**
+ * \brief shift each of the first dims values of the rows without missing
+ *        values by its mean, which leaves Euclidean distances as they were
+ *        but makes the rows' norms as small as they can be.
+ */
+static void
+centre_columns(vector<float> &rows, const size_t width, const size_t dims,
+               const vector<char> &missing) {
+  vector<double> means(dims, 0);
+  size_t count = 0;
+  for (size_t i = 0; i < missing.size(); ++i) {
+    if (missing[i]) continue;
+    for (size_t k = 0; k < dims; ++k) means[k] += rows[i * width + k];
+    count += 1;
+  }
+  if (count == 0) return;
+  for (size_t k = 0; k < dims; ++k) means[k] /= count;
+  for (size_t i = 0; i < missing.size(); ++i) {
+    if (missing[i]) continue;
+    for (size_t k = 0; k < dims; ++k) rows[i * width + k] -= means[k];
+  }
+}
+
+/**
+ * \brief copy values [k0, k0 + kc) of rows [begin, end) into panels of
+ *        panel_rows rows, each holding the rows' values for each k together;
+ *        the last panel is padded with zeros.
+ */
+static void
+pack_panels(const vector<float> &rows, const size_t width, const size_t begin,
+            const size_t end, const size_t k0, const size_t kc,
+            const size_t panel_rows, vector<float> &panels) {
+  const size_t num_panels = (end - begin + panel_rows - 1) / panel_rows;
+  panels.assign(num_panels * panel_rows * kc, 0);
+  for (size_t i = begin; i < end; ++i) {
+    const float *row = rows.data() + i * width + k0;
+    float *dest = panels.data() + ((i - begin) / panel_rows) * panel_rows * kc +
+                  (i - begin) % panel_rows;
+    for (size_t k = 0; k < kc; ++k) dest[k * panel_rows] = row[k];
+  }
+}
+
+/**
+ * \brief turn a kernel's result for two rows into the distance between them;
+ *        a squared Euclidean distance is clamped at zero, as the norm
+ *        expansion can leave it just below.
+ */
+static double
+finish(const DistanceMetric &metric, const double sum) {
+  switch (metric) {
+    case EUCLIDEAN_DISTANCE: return std::sqrt(std::max(0.0, sum));
+    case SQUARED_EUCLIDEAN_DISTANCE: return std::max(0.0, sum);
+    case COSINE_DISTANCE:
+    case PEARSON_DISTANCE:
+      return std::min(2.0, std::max(0.0, 1.0 - sum));
+    default: return sum;
+  }
+}
+
+/**
+ * \brief call f(bi, bj) for each pair of the num_blocks blocks of rows with
+ *        bi <= bj, on num_threads threads, each taking the next pair as it
+ *        finishes its last.
+ */
+static void
+for_each_tile(const size_t num_blocks, const size_t num_threads,
+              const std::function<void(size_t, size_t)> &f) {
+  vector<pair<size_t, size_t> > tiles;
+  for (size_t bi = 0; bi < num_blocks; ++bi)
+    for (size_t bj = bi; bj < num_blocks; ++bj) tiles.push_back({bi, bj});
+  std::atomic<size_t> next_tile(0);
+  auto work = [&]() {
+    for (size_t t = next_tile++; t < tiles.size(); t = next_tile++)
+      f(tiles[t].first, tiles[t].second);
+  };
+  vector<std::thread> workers;
+  for (size_t t = 1; t < num_threads; ++t)
+    workers.push_back(std::thread(work));
+  work();
+  for (auto &worker : workers) worker.join();
+}
+
+/*****************************************************************************
+ *                                 COMPUTING                                 *
+ *****************************************************************************/
+
+/**
+ * \brief decide whether distances are computed from dot products between
+ *        blocks of rows, rather than one pair of rows at a time.
+ */
+bool
+DistanceEngine::use_gemm(const size_t num_attributes) const {
+  const bool possible = (this->metric != MANHATTAN_DISTANCE);
+  if (this->method == GEMM_METHOD) {
+    if (!possible) {
+      throw CognoscoError("Manhattan distances cannot be computed from "
+                          "dot products");
+    }
+    return true;
+  }
+  return (this->method == AUTO_METHOD) && possible &&
+         (num_attributes >= GEMM_MIN_ATTRIBUTES);
+}
+
+/**
+ * \brief compute the distances between the instances of d, using the given
+ *        attributes, into m; names gives the name of the point for each
+ *        instance, in order.
+ */
+void
+DistanceEngine::compute(const Dataset &d, const vector<size_t> &attributes,
+                        const vector<string> &names,
+                        DistanceMatrix &m) const {
+  const size_t n = d.size();
+  if (names.size() != n) {
+    throw CognoscoError("need a name for each instance to compute "
+                        "distances between");
+  }
+
+  const size_t width = (attributes.size() + ROW_ALIGNMENT - 1) /
+                       ROW_ALIGNMENT * ROW_ALIGNMENT;
+  vector<float> rows;
+  vector<char> missing;
+  get_rows(d, attributes, this->metric, width, rows, missing);
+
+  DistanceMatrix res(names, this->condensed,
+                     (this->storage == DOUBLE_STORAGE) ? DOUBLE_STORAGE
+                                                       : FLOAT_STORAGE);
+  if (!this->condensed) {
+    for (size_t i = 0; i < n; ++i) if (!missing[i]) res.set(i, i, 0);
+  }
+  if (this->use_gemm(attributes.size()))
+    this->compute_gemm(rows, width, missing, res);
+  else this->compute_direct(rows, width, missing, res);
+
+  res.set_storage(this->storage);
+  m.swap(res);
+}
+
+/**
+ * \brief compute each distance from a single pass over the pair of rows, a
+ *        tile of pairs at a time.
+ */
+void
+DistanceEngine::compute_direct(const vector<float> &rows, const size_t width,
+                               const vector<char> &missing,
+                               DistanceMatrix &res) const {
+  const size_t n = missing.size();
+  const size_t row_bytes = std::max(width, ROW_ALIGNMENT) * sizeof(float);
+  const size_t block_rows = std::max(size_t(1), BLOCK_BYTES / (2 * row_bytes));
+  const size_t num_blocks = (n + block_rows - 1) / block_rows;
+  const Kernel kernel = select_kernel(this->metric);
+  for_each_tile(num_blocks, this->num_threads, [&](size_t bi, size_t bj) {
+    const size_t i_end = std::min(n, (bi + 1) * block_rows);
+    const size_t j_end = std::min(n, (bj + 1) * block_rows);
+    for (size_t i = bi * block_rows; i < i_end; ++i) {
+      if (missing[i]) continue;
+      const float *a = rows.data() + i * width;
+      for (size_t j = std::max(bj * block_rows, i + 1); j < j_end; ++j) {
+        if (missing[j]) continue;
+        const double dist = finish(this->metric,
+                                   kernel(a, rows.data() + j * width, width));
+        res.set(i, j, dist);
+        if (!this->condensed) res.set(j, i, dist);
+      }
+    }
+  });
+}
+
+/**
+ * \brief compute the dot products between each pair of rows in a tile as a
+ *        blocked matrix product, and the distances from those; Euclidean
+ *        distances use ||x||^2 + ||y||^2 - 2 x.y, on rows shifted to have
+ *        mean zero so as to lose as little precision as possible to the
+ *        subtraction; any that are still too small for it to be trusted are
+ *        computed directly instead. Each tile is GEMM_BLOCK_ROWS rows square,
+ *        and is worked through GEMM_DEPTH values at a time, so that its two
+ *        panels of rows and its products stay in L2 cache; within a tile,
+ *        each pair of an MR row and an NR row panel is multiplied in
+ *        registers.
+ */
+void
+DistanceEngine::compute_gemm(vector<float> &rows, const size_t width,
+                             const vector<char> &missing,
+                             DistanceMatrix &res) const {
+  const size_t n = missing.size();
+  const bool euclidean = (this->metric == EUCLIDEAN_DISTANCE) ||
+                         (this->metric == SQUARED_EUCLIDEAN_DISTANCE);
+  vector<double> norms(n, 0);
+  if (euclidean) {
+    centre_columns(rows, width, width, missing);
+    for (size_t i = 0; i < n; ++i) {
+      for (size_t k = 0; k < width; ++k)
+        norms[i] += double(rows[i * width + k]) * rows[i * width + k];
+    }
+  }
+
+  const size_t num_blocks = (n + GEMM_BLOCK_ROWS - 1) / GEMM_BLOCK_ROWS;
+  const MicroKernel micro_kernel = select_micro_kernel();
+  const Kernel kernel = select_kernel(SQUARED_EUCLIDEAN_DISTANCE);
+  for_each_tile(num_blocks, this->num_threads, [&](size_t bi, size_t bj) {
+    const size_t i_begin = bi * GEMM_BLOCK_ROWS;
+    const size_t j_begin = bj * GEMM_BLOCK_ROWS;
+    const size_t i_end = std::min(n, i_begin + GEMM_BLOCK_ROWS);
+    const size_t j_end = std::min(n, j_begin + GEMM_BLOCK_ROWS);
+    const size_t i_panels = (i_end - i_begin + MR - 1) / MR;
+    const size_t j_panels = (j_end - j_begin + NR - 1) / NR;
+    const size_t ldc = j_panels * NR;
+    vector<float> a, b, dots(i_panels * MR * ldc, 0);
+    for (size_t k0 = 0; k0 < width; k0 += GEMM_DEPTH) {
+      const size_t kc = std::min(GEMM_DEPTH, width - k0);
+      pack_panels(rows, width, i_begin, i_end, k0, kc, MR, a);
+      pack_panels(rows, width, j_begin, j_end, k0, kc, NR, b);
+      for (size_t jp = 0; jp < j_panels; ++jp) {
+        for (size_t ip = 0; ip < i_panels; ++ip) {
+          micro_kernel(a.data() + ip * MR * kc, b.data() + jp * NR * kc, kc,
+                       dots.data() + ip * MR * ldc + jp * NR, ldc);
+        }
+      }
+    }
+    for (size_t i = i_begin; i < i_end; ++i) {
+      if (missing[i]) continue;
+      const size_t row = (i - i_begin) * ldc;
+      for (size_t j = std::max(j_begin, i + 1); j < j_end; ++j) {
+        if (missing[j]) continue;
+        const double dot = dots[row + (j - j_begin)];
+        double sum = dot;
+        if (euclidean) {
+          sum = norms[i] + norms[j] - 2.0 * dot;
+          if (sum < GEMM_CANCELLATION * (norms[i] + norms[j])) {
+            sum = kernel(rows.data() + i * width, rows.data() + j * width,
+                         width);
+          }
+        }
+        const double dist = finish(this->metric, sum);
+        res.set(i, j, dist);
+        if (!this->condensed) res.set(j, i, dist);
+      }
+    }
+  });
+}
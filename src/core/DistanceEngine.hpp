@@ -0,0 +1,110 @@
+/* The following applys to this software package and all subparts therein
+ *
+ * Cognosco Copyright (C) 2015 Philip J. Uren
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or (at
+ * your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef DISTANCE_ENGINE_HPP_
+#define DISTANCE_ENGINE_HPP_
+
+// stl includes
+#include <string>
+#include <vector>
+
+// local Cognosco includes
+#include "Dataset.hpp"
+#include "DistanceMatrix.hpp"
+#include "NumericBuffer.hpp"
+
+enum DistanceMetric {
+  EUCLIDEAN_DISTANCE,
+  SQUARED_EUCLIDEAN_DISTANCE,
+  MANHATTAN_DISTANCE,
+  COSINE_DISTANCE,
+  PEARSON_DISTANCE
+};
+
+enum DistanceMethod {
+  AUTO_METHOD,
+  DIRECT_METHOD,
+  GEMM_METHOD
+};
+
+DistanceMetric parse_distance_metric(const std::string &s);
+DistanceMethod parse_distance_method(const std::string &s);
+
+/**
+ * \brief Computes the distances between every pair of instances in a
+ *        dataset, using the given numeric attributes as their coordinates,
+ *        into a DistanceMatrix with a point for each instance. Cosine and
+ *        Pearson distances are one minus the cosine similarity of the
+ *        instances and of their centred values respectively, so lie in
+ *        [0, 2]; an instance whose values are all zero (or, for Pearson, all
+ *        the same) is at distance 1 from every other. Distances involving an
+ *        instance with a missing value are missing.
+ *
+ *        The coordinates are copied into a single precision row-major array,
+ *        each row padded with zeros to a multiple of 16 values, and the
+ *        instances are split into blocks small enough that two blocks' rows
+ *        fit in cache together. Each pair of blocks is a tile of the matrix,
+ *        and tiles are handed out to num_threads threads as they finish
+ *        their last. Within a tile, each distance is either a single pass
+ *        over the two rows (the direct method), or comes from the dot product
+ *        of the rows, with the tile's dot products computed together as a
+ *        blocked matrix product (the GEMM method). The latter is much faster
+ *        for rows of more than a few dozen values, and is used for them
+ *        automatically unless the metric is Manhattan distance, which has
+ *        no such form. Both use AVX-512 or AVX2 instructions when the CPU
+ *        has them.
+ *
+ *        The matrix is full unless condensed is set, and is computed at
+ *        double or single precision and then quantized, as when it's loaded
+ *        from a file.
+ */
+class DistanceEngine {
+public:
+  explicit DistanceEngine(const DistanceMetric &metric,
+                          const size_t num_threads=1,
+                          const bool condensed=false,
+                          const NumericStorage &storage=DOUBLE_STORAGE,
+                          const DistanceMethod &method=AUTO_METHOD) :
+    metric(metric), num_threads(num_threads), condensed(condensed),
+    storage(storage), method(method) {}
+
+  void compute(const Dataset &d, const std::vector<size_t> &attributes,
+               const std::vector<std::string> &names,
+               DistanceMatrix &m) const;
+private:
+  DistanceMetric metric;
+  size_t num_threads;
+  bool condensed;
+  NumericStorage storage;
+  DistanceMethod method;
+
+  // with the automatic method, dot products are used from this many
+  // attributes on
+  static const size_t GEMM_MIN_ATTRIBUTES = 32;
+
+  bool use_gemm(const size_t num_attributes) const;
+  void compute_direct(const std::vector<float> &rows, const size_t width,
+                      const std::vector<char> &missing,
+                      DistanceMatrix &res) const;
+  void compute_gemm(std::vector<float> &rows, const size_t width,
+                    const std::vector<char> &missing,
+                    DistanceMatrix &res) const;
+};
+
+#endif
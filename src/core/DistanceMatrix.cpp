@@ -0,0 +1,284 @@
+/* The following applys to this software package and all subparts therein
+ *
+ * Cognosco Copyright (C) 2015 Philip J. Uren
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or (at
+ * your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+// stl includes
+#include <string>
+#include <vector>
+#include <limits>
+#include <cmath>
+#include <algorithm>
+
+// local Cognosco includes
+#include "DistanceMatrix.hpp"
+#include "CognoscoError.hpp"
+
+// bring these into the local namespace
+using std::string;
+using std::vector;
+
+static void
+check_storage(const NumericStorage &storage) {
+  if ((storage != DOUBLE_STORAGE) && (storage != FLOAT_STORAGE)) {
+    throw CognoscoError("distance matrices are built at double or single "
+                        "precision, and quantized once complete");
+  }
+}
+
+
+/*****************************************************************************
+ *                              CONSTRUCTORS                                 *
+ *****************************************************************************/
+
+/**
+ * \brief build a matrix of distances between the named points, with every
+ *        distance missing.
+ */
+DistanceMatrix::DistanceMatrix(const vector<string> &names,
+                               const bool condensed,
+                               const NumericStorage &storage) :
+    condensed(condensed), storage(storage), names(names), offset(0),
+    scale(1) {
+  check_storage(storage);
+  this->index_names();
+  if (storage == DOUBLE_STORAGE) {
+    this->doubles.assign(this->num_entries(),
+                         std::numeric_limits<double>::quiet_NaN());
+  } else {
+    this->floats.assign(this->num_entries(),
+                        std::numeric_limits<float>::quiet_NaN());
+  }
+}
+
+
+/*****************************************************************************
+ *                                INSPECTORS                                 *
+ *****************************************************************************/
+
+/**
+ * \brief find the index of the named point.
+ * \return false if there's no such point.
+ */
+bool
+DistanceMatrix::find_index(const string &name, size_t &i) const {
+  auto it = this->index.find(name);
+  if (it == this->index.end()) return false;
+  i = it->second;
+  return true;
+}
+
+/**
+ * \brief get the index of the named point, which must be in the matrix.
+ */
+size_t
+DistanceMatrix::get_index(const string &name) const {
+  size_t i;
+  if (!this->find_index(name, i))
+    throw CognoscoError("no such point in distance matrix: " + name);
+  return i;
+}
+
+/**
+ * \brief get the number of distances the matrix holds; n^2 if it's full,
+ *        and n(n - 1)/2 if it's condensed.
+ */
+size_t
+DistanceMatrix::num_entries() const {
+  const size_t n = this->names.size();
+  if (!this->condensed) return n * n;
+  return (n == 0) ? 0 : n * (n - 1) / 2;
+}
+
+/**
+ * \brief get the distances, as held; num_entries() values at the matrix's
+ *        storage.
+ */
+const void*
+DistanceMatrix::entry_data() const {
+  switch (this->storage) {
+    case DOUBLE_STORAGE: return this->doubles.data();
+    case FLOAT_STORAGE: return this->floats.data();
+    case QUANTIZED_16_STORAGE: return this->q16.data();
+    default: return this->q8.data();
+  }
+}
+
+/**
+ * \brief check whether the distance from point i to point j has been set.
+ */
+bool
+DistanceMatrix::has(const size_t i, const size_t j) const {
+  return !std::isnan(this->get(i, j));
+}
+
+
+/*****************************************************************************
+ *                                 MUTATORS                                  *
+ *****************************************************************************/
+
+/**
+ * \brief set the distance from point i to point j; in a condensed matrix,
+ *        that's also the distance from j to i. A condensed matrix doesn't
+ *        hold the distance from a point to itself, which is always 0, so
+ *        setting it does nothing.
+ */
+void
+DistanceMatrix::set(const size_t i, const size_t j, const double dist) {
+  if (this->condensed && (i == j)) return;
+  const size_t idx = this->position(i, j);
+  if (this->storage == DOUBLE_STORAGE) this->doubles.mutable_data()[idx] = dist;
+  else if (this->storage == FLOAT_STORAGE)
+    this->floats.mutable_data()[idx] = dist;
+  else throw CognoscoError("cannot set distances in a quantized matrix");
+}
+
+/**
+ * \brief change the storage the distances are held at, converting them.
+ *        Quantizing maps the range of distances present onto all but the
+ *        largest code, which stands for missing distances.
+ */
+void
+DistanceMatrix::set_storage(const NumericStorage &s) {
+  if (s == this->storage) return;
+  const size_t n = this->num_entries();
+  MappableVector<double> doubles;
+  MappableVector<float> floats;
+  MappableVector<uint16_t> q16;
+  MappableVector<uint8_t> q8;
+  if (s == DOUBLE_STORAGE) {
+    doubles.assign(n, 0);
+    double *vals = doubles.mutable_data();
+    for (size_t idx = 0; idx < n; ++idx) vals[idx] = this->entry(idx);
+  } else if (s == FLOAT_STORAGE) {
+    floats.assign(n, 0);
+    float *vals = floats.mutable_data();
+    for (size_t idx = 0; idx < n; ++idx) vals[idx] = this->entry(idx);
+  } else if (s == QUANTIZED_16_STORAGE) {
+    this->quantize(q16);
+  } else {
+    this->quantize(q8);
+  }
+  this->doubles.swap(doubles);
+  this->floats.swap(floats);
+  this->q16.swap(q16);
+  this->q8.swap(q8);
+  this->storage = s;
+  if ((s == DOUBLE_STORAGE) || (s == FLOAT_STORAGE)) {
+    this->offset = 0;
+    this->scale = 1;
+  }
+}
+
+/**
+ * \brief encode every distance as a code, setting the offset and scale
+ *        the codes are relative to.
+ */
+template <typename T> void
+DistanceMatrix::quantize(MappableVector<T> &codes) {
+  const T missing = std::numeric_limits<T>::max();
+  const size_t n = this->num_entries();
+  double lo = std::numeric_limits<double>::infinity();
+  double hi = -lo;
+  for (size_t idx = 0; idx < n; ++idx) {
+    const double val = this->entry(idx);
+    if (std::isnan(val)) continue;
+    lo = std::min(lo, val);
+    hi = std::max(hi, val);
+  }
+  const double offset = (lo <= hi) ? lo : 0;
+  const double scale = (hi > lo) ? (hi - lo) / (missing - 1) : 1;
+
+  codes.assign(n, missing);
+  T *data = codes.mutable_data();
+  for (size_t idx = 0; idx < n; ++idx) {
+    const double val = this->entry(idx);
+    if (!std::isnan(val)) data[idx] = std::round((val - offset) / scale);
+  }
+  this->offset = offset;
+  this->scale = scale;
+}
+
+void
+DistanceMatrix::swap(DistanceMatrix &other) {
+  std::swap(this->condensed, other.condensed);
+  std::swap(this->storage, other.storage);
+  this->names.swap(other.names);
+  this->index.swap(other.index);
+  this->doubles.swap(other.doubles);
+  this->floats.swap(other.floats);
+  this->q16.swap(other.q16);
+  this->q8.swap(other.q8);
+  std::swap(this->offset, other.offset);
+  std::swap(this->scale, other.scale);
+}
+
+/**
+ * \brief replace this matrix with one between the named points, whose
+ *        distances are held in external memory (normally a mapped matrix
+ *        snapshot) that's kept alive by owner. The memory must hold as many
+ *        distances as the matrix needs, at the given storage; offset and
+ *        scale give the range of quantized codes.
+ */
+void
+DistanceMatrix::map(const vector<string> &names, const bool condensed,
+                    const NumericStorage &storage, const void *data,
+                    const double offset, const double scale,
+                    const std::shared_ptr<const void> &owner) {
+  DistanceMatrix res;
+  res.condensed = condensed;
+  res.storage = storage;
+  res.names = names;
+  res.index_names();
+  const size_t n = res.num_entries();
+  switch (storage) {
+    case DOUBLE_STORAGE:
+      res.doubles = MappableVector<double>(static_cast<const double*>(data),
+                                           n, owner);
+      break;
+    case FLOAT_STORAGE:
+      res.floats = MappableVector<float>(static_cast<const float*>(data),
+                                         n, owner);
+      break;
+    case QUANTIZED_16_STORAGE:
+      res.q16 = MappableVector<uint16_t>(static_cast<const uint16_t*>(data),
+                                         n, owner);
+      res.offset = offset;
+      res.scale = scale;
+      break;
+    default:
+      res.q8 = MappableVector<uint8_t>(static_cast<const uint8_t*>(data),
+                                       n, owner);
+      res.offset = offset;
+      res.scale = scale;
+  }
+  this->swap(res);
+}
+
+/**
+ * \brief build the dictionary from names to indexes.
+ */
+void
+DistanceMatrix::index_names() {
+  this->index.clear();
+  for (size_t i = 0; i < this->names.size(); ++i) {
+    if (!this->index.emplace(this->names[i], i).second) {
+      throw CognoscoError("duplicate point in distance matrix: " +
+                          this->names[i]);
+    }
+  }
+}
@@ -20,18 +20,120 @@
 #ifndef DISTANCE_MATRIX_HPP_
 #define DISTANCE_MATRIX_HPP_
 
-#include <unordered_map>
+// stl includes
 #include <string>
+#include <vector>
+#include <unordered_map>
+#include <utility>
+#include <memory>
+#include <limits>
+#include <cstdint>
+
+// local Cognosco includes
+#include "NumericBuffer.hpp"
+#include "MappableVector.hpp"
+
+/**
+ * \brief A matrix of distances between a fixed set of named points. Points
+ *        are numbered from 0 in the order their names were given, and a
+ *        dictionary maps names to those indexes; distances are looked up by
+ *        index, so nothing is hashed once the points involved are known.
+ *
+ *        Distances are held contiguously, at any numeric storage. A full
+ *        matrix holds every (i, j), so d(i, j) and d(j, i) can differ. A
+ *        condensed matrix is for symmetric distances: it holds only the
+ *        upper triangle, excluding the diagonal (which is 0), in
+ *        n(n - 1)/2 entries, so setting d(i, j) also sets d(j, i).
+ *
+ *        Entries that have never been set are missing, and are NaN.
+ *
+ *        Distances are set at double or single precision. A complete
+ *        matrix can then be quantized to 16 or 8 bit codes, which map
+ *        linearly onto the range of its distances, with the largest code
+ *        reserved for missing entries; quantized matrices can't be
+ *        modified. Condensed storage and 8 bit codes together take
+ *        n(n - 1)/2 bytes, which is 1.25GB for 50,000 points; a sixteenth
+ *        of a full double precision matrix.
+ *
+ *        The distances can also refer to memory mapped from a matrix
+ *        snapshot, in which case they're only copied if the matrix is
+ *        modified. Distances can be set from several threads at once, as
+ *        long as the matrix isn't mapped and no two threads set the same
+ *        entry.
+ */
+class DistanceMatrix {
+public:
+  // constructors
+  DistanceMatrix() : condensed(false), storage(DOUBLE_STORAGE), offset(0),
+                     scale(1) {}
+  explicit DistanceMatrix(const std::vector<std::string> &names,
+                          const bool condensed=false,
+                          const NumericStorage &storage=DOUBLE_STORAGE);
 
-struct name_pair_hash {
-  size_t operator()(const std::pair<std::string, std::string> &names) const {
-    return std::hash<std::string>()(names.first) ^
-           std::hash<std::string>()(names.second);
+  // inspectors
+  size_t size() const { return this->names.size(); }
+  bool is_condensed() const { return this->condensed; }
+  NumericStorage get_storage() const { return this->storage; }
+  double get_offset() const { return this->offset; }
+  double get_scale() const { return this->scale; }
+  const std::vector<std::string>& get_names() const { return this->names; }
+  const std::string& get_name(const size_t i) const { return this->names[i]; }
+  bool find_index(const std::string &name, size_t &i) const;
+  size_t get_index(const std::string &name) const;
+  double get(const size_t i, const size_t j) const {
+    if (this->condensed && (i == j)) return 0;
+    return this->entry(this->position(i, j));
+  }
+  bool has(const size_t i, const size_t j) const;
+  size_t num_entries() const;
+  const void* entry_data() const;
+
+  // mutators
+  void set(const size_t i, const size_t j, const double dist);
+  void set_storage(const NumericStorage &s);
+  void swap(DistanceMatrix &other);
+  void map(const std::vector<std::string> &names, const bool condensed,
+           const NumericStorage &storage, const void *data,
+           const double offset, const double scale,
+           const std::shared_ptr<const void> &owner);
+
+private:
+  // private instance variables; only the vector for the current storage is
+  // used. Offset and scale are 0 and 1 unless storage is quantized.
+  bool condensed;
+  NumericStorage storage;
+  std::vector<std::string> names;
+  std::unordered_map<std::string, size_t> index;
+  MappableVector<double> doubles;
+  MappableVector<float> floats;
+  MappableVector<uint16_t> q16;
+  MappableVector<uint8_t> q8;
+  double offset;
+  double scale;
+
+  // private inspectors
+  size_t position(size_t i, size_t j) const {
+    if (!this->condensed) return i * this->names.size() + j;
+    if (i > j) std::swap(i, j);
+    return i * this->names.size() - i * (i + 1) / 2 + (j - i - 1);
+  }
+  double entry(const size_t idx) const {
+    switch (this->storage) {
+      case DOUBLE_STORAGE: return this->doubles[idx];
+      case FLOAT_STORAGE: return this->floats[idx];
+      case QUANTIZED_16_STORAGE: return this->dequantize(this->q16[idx]);
+      default: return this->dequantize(this->q8[idx]);
+    }
+  }
+  template <typename T> double dequantize(const T code) const {
+    if (code == std::numeric_limits<T>::max())
+      return std::numeric_limits<double>::quiet_NaN();
+    return this->offset + this->scale * code;
   }
-};
 
-typedef std::unordered_map<std::pair<std::string, std::string>,
-                           double, name_pair_hash>
-        DistanceMatrix;
+  // private mutators
+  void index_names();
+  template <typename T> void quantize(MappableVector<T> &codes);
+};
 
 #endif
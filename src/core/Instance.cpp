@@ -20,9 +20,12 @@
 // stl includes
 #include <sstream>
 #include <string>
+#include <algorithm>
 
 // local includes
 #include "Instance.hpp"
+#include "Dataset.hpp"
+#include "DatasetView.hpp"
 #include "CognoscoError.hpp"
 
 // bring the following into the local namespace
@@ -30,55 +33,88 @@ using std::string;
 using std::vector;
 
 // init. static variables in Instance class
-size_t Instance::instance_counter = 0;
+std::atomic<size_t> Instance::instance_counter(0);
 
 
 /*****************************************************************************
  *                       CONSTRUCTORS AND DESTRUCTORS                        *
  *****************************************************************************/
 
-Instance::Instance() : instance_id (Instance::instance_counter) {
-  this->instance_counter += 1;
-}
+Instance::Instance() : instance_id (Instance::new_instance_id()),
+                       dataset(NULL), row(0), projection(NULL) {}
 
-Instance::Instance(const Instance &inst) : instance_id(inst.instance_id) {
-  for (size_t i = 0; i < inst.attributes.size(); ++i) {
-    AttributeOccurrence *cpy = inst.attributes[i]->clone();
-    this->attributes.push_back(cpy);
-  }
-}
-
-Instance::~Instance() {
-  for (size_t i = 0; i < this->attributes.size(); ++i) {
-    delete this->attributes[i];
-  }
-}
+/**
+ * \brief a view of the given row of a dataset; if a projection is given, the
+ *        instance has only the attributes of that projection (which must be
+ *        a view of the same dataset).
+ */
+Instance::Instance(const Dataset *dataset, const size_t row,
+                   const DatasetView *projection) :
+  instance_id(dataset->get_instance_id(row)), dataset(dataset), row(row),
+  projection(projection) {}
 
 
 /*****************************************************************************
  *                               INSPECTORS                                  *
  *****************************************************************************/
 
-const AttributeOccurrence*
+size_t
+Instance::size() const {
+  if (this->projection != NULL) return this->projection->num_attributes();
+  if (this->dataset != NULL) return this->dataset->num_attributes();
+  return this->detached_values.size();
+}
+
+/**
+ * \brief get the index in the dataset of the column that holds this view's
+ *        ith attribute.
+ */
+size_t
+Instance::get_column_index(const size_t i) const {
+  if (this->projection != NULL) return this->projection->get_column_index(i);
+  return i;
+}
+
+AttributeOccurrence
 Instance::get_att_occurrence(const size_t i) const {
-  if (i >= this->attributes.size()) {
+  if (i >= this->size()) {
     std::stringstream ss;
     ss << "cannot get attribute number " << i << " as isntance has only "
-       << this->attributes.size() << " attributes";
+       << this->size() << " attributes";
     throw CognoscoError(ss.str());
   }
-  return this->attributes[i];
+  if (this->dataset == NULL) {
+    const DetachedValue &v = this->detached_values[i];
+    if (v.nominal) return AttributeOccurrence(v.att_desc_ptr, &v.label);
+    return AttributeOccurrence(v.att_desc_ptr, v.value);
+  }
+  const size_t k = this->get_column_index(i);
+  const Attribute *att_desc_ptr =\
+    this->dataset->get_attribute_description_ptr(k);
+  const Column &col = this->dataset->get_column(k);
+  if (col.get_type() == NOMINAL)
+    return AttributeOccurrence(att_desc_ptr, &col.get_label(this->row));
+  return AttributeOccurrence(att_desc_ptr, col.get_numeric(this->row));
 }
 
 /**
- * \brief
- * \TODO fix nasty O(n) performance.
+ * \brief get the occurrence of the named attribute. For instances that are
+ *        views of a dataset this uses the dataset's attribute index;
+ *        detached instances are searched.
  */
-const AttributeOccurrence*
+AttributeOccurrence
 Instance::get_att_occurrence(const std::string &name) const {
-  for (size_t i = 0; i < this->attributes.size(); ++i) {
-    if (this->attributes[i]->get_attribute_name() == name)
-      return this->attributes[i];
+  if (this->projection != NULL) {
+    return this->get_att_occurrence(
+      this->projection->get_attribute_index(name));
+  }
+  if (this->dataset != NULL) {
+    return this->get_att_occurrence(this->dataset->get_attribute_index(name));
+  }
+  for (size_t i = 0; i < this->size(); ++i) {
+    AttributeOccurrence occ (this->get_att_occurrence(i));
+    if (occ.get_attribute_name() == name)
+      return occ;
   }
   std::stringstream ss;
   ss << "No such attribute: " << name;
@@ -93,12 +129,36 @@ Instance::get_instance_id() const {
 string
 Instance::to_string() const {
   std::stringstream ss;
-  for (auto att_occ : this->attributes) {
-    ss << att_occ->to_string() << ", ";
+  for (auto it = this->begin(); it != this->end(); ++it) {
+    ss << it->to_string() << ", ";
   }
   return ss.str();
 }
 
+/*****************************************************************************
+ *                           STATIC CLASS METHODS                            *
+ *****************************************************************************/
+
+/**
+ * \brief reserve a new, unique instance id. Used for instances that are
+ *        added to a dataset without first building an Instance object.
+ *        Ids are handed out in increasing order, and safely from any
+ *        thread.
+ */
+size_t
+Instance::new_instance_id() {
+  return Instance::instance_counter++;
+}
+
+/**
+ * \brief reserve a block of n new, unique and consecutive instance ids.
+ * \return the first id in the block.
+ */
+size_t
+Instance::new_instance_ids(const size_t n) {
+  return Instance::instance_counter.fetch_add(n);
+}
+
 /*****************************************************************************
  *                                MUTATORS                                   *
  *****************************************************************************/
@@ -106,35 +166,52 @@ Instance::to_string() const {
 void
 Instance::add_attribute_occurrence(const double value,
                                     const Attribute *att_desc_p) {
-  AttributeOccurrence *x = new NumericAttributeOccurrence(value, att_desc_p);
-  this->attributes.push_back(x);
+  this->detach();
+  this->detached_values.push_back({att_desc_p, false, value, ""});
 };
 
 void
 Instance::add_attribute_occurrence(const std::string value,
                                     const Attribute *att_desc_p) {
-  AttributeOccurrence *x = new NominalAttributeOccurrence(value, att_desc_p);
-  this->attributes.push_back(x);
+  this->detach();
+  this->detached_values.push_back({att_desc_p, true, 0, value});
 };
 
 void
 Instance::delete_attribute_occurrence(const string &att_name) {
-  std::vector<AttributeOccurrence*> removed;
-  std::copy_if(this->attributes.begin(), this->attributes.end(),
-               std::back_inserter(removed),
-               [=](AttributeOccurrence* ao) {
-                 return ao->get_attribute_name() == att_name;
-               });
-  if (removed.empty()) {
+  this->detach();
+  auto n_end = std::remove_if(this->detached_values.begin(),
+                              this->detached_values.end(),
+                              [&](const DetachedValue &v) {
+                                return v.att_desc_ptr->get_name() == att_name;
+                              });
+  if (n_end == this->detached_values.end()) {
     throw CognoscoError("Cannot remove attribute " + att_name +\
                         " from instance; no such attribute");
   }
-  auto n_end = std::remove_if(this->attributes.begin(), this->attributes.end(),
-                              [=](AttributeOccurrence* ao) {
-                                return ao->get_attribute_name() == att_name;
-                              });
-  this->attributes.erase(n_end, this->attributes.end());
-  for (auto ptr : removed) {
-    delete ptr;
+  this->detached_values.erase(n_end, this->detached_values.end());
+}
+
+/**
+ * \brief if this instance is a view of a row in a dataset, copy the values
+ *        out of the dataset so that the instance can be modified without
+ *        changing the dataset.
+ */
+void
+Instance::detach() {
+  if (this->dataset == NULL) return;
+  for (size_t i = 0; i < this->size(); ++i) {
+    const size_t k = this->get_column_index(i);
+    const Attribute *att_desc_ptr =\
+      this->dataset->get_attribute_description_ptr(k);
+    const Column &col = this->dataset->get_column(k);
+    if (col.get_type() == NOMINAL)
+      this->detached_values.push_back({att_desc_ptr, true, 0,
+                                       col.get_label(this->row)});
+    else
+      this->detached_values.push_back({att_desc_ptr, false,
+                                       col.get_numeric(this->row), ""});
   }
+  this->dataset = NULL;
+  this->projection = NULL;
 }
@@ -22,54 +22,107 @@
 
 #include <string>
 #include <vector>
+#include <atomic>
 #include <iostream>
 
 #include "Attribute.hpp"
 
-// TODO the double de-reference required on the iterator is nasty; solution
-// is to write custom iterator -- maybe later...
+class Dataset;
+class DatasetView;
 
+/**
+ * \brief An Instance is either a view of one row of a Dataset, in which case
+ *        its values are read straight from the dataset's column storage, or a
+ *        detached instance that holds its own values (e.g. one that is being
+ *        built up before it is added to a Dataset). A view is only valid for
+ *        as long as the Dataset it refers to is alive and unmodified. Views
+ *        handed out by a projected DatasetView see only the attributes of
+ *        that projection, and are valid only while the DatasetView is.
+ */
 class Instance {
 public:
   // constructors and destructors
   Instance();
-  Instance(const Instance &inst);
-  ~Instance();
+  Instance(const Dataset *dataset, const size_t row,
+           const DatasetView *projection = NULL);
 
   // types
-  typedef std::vector<AttributeOccurrence*>::iterator iterator;
-  typedef std::vector<AttributeOccurrence*>::const_iterator const_iterator;
+  class const_iterator {
+  public:
+    const_iterator(const Instance *inst, const size_t idx) :
+      inst(inst), idx(idx) {}
+    const AttributeOccurrence& operator*() const {
+      this->current = this->inst->get_att_occurrence(this->idx);
+      return this->current;
+    }
+    const AttributeOccurrence* operator->() const { return &(**this); }
+    const_iterator& operator++() { this->idx += 1; return *this; }
+    bool operator==(const const_iterator &o) const { return idx == o.idx; }
+    bool operator!=(const const_iterator &o) const { return idx != o.idx; }
+  private:
+    const Instance *inst;
+    size_t idx;
+    mutable AttributeOccurrence current;
+  };
 
   // inspectors
-  const_iterator begin() const { return this->attributes.begin(); }
-  const_iterator end() const { return this->attributes.end(); }
-  const AttributeOccurrence* get_att_occurrence(const size_t i) const;
-  const AttributeOccurrence* get_att_occurrence(const std::string &name) const;
+  const_iterator begin() const { return const_iterator(this, 0); }
+  const_iterator end() const { return const_iterator(this, this->size()); }
+  size_t size() const;
+  AttributeOccurrence get_att_occurrence(const size_t i) const;
+  AttributeOccurrence get_att_occurrence(const std::string &name) const;
   size_t get_instance_id() const;
-  const AttributeOccurrence* operator[] (const int i) const {
+  AttributeOccurrence operator[] (const int i) const {
     return this->get_att_occurrence(i);
   }
-  const AttributeOccurrence* operator[] (const std::string &name) const {
+  AttributeOccurrence operator[] (const std::string &name) const {
     return this->get_att_occurrence(name);
   }
   std::string to_string() const;
 
+  // static class methods
+  static size_t new_instance_id();
+  static size_t new_instance_ids(const size_t n);
+
   // mutators
   void add_attribute_occurrence(const std::string value,
                                 const Attribute *att_desc_ptr);
   void add_attribute_occurrence(const double value,
                                 const Attribute *att_desc_ptr);
   void delete_attribute_occurrence(const std::string &att_name);
-  iterator begin() { return this->attributes.begin(); }
-  iterator end() { return this->attributes.end(); }
 
 private:
+  // the iterators of Dataset and DatasetView hold an instance that they
+  // point at a row when dereferenced, so it doesn't need an id of its own
+  friend class Dataset;
+  friend class DatasetView;
+  struct Unbound {};
+  explicit Instance(Unbound) : instance_id(0), dataset(NULL), row(0),
+                               projection(NULL) {}
+
+  // types
+  struct DetachedValue {
+    const Attribute *att_desc_ptr;
+    bool nominal;
+    double value;
+    std::string label;
+  };
+
   // instance variables
   size_t instance_id;
-  std::vector<AttributeOccurrence*> attributes;
+  const Dataset *dataset;
+  size_t row;
+  const DatasetView *projection;
+  std::vector<DetachedValue> detached_values;
+
+  // private inspectors
+  size_t get_column_index(const size_t i) const;
+
+  // private mutators
+  void detach();
 
   // static class variables
-  static size_t instance_counter;
+  static std::atomic<size_t> instance_counter;
 };
 
 #endif
@@ -0,0 +1,126 @@
+/* The following applies to this software package and all subparts therein
+ *
+ * Cognosco Copyright (C) 2015 Philip J. Uren
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or (at
+ * your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef MAPPABLE_VECTOR_HPP_
+#define MAPPABLE_VECTOR_HPP_
+
+// stl includes
+#include <vector>
+#include <memory>
+#include <cstddef>
+#include <utility>
+
+/**
+ * \brief A contiguous array that either owns its elements, like a
+ *        std::vector, or refers read-only to elements held somewhere else
+ *        (normally a memory-mapped file). The owner of the external memory
+ *        is held by shared pointer and kept alive for as long as any array
+ *        refers to it. Copies of a mapped array refer to the same memory.
+ *        Any modification of a mapped array first copies its elements into
+ *        memory the array owns, so mapped memory is never written to.
+ */
+template <typename T>
+class MappableVector {
+public:
+  // constructors
+  MappableVector() : ptr(NULL), n(0) {}
+  MappableVector(const T *data, const size_t n,
+                 const std::shared_ptr<const void> &owner) :
+    ptr(data), n(n), owner(owner) {}
+  MappableVector(const MappableVector &o) : owned(o.owned), owner(o.owner) {
+    if (this->owner) { this->ptr = o.ptr; this->n = o.n; }
+    else this->sync();
+  }
+  MappableVector(MappableVector &&o) : MappableVector() { this->swap(o); }
+  MappableVector& operator=(MappableVector o) { this->swap(o); return *this; }
+
+  // inspectors
+  size_t size() const { return this->n; }
+  bool empty() const { return this->n == 0; }
+  bool is_mapped() const { return static_cast<bool>(this->owner); }
+  const T* data() const { return this->ptr; }
+  const T* begin() const { return this->ptr; }
+  const T* end() const { return this->ptr + this->n; }
+  const T& operator[](const size_t i) const { return this->ptr[i]; }
+  const T& back() const { return this->ptr[this->n - 1]; }
+
+  // mutators
+  void swap(MappableVector &o) {
+    // swapping vectors keeps their elements where they are, so the cached
+    // pointers stay valid.
+    std::swap(this->owned, o.owned);
+    std::swap(this->ptr, o.ptr);
+    std::swap(this->n, o.n);
+    std::swap(this->owner, o.owner);
+  }
+  void push_back(const T &val) {
+    this->detach();
+    this->owned.push_back(val);
+    this->sync();
+  }
+  void reserve(const size_t k) {
+    this->detach();
+    this->owned.reserve(k);
+    this->sync();
+  }
+  void append(const T *first, const T *last) {
+    this->detach();
+    this->owned.insert(this->owned.end(), first, last);
+    this->sync();
+  }
+  void assign(const size_t k, const T &val) {
+    this->owner.reset();
+    this->owned.assign(k, val);
+    this->sync();
+  }
+  T* mutable_data() {
+    this->detach();
+    return this->owned.data();
+  }
+  template <typename It> void assign(It first, It last) {
+    std::vector<T> tmp(first, last);
+    this->owner.reset();
+    this->owned.swap(tmp);
+    this->sync();
+  }
+  void clear() {
+    this->owner.reset();
+    std::vector<T>().swap(this->owned);
+    this->sync();
+  }
+
+private:
+  // private instance variables; ptr and n describe the elements, which are
+  // either those of owned, or external memory kept alive by owner.
+  std::vector<T> owned;
+  const T *ptr;
+  size_t n;
+  std::shared_ptr<const void> owner;
+
+  // private mutators
+  void sync() { this->ptr = this->owned.data(); this->n = this->owned.size(); }
+  void detach() {
+    if (!this->owner) return;
+    this->owned.assign(this->ptr, this->ptr + this->n);
+    this->owner.reset();
+    this->sync();
+  }
+};
+
+#endif
@@ -17,7 +17,37 @@
  * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
 
+// stl includes
+#include <vector>
+#include <string>
+#include <limits>
+
+// local includes
 #include "MisclassificationCostMatrix.hpp"
 
+// bring these into the local namespace
+using std::vector;
+
 const double MisclassificationCostMatrix::DEFAULT_MATCH_COST = 0.0;
 const double MisclassificationCostMatrix::DEFAULT_MISMATCH_COST = 1.0;
+
+/**
+ * \brief build a dense table of costs indexed by the codes used for the
+ *        class labels in the given column; table[a][p] is the cost of
+ *        predicting label p when the actual label is a. Pairs that are not
+ *        in the matrix are NaN.
+ */
+vector<vector<double> >
+MisclassificationCostMatrix::get_cost_table(const Column &class_column) const {
+  const size_t n = class_column.num_labels();
+  vector<vector<double> > table(n, vector<double>(n,
+                                std::numeric_limits<double>::quiet_NaN()));
+  for (uint32_t a = 0; a < n; ++a) {
+    for (uint32_t p = 0; p < n; ++p) {
+      auto k = std::make_pair(class_column.decode(a), class_column.decode(p));
+      if (this->degenerate || this->map.find(k) != this->map.end())
+        table[a][p] = (*this)[k];
+    }
+  }
+  return table;
+}
@@ -24,10 +24,12 @@
 #include <string>
 #include <unordered_map>
 #include <sstream>
+#include <vector>
 
 // local includes
 #include "CognoscoError.hpp"
 #include "StringUtils.hpp"
+#include "Column.hpp"
 
 class MisclassificationCostMatrix {
 public:
@@ -66,6 +68,8 @@ public:
     }
     return misclass_it->second;
   }
+  std::vector<std::vector<double> >
+  get_cost_table(const Column &class_column) const;
 private:
   std::unordered_map<std::pair<std::string, std::string>, double,
                      string_pair_hash> map;
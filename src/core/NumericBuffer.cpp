@@ -0,0 +1,232 @@
+/* The following applies to this software package and all subparts therein
+ *
+ * Cognosco Copyright (C) 2015 Philip J. Uren
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or (at
+ * your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+// stl includes
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+// local Cognosco includes
+#include "NumericBuffer.hpp"
+#include "CognoscoError.hpp"
+
+// bring these into the local namespace
+using std::string;
+using std::vector;
+
+/**
+ * \brief get the numeric storage named by the given string; one of double,
+ *        float, quantized16 or quantized8.
+ */
+NumericStorage
+parse_numeric_storage(const string &s) {
+  if (s == "double") return DOUBLE_STORAGE;
+  if (s == "float") return FLOAT_STORAGE;
+  if (s == "quantized16") return QUANTIZED_16_STORAGE;
+  if (s == "quantized8") return QUANTIZED_8_STORAGE;
+  throw CognoscoError("unknown numeric storage: " + s);
+}
+
+/*****************************************************************************
+ *                               INSPECTORS                                  *
+ *****************************************************************************/
+
+size_t
+NumericBuffer::size() const {
+  switch (this->storage) {
+    case DOUBLE_STORAGE: return this->doubles.size();
+    case FLOAT_STORAGE: return this->floats.size();
+    case QUANTIZED_16_STORAGE: return this->q16.size();
+    default: return this->q8.size();
+  }
+}
+
+vector<double>
+NumericBuffer::to_doubles() const {
+  vector<double> res(this->size());
+  for (size_t i = 0; i < res.size(); ++i) res[i] = this->get(i);
+  return res;
+}
+
+/**
+ * \brief the largest code a quantized buffer can hold.
+ */
+double
+NumericBuffer::max_code() const {
+  if (this->storage == QUANTIZED_16_STORAGE)
+    return std::numeric_limits<uint16_t>::max();
+  return std::numeric_limits<uint8_t>::max();
+}
+
+
+/*****************************************************************************
+ *                                MUTATORS                                   *
+ *****************************************************************************/
+
+/**
+ * \brief change the precision the values are stored at, converting any
+ *        values already held.
+ */
+void
+NumericBuffer::set_storage(const NumericStorage &s) {
+  if (s == this->storage) return;
+  const vector<double> vals(this->to_doubles());
+  this->clear();
+  this->storage = s;
+  this->assign(vals);
+}
+
+void
+NumericBuffer::push_back(const double val) {
+  if (this->storage == DOUBLE_STORAGE) {
+    this->doubles.push_back(val);
+    return;
+  }
+  if (this->storage == FLOAT_STORAGE) {
+    this->floats.push_back(val);
+    return;
+  }
+
+  // the code for this value; -1 if there isn't one in the current range
+  double code = -1;
+  if (this->scale != 0)
+    code = std::round((val - this->offset) / this->scale);
+  else if (val == this->offset)
+    code = 0;
+  if ((this->size() != 0) && (code >= 0) && (code <= this->max_code())) {
+    if (this->storage == QUANTIZED_16_STORAGE) this->q16.push_back(code);
+    else this->q8.push_back(code);
+  } else {
+    // outside the range we can represent, so re-quantize everything
+    vector<double> vals(this->to_doubles());
+    vals.push_back(val);
+    this->quantize(vals);
+  }
+}
+
+/**
+ * \brief append values [from, to) of another buffer. Unquantized values
+ *        already at this buffer's precision are copied in bulk.
+ */
+void
+NumericBuffer::append(const NumericBuffer &other, const size_t from,
+                      const size_t to) {
+  if ((this->storage == other.storage) && (this->storage == DOUBLE_STORAGE)) {
+    this->doubles.append(other.doubles.data() + from,
+                         other.doubles.data() + to);
+  } else if ((this->storage == other.storage) &&
+             (this->storage == FLOAT_STORAGE)) {
+    this->floats.append(other.floats.data() + from, other.floats.data() + to);
+  } else {
+    for (size_t i = from; i < to; ++i) this->push_back(other.get(i));
+  }
+}
+
+/**
+ * \brief replace the contents of the buffer with the given values, stored
+ *        at the buffer's current precision.
+ */
+void
+NumericBuffer::assign(const vector<double> &vals) {
+  if (this->storage == DOUBLE_STORAGE)
+    this->doubles.assign(vals.begin(), vals.end());
+  else if (this->storage == FLOAT_STORAGE)
+    this->floats.assign(vals.begin(), vals.end());
+  else
+    this->quantize(vals);
+}
+
+void
+NumericBuffer::reserve(const size_t n) {
+  switch (this->storage) {
+    case DOUBLE_STORAGE: this->doubles.reserve(n); break;
+    case FLOAT_STORAGE: this->floats.reserve(n); break;
+    case QUANTIZED_16_STORAGE: this->q16.reserve(n); break;
+    default: this->q8.reserve(n);
+  }
+}
+
+void
+NumericBuffer::clear() {
+  this->doubles.clear();
+  this->floats.clear();
+  this->q16.clear();
+  this->q8.clear();
+  this->offset = 0;
+  this->scale = 1;
+}
+
+/**
+ * \brief refer to n values, stored at the given precision, that are held
+ *        elsewhere and kept alive by owner; nothing is copied. The values
+ *        must be suitably aligned for their type.
+ */
+void
+NumericBuffer::map(const NumericStorage &s, const void *data, const size_t n,
+                   const double offset, const double scale,
+                   const std::shared_ptr<const void> &owner) {
+  this->clear();
+  this->storage = s;
+  switch (s) {
+    case DOUBLE_STORAGE:
+      this->doubles = MappableVector<double>(
+        static_cast<const double*>(data), n, owner);
+      return;
+    case FLOAT_STORAGE:
+      this->floats = MappableVector<float>(
+        static_cast<const float*>(data), n, owner);
+      return;
+    case QUANTIZED_16_STORAGE:
+      this->q16 = MappableVector<uint16_t>(
+        static_cast<const uint16_t*>(data), n, owner);
+      break;
+    default:
+      this->q8 = MappableVector<uint8_t>(
+        static_cast<const uint8_t*>(data), n, owner);
+  }
+  this->offset = offset;
+  this->scale = scale;
+}
+
+/**
+ * \brief store the given values as codes spread evenly over their range.
+ */
+void
+NumericBuffer::quantize(const vector<double> &vals) {
+  this->q16.clear();
+  this->q8.clear();
+  if (vals.empty()) {
+    this->offset = 0;
+    this->scale = 1;
+    return;
+  }
+
+  const auto range = std::minmax_element(vals.begin(), vals.end());
+  this->offset = *(range.first);
+  this->scale = (*(range.second) - *(range.first)) / this->max_code();
+  for (auto val : vals) {
+    const double code = (this->scale == 0) ? 0 :
+      std::min(this->max_code(),
+               std::round((val - this->offset) / this->scale));
+    if (this->storage == QUANTIZED_16_STORAGE) this->q16.push_back(code);
+    else this->q8.push_back(code);
+  }
+}
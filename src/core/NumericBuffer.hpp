@@ -0,0 +1,104 @@
+/* The following applies to this software package and all subparts therein
+ *
+ * Cognosco Copyright (C) 2015 Philip J. Uren
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or (at
+ * your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef NUMERIC_BUFFER_HPP_
+#define NUMERIC_BUFFER_HPP_
+
+// stl includes
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <memory>
+
+// local Cognosco includes
+#include "MappableVector.hpp"
+
+/**
+ * \brief the precision numeric values are stored at. Quantized values are
+ *        stored as 8 or 16 bit codes, which map linearly onto the range of
+ *        values in their buffer: value = offset + scale * code.
+ */
+enum NumericStorage {DOUBLE_STORAGE, FLOAT_STORAGE,
+                     QUANTIZED_16_STORAGE, QUANTIZED_8_STORAGE};
+
+NumericStorage parse_numeric_storage(const std::string &s);
+
+/**
+ * \brief A contiguous array of numeric values stored at a chosen precision.
+ *        Appending a value outside the range of a quantized buffer
+ *        re-quantizes the whole buffer over the wider range, which is
+ *        linear in the size of the buffer; quantized storage is best chosen
+ *        once the values are all present. A buffer can also be mapped onto
+ *        values held elsewhere, such as in a memory-mapped dataset snapshot;
+ *        these are only copied if the buffer is modified.
+ */
+class NumericBuffer {
+public:
+  // constructors
+  NumericBuffer() : storage(DOUBLE_STORAGE), offset(0), scale(1) {}
+
+  // inspectors
+  NumericStorage get_storage() const { return this->storage; }
+  size_t size() const;
+  double get(const size_t i) const {
+    switch (this->storage) {
+      case DOUBLE_STORAGE: return this->doubles[i];
+      case FLOAT_STORAGE: return this->floats[i];
+      case QUANTIZED_16_STORAGE: return this->offset + this->scale * this->q16[i];
+      default: return this->offset + this->scale * this->q8[i];
+    }
+  }
+  double get_offset() const { return this->offset; }
+  double get_scale() const { return this->scale; }
+  const double* double_data() const { return this->doubles.data(); }
+  const float* float_data() const { return this->floats.data(); }
+  const uint16_t* q16_data() const { return this->q16.data(); }
+  const uint8_t* q8_data() const { return this->q8.data(); }
+
+  // mutators
+  void set_storage(const NumericStorage &s);
+  void push_back(const double val);
+  void append(const NumericBuffer &other, const size_t from, const size_t to);
+  void assign(const std::vector<double> &vals);
+  void reserve(const size_t n);
+  void clear();
+  void map(const NumericStorage &s, const void *data, const size_t n,
+           const double offset, const double scale,
+           const std::shared_ptr<const void> &owner);
+
+private:
+  // private instance variables; only the vector for the current storage
+  // is used. Offset and scale are 0 and 1 unless storage is quantized.
+  NumericStorage storage;
+  MappableVector<double> doubles;
+  MappableVector<float> floats;
+  MappableVector<uint16_t> q16;
+  MappableVector<uint8_t> q8;
+  double offset;
+  double scale;
+
+  // private inspectors
+  std::vector<double> to_doubles() const;
+  double max_code() const;
+
+  // private mutators
+  void quantize(const std::vector<double> &vals);
+};
+
+#endif
@@ -0,0 +1,55 @@
+/* The following applies to this software package and all subparts therein
+ *
+ * Cognosco Copyright (C) 2015 Philip J. Uren
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or (at
+ * your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+// stl includes
+#include <string>
+
+// local Cognosco includes
+#include "StringTable.hpp"
+
+// bring these into the local namespace
+using std::string;
+
+/**
+ * \brief look up the id of a string without adding it.
+ * \return true if the string is in the table, in which case id is set.
+ */
+bool
+StringTable::find(const string &s, uint32_t &id) const {
+  auto it = this->ids.find(s);
+  if (it == this->ids.end()) return false;
+  id = it->second;
+  return true;
+}
+
+/**
+ * \brief get the id for the given string, adding it to the table if it
+ *        isn't already there. The table keeps pointers to the keys of its
+ *        map; these are stable across rehashing. Strings already in the
+ *        table are looked up before trying to insert them, since emplace
+ *        allocates a node whether or not it inserts one.
+ */
+uint32_t
+StringTable::intern(const string &s) {
+  auto it = this->ids.find(s);
+  if (it != this->ids.end()) return it->second;
+  auto res = this->ids.emplace(s, this->strings.size());
+  if (res.second) this->strings.push_back(&(res.first->first));
+  return res.first->second;
+}
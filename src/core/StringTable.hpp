@@ -0,0 +1,49 @@
+/* The following applies to this software package and all subparts therein
+ *
+ * Cognosco Copyright (C) 2015 Philip J. Uren
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or (at
+ * your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef STRING_TABLE_HPP_
+#define STRING_TABLE_HPP_
+
+// stl includes
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <unordered_map>
+
+/**
+ * \brief An intern table; each distinct string added is stored once and
+ *        identified by a small integer id. Ids, and references to the
+ *        strings, remain valid for the lifetime of the table.
+ */
+class StringTable {
+public:
+  // inspectors
+  const std::string& get(const uint32_t id) const { return *(strings[id]); }
+  size_t size() const { return this->strings.size(); }
+  bool find(const std::string &s, uint32_t &id) const;
+
+  // mutators
+  uint32_t intern(const std::string &s);
+
+private:
+  std::vector<const std::string*> strings;
+  std::unordered_map<std::string, uint32_t> ids;
+};
+
+#endif
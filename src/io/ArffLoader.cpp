@@ -16,3 +16,464 @@
  * along with this library; if not, write to the Free Software Foundation,
  * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
+
+// stl includes
+#include <string>
+#include <vector>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <cstring>
+#include <cctype>
+#include <memory>
+
+// system includes
+#include <sys/stat.h>
+
+// local Cognosco includes
+#include "ArffLoader.hpp"
+#include "StringUtils.hpp"
+#include "MappedFile.hpp"
+#include "Dataset.hpp"
+#include "Column.hpp"
+#include "CognoscoError.hpp"
+
+// bring these into local namespace
+using std::cerr;
+using std::endl;
+using std::string;
+using std::vector;
+using std::ifstream;
+
+/**
+ * \brief the state carried from one line to the next while loading: the
+ *        declared nominal values of each attribute (empty for those that
+ *        don't declare any), and, once @data is reached, the columns the
+ *        rows are parsed into. Labels are copied into re-used buffers, so
+ *        once those have grown to fit the longest label they don't allocate
+ *        again.
+ */
+struct ArffLoader::LoadState {
+  LoadState() : in_data(false), num_rows(0) {}
+  bool in_data;
+  size_t num_rows;
+  vector<vector<string> > domains;
+  vector<Column> cols;
+  string label;
+  string unescaped;
+};
+
+
+/*****************************************************************************
+ *                               PARSING                                     *
+ *****************************************************************************/
+
+static inline bool
+is_space(const char c) {
+  return std::isspace(static_cast<unsigned char>(c));
+}
+
+/**
+ * \brief move pos past any whitespace.
+ */
+static void
+skip_space(const char *&pos, const char *end) {
+  while ((pos != end) && is_space(*pos)) ++pos;
+}
+
+/**
+ * \brief check whether [begin, end) is the given keyword, ignoring case.
+ */
+static bool
+is_keyword(const char *begin, const char *end, const char *keyword) {
+  const size_t len = strlen(keyword);
+  if (size_t(end - begin) != len) return false;
+  for (size_t i = 0; i < len; ++i) {
+    if (std::tolower(static_cast<unsigned char>(begin[i])) != keyword[i])
+      return false;
+  }
+  return true;
+}
+
+/**
+ * \brief read the next token, starting from pos, and move pos past it and
+ *        any whitespace that follows. Tokens are either quoted with ' or ",
+ *        or end at whitespace or any of the given delimiters. Quotes are
+ *        removed; if the token also has escaped characters, it's unescaped
+ *        into buf, and [begin, end) is given in that instead.
+ * \return false if there are no more tokens before end.
+ */
+static bool
+next_token(const char *&pos, const char *end, const char *delims,
+           const char *&begin, const char *&tok_end, bool &quoted,
+           string &buf) {
+  skip_space(pos, end);
+  if ((pos == end) || strchr(delims, *pos) != NULL) return false;
+
+  quoted = (*pos == '\'') || (*pos == '"');
+  if (!quoted) {
+    begin = pos;
+    while ((pos != end) && !is_space(*pos) &&
+           (strchr(delims, *pos) == NULL))
+      ++pos;
+    tok_end = pos;
+    skip_space(pos, end);
+    return true;
+  }
+
+  const char quote = *pos++;
+  begin = pos;
+  bool escaped = false;
+  while ((pos != end) && (*pos != quote)) {
+    if ((*pos == '\\') && (pos + 1 != end)) {
+      escaped = true;
+      ++pos;
+    }
+    ++pos;
+  }
+  if (pos == end)
+    throw CognoscoError("unterminated quoted value: " + string(begin - 1, end));
+  tok_end = pos++;
+  skip_space(pos, end);
+  if (!escaped) return true;
+
+  buf.clear();
+  for (const char *c = begin; c != tok_end; ++c) {
+    if (*c != '\\') {
+      buf.push_back(*c);
+      continue;
+    }
+    ++c;
+    if (*c == 'n') buf.push_back('\n');
+    else if (*c == 't') buf.push_back('\t');
+    else if (*c == 'r') buf.push_back('\r');
+    else buf.push_back(*c);
+  }
+  begin = buf.data();
+  tok_end = buf.data() + buf.size();
+  return true;
+}
+
+/**
+ * \brief parse a line of the file, given by [begin, end) without its
+ *        newline. Blank lines and comments are skipped; before @data, each
+ *        line is a declaration, and after it, a row.
+ */
+void
+ArffLoader::parse_line(const char *begin, const char *end, Dataset &dataset,
+                       LoadState &state) const {
+  skip_space(begin, end);
+  if ((begin == end) || (*begin == '%')) return;
+  if (state.in_data) {
+    if (*begin == '{') this->parse_sparse_row(begin + 1, end, dataset, state);
+    else this->parse_dense_row(begin, end, dataset, state);
+    state.num_rows += 1;
+    return;
+  }
+
+  const char *kw_end = begin;
+  while ((kw_end != end) && !is_space(*kw_end)) ++kw_end;
+  if (is_keyword(begin, kw_end, "@relation")) return;
+  if (is_keyword(begin, kw_end, "@attribute"))
+    this->parse_attribute(kw_end, end, dataset, state);
+  else if (is_keyword(begin, kw_end, "@data"))
+    this->start_data(dataset, state);
+  else
+    throw CognoscoError("unexpected line in ARFF header: " +
+                        string(begin, end));
+}
+
+/**
+ * \brief parse an attribute declaration, given by the text that follows
+ *        @attribute, and add the attribute to the dataset.
+ */
+void
+ArffLoader::parse_attribute(const char *pos, const char *end,
+                            Dataset &dataset, LoadState &state) const {
+  const char *tok_begin, *tok_end;
+  bool quoted;
+  if (!next_token(pos, end, "{", tok_begin, tok_end, quoted, state.unescaped))
+    throw CognoscoError("attribute declaration has no name");
+  const string name(tok_begin, tok_end);
+
+  vector<string> domain;
+  AttributeType type = NOMINAL;
+  if ((pos != end) && (*pos == '{')) {
+    ++pos;
+    while (next_token(pos, end, ",}", tok_begin, tok_end, quoted,
+                      state.unescaped)) {
+      domain.push_back(string(tok_begin, tok_end));
+      if ((pos != end) && (*pos == ',')) ++pos;
+    }
+    if ((pos == end) || (*pos != '}'))
+      throw CognoscoError("unterminated list of values for attribute " + name);
+    if (domain.empty())
+      throw CognoscoError("no values declared for attribute " + name);
+  } else {
+    if (!next_token(pos, end, "", tok_begin, tok_end, quoted, state.unescaped))
+      throw CognoscoError("attribute " + name + " has no type");
+    if (is_keyword(tok_begin, tok_end, "numeric") ||
+        is_keyword(tok_begin, tok_end, "real") ||
+        is_keyword(tok_begin, tok_end, "integer"))
+      type = NUMERIC;
+    else if (!is_keyword(tok_begin, tok_end, "string") &&
+             !is_keyword(tok_begin, tok_end, "date"))
+      throw CognoscoError("unsupported type " + string(tok_begin, tok_end) +
+                          " for attribute " + name);
+  }
+  dataset.add_attribute(Attribute(name, type));
+  state.domains.push_back(domain);
+}
+
+/**
+ * \brief set up the columns that rows are parsed into, once the header has
+ *        been read. Columns for attributes with declared values get those
+ *        values as their dictionary, in order, so each value's code is its
+ *        position in the declaration. String and date columns start with
+ *        the empty string as code 0, which is what a sparse row that leaves
+ *        them out stands for. Numeric values are kept at full
+ *        precision unless the dataset doesn't need it.
+ */
+void
+ArffLoader::start_data(Dataset &dataset, LoadState &state) const {
+  std::shared_ptr<StringTable> strings(new StringTable());
+  const NumericStorage storage = (dataset.get_numeric_storage() ==
+                                  DOUBLE_STORAGE) ? DOUBLE_STORAGE :
+                                                    FLOAT_STORAGE;
+  for (size_t k = 0; k < dataset.num_attributes(); ++k) {
+    state.cols.push_back(Column(dataset.get_attribute_type(k), strings));
+    state.cols.back().set_storage(storage);
+    if (!state.domains[k].empty()) {
+      state.cols.back().assign_nominal(state.domains[k],
+                                       MappableVector<uint32_t>());
+    } else if (dataset.get_attribute_type(k) == NOMINAL) {
+      state.cols.back().assign_nominal(vector<string>(1, ""),
+                                       MappableVector<uint32_t>());
+    }
+  }
+  state.in_data = true;
+}
+
+/**
+ * \brief add the value [begin, end) to the current row of the k'th
+ *        attribute's column. Any rows the column skipped, by being left out
+ *        of sparse rows, are filled in first.
+ */
+void
+ArffLoader::add_value(const size_t k, const char *begin, const char *end,
+                      const bool quoted, Dataset &dataset,
+                      LoadState &state) const {
+  if (!quoted && (end - begin == 1) && (*begin == '?')) {
+    throw CognoscoError("missing value for attribute " +
+                        dataset.get_attribute_description_ptr(k)->get_name() +
+                        "; missing values are not supported");
+  }
+  Column &col = state.cols[k];
+  col.fill(state.num_rows);
+  if (col.get_type() == NUMERIC) {
+    double val;
+    if (!parse_double(begin, end, val)) {
+      std::stringstream ss;
+      ss << "failed to parse " << string(begin, end) << " as numeric for "
+         << "attribute "
+         << dataset.get_attribute_description_ptr(k)->get_name();
+      throw CognoscoError(ss.str());
+    }
+    col.push_back(val);
+    return;
+  }
+
+  state.label.assign(begin, end);
+  if (state.domains[k].empty()) {
+    col.push_back(state.label);
+    return;
+  }
+  uint32_t code;
+  if (!col.find_code(state.label, code)) {
+    throw CognoscoError("value " + state.label + " is not declared for "
+                        "attribute " +
+                        dataset.get_attribute_description_ptr(k)->get_name());
+  }
+  col.push_code(code);
+}
+
+/**
+ * \brief parse a dense row, with a value for every attribute.
+ */
+void
+ArffLoader::parse_dense_row(const char *pos, const char *end,
+                            Dataset &dataset, LoadState &state) const {
+  const char *tok_begin, *tok_end;
+  bool quoted;
+  size_t k = 0;
+  while (next_token(pos, end, ",", tok_begin, tok_end, quoted,
+                    state.unescaped)) {
+    if (k == state.cols.size()) {
+      std::stringstream ss;
+      ss << "row " << state.num_rows << " has more than " << k << " values";
+      throw CognoscoError(ss.str());
+    }
+    this->add_value(k++, tok_begin, tok_end, quoted, dataset, state);
+    if (pos == end) break;
+    if (*pos != ',') {
+      std::stringstream ss;
+      ss << "expected , after value " << k << " of row " << state.num_rows;
+      throw CognoscoError(ss.str());
+    }
+    ++pos;
+  }
+  if (k != state.cols.size()) {
+    std::stringstream ss;
+    ss << "row " << state.num_rows << " has " << k << " values, but "
+       << state.cols.size() << " attributes are declared";
+    throw CognoscoError(ss.str());
+  }
+}
+
+/**
+ * \brief parse a sparse row, given by the text following its opening {.
+ *        Attribute indexes must be in increasing order.
+ */
+void
+ArffLoader::parse_sparse_row(const char *pos, const char *end,
+                             Dataset &dataset, LoadState &state) const {
+  const char *tok_begin, *tok_end;
+  bool quoted;
+  size_t next_k = 0;
+  while (next_token(pos, end, ",}", tok_begin, tok_end, quoted,
+                    state.unescaped)) {
+    size_t k = 0;
+    for (const char *c = tok_begin; c != tok_end; ++c) {
+      if (!std::isdigit(static_cast<unsigned char>(*c)) || quoted) {
+        throw CognoscoError("failed to parse attribute index " +
+                            string(tok_begin, tok_end) + " in sparse row");
+      }
+      k = 10 * k + (*c - '0');
+    }
+    if ((k < next_k) || (k >= state.cols.size())) {
+      std::stringstream ss;
+      ss << "attribute index " << k << " in row " << state.num_rows << " is "
+         << ((k < next_k) ? "out of order" : "out of range");
+      throw CognoscoError(ss.str());
+    }
+    if (!next_token(pos, end, ",}", tok_begin, tok_end, quoted,
+                    state.unescaped)) {
+      std::stringstream ss;
+      ss << "no value for attribute index " << k << " in row "
+         << state.num_rows;
+      throw CognoscoError(ss.str());
+    }
+    this->add_value(k, tok_begin, tok_end, quoted, dataset, state);
+    next_k = k + 1;
+    if ((pos != end) && (*pos == ',')) ++pos;
+  }
+  if ((pos == end) || (*pos != '}')) {
+    std::stringstream ss;
+    ss << "unterminated sparse row " << state.num_rows;
+    throw CognoscoError(ss.str());
+  }
+  ++pos;
+  skip_space(pos, end);
+  if (pos != end) {
+    std::stringstream ss;
+    ss << "unexpected text after sparse row " << state.num_rows << ": "
+       << string(pos, end);
+    throw CognoscoError(ss.str());
+  }
+}
+
+/**
+ * \brief pad every column out to the number of rows read, and move them
+ *        into the dataset.
+ */
+void
+ArffLoader::finish(Dataset &dataset, LoadState &state) const {
+  if (!state.in_data)
+    throw CognoscoError("no @data section found in ARFF file");
+  for (auto &col : state.cols) col.fill(state.num_rows);
+  dataset.set_columns(state.cols);
+}
+
+
+/*****************************************************************************
+ *                               LOADING                                     *
+ *****************************************************************************/
+
+/**
+ * \brief load the dataset by memory-mapping the file and parsing each line
+ *        in place.
+ */
+void
+ArffLoader::load_mapped(const string &filename, Dataset &dataset) const {
+  MappedFile file(filename);
+  file.advise_sequential();
+  LoadState state;
+  const char *begin = file.data();
+  const char *end = begin + file.size();
+  while (begin < end) {
+    const char *eol = static_cast<const char*>(memchr(begin, '\n',
+                                                      end - begin));
+    if (eol == NULL) eol = end;
+    this->parse_line(begin, eol, dataset, state);
+    begin = eol + 1;
+  }
+  this->finish(dataset, state);
+}
+
+/**
+ * \brief load the dataset by reading the file a line at a time.
+ */
+void
+ArffLoader::load_stream(const string &filename, Dataset &dataset) const {
+  ifstream strm(filename.c_str());
+  if (!strm.good()) {
+    std::stringstream ss;
+    ss << "failed to open file: " << filename;
+    throw CognoscoError(ss.str());
+  }
+  LoadState state;
+  string line;
+  while (getline(strm, line))
+    this->parse_line(line.data(), line.data() + line.size(), dataset, state);
+  this->finish(dataset, state);
+}
+
+/**
+ * \brief load the dataset from the given ARFF file, adding its attributes
+ *        and rows to the dataset, which must not have any rows yet.
+ */
+void
+ArffLoader::load(const string &filename, Dataset &dataset,
+                 const bool VERBOSE) const {
+  struct stat st;
+  if (this->memory_mapped && (stat(filename.c_str(), &st) == 0) &&
+      S_ISREG(st.st_mode))
+    this->load_mapped(filename, dataset);
+  else
+    this->load_stream(filename, dataset);
+
+  if (VERBOSE) {
+    cerr << "loaded dataset from " << filename << endl;
+    cerr << "found " << dataset.num_attributes() << " attributes: ";
+    for (Dataset::const_attribute_iterator it = dataset.begin_attributes();
+         it != dataset.end_attributes(); ++it) {
+      if (it != dataset.begin_attributes()) cerr << ", ";
+      cerr << (*it)->get_name() << " ("
+           << (*it)->get_attribute_type_string() << ")";
+    }
+    cerr << endl;
+  }
+}
+
+/**
+ * \brief check whether the named file is to be loaded as ARFF; that is,
+ *        whether it has an .arff extension, in any case. Nothing is read
+ *        from the file.
+ */
+bool
+ArffLoader::is_arff(const string &filename) {
+  const string ext(".arff");
+  if (filename.size() < ext.size()) return false;
+  return is_keyword(filename.data() + filename.size() - ext.size(),
+                    filename.data() + filename.size(), ext.c_str());
+}
@@ -16,3 +16,65 @@
  * along with this library; if not, write to the Free Software Foundation,
  * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
+
+#ifndef ARFF_LOADER_HPP_
+#define ARFF_LOADER_HPP_
+
+#include "Dataset.hpp"
+
+#include <string>
+
+/**
+ * \brief Loads datasets from Weka ARFF files. Attribute names and types come
+ *        from the @attribute declarations in the header, so there is no
+ *        type inference: numeric, real and integer attributes are numeric;
+ *        attributes declared with a list of values are nominal, with their
+ *        values coded in the order declared; string and date attributes are
+ *        nominal, with the empty string as their first value and the rest
+ *        coded in order of first appearance.
+ *
+ *        Rows after @data can be dense (one value per attribute) or sparse
+ *        ({index value, ...}, with omitted values being 0, the first
+ *        declared value of a nominal attribute, or the empty string for a
+ *        string or date attribute), and the two can be mixed.
+ *        Values are written straight into the dataset's columns, so sparse
+ *        rows stay sparse: each row costs time proportional to the values
+ *        it gives, and numeric columns that are mostly zeros are stored
+ *        sparsely as usual.
+ *
+ *        As for CSVLoader, regular files are memory-mapped and parsed in
+ *        place, and other files are read a line at a time. Missing values
+ *        (?) and instance weights are not supported.
+ */
+class ArffLoader {
+public:
+  ArffLoader() : memory_mapped(true) {};
+  explicit ArffLoader(const bool memory_mapped) :
+    memory_mapped(memory_mapped) {};
+
+  void load(const std::string &filename, Dataset &dataset,
+            const bool VERBOSE=false) const;
+  static bool is_arff(const std::string &filename);
+private:
+  // types
+  struct LoadState;
+
+  bool memory_mapped;
+
+  void load_mapped(const std::string &filename, Dataset &dataset) const;
+  void load_stream(const std::string &filename, Dataset &dataset) const;
+  void parse_line(const char *begin, const char *end, Dataset &dataset,
+                  LoadState &state) const;
+  void parse_attribute(const char *pos, const char *end, Dataset &dataset,
+                       LoadState &state) const;
+  void start_data(Dataset &dataset, LoadState &state) const;
+  void parse_dense_row(const char *pos, const char *end, Dataset &dataset,
+                       LoadState &state) const;
+  void parse_sparse_row(const char *pos, const char *end, Dataset &dataset,
+                        LoadState &state) const;
+  void add_value(const size_t k, const char *begin, const char *end,
+                 const bool quoted, Dataset &dataset, LoadState &state) const;
+  void finish(Dataset &dataset, LoadState &state) const;
+};
+
+#endif
@@ -0,0 +1,112 @@
+/* The following applies to this software package and all subparts therein
+ *
+ * Cognosco Copyright (C) 2015 Philip J. Uren
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or (at
+ * your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+// stl includes
+#include <string>
+#include <fstream>
+#include <future>
+#include <utility>
+
+// local Cognosco includes
+#include "CSVBatchReader.hpp"
+#include "CSVLoader.hpp"
+#include "Dataset.hpp"
+#include "CognoscoError.hpp"
+
+// bring these into the local namespace
+using std::string;
+
+/*****************************************************************************
+ *                       CONSTRUCTORS AND DESTRUCTORS                        *
+ *****************************************************************************/
+
+/**
+ * \brief open the file and read its header; reading the first batch starts
+ *        straight away.
+ */
+CSVBatchReader::CSVBatchReader(const CSVLoader &loader, const string &filename,
+                               const Dataset &schema, const size_t batch_size) :
+  loader(loader), filename(filename), strm(filename.c_str()),
+  batch_size(batch_size) {
+  if (!this->strm.good())
+    throw CognoscoError("failed to open file: " + filename);
+  if (batch_size == 0)
+    throw CognoscoError("cannot read batches of zero rows from " + filename);
+
+  this->keep = this->loader.read_header(this->strm, this->header);
+  for (size_t k = 0; k < this->header.num_attributes(); ++k) {
+    const string &name =
+      this->header.get_attribute_description_ptr(k)->get_name();
+    if (schema.has_attribute(name)) {
+      this->header.set_attribute_type(k,
+        schema.get_attribute_type(schema.get_attribute_index(name)));
+    }
+  }
+  const NumericStorage storage = schema.get_numeric_storage();
+  this->header.set_numeric_storage((storage == DOUBLE_STORAGE) ?
+                                   DOUBLE_STORAGE : FLOAT_STORAGE);
+  this->pending = std::async(std::launch::async,
+                             &CSVBatchReader::read_batch, this);
+}
+
+
+/*****************************************************************************
+ *                                MUTATORS                                   *
+ *****************************************************************************/
+
+/**
+ * \brief get the next batch of rows, and start reading the one after.
+ *        Errors from reading the batch are thrown from here.
+ * \return false, leaving batch empty, once the file is exhausted.
+ */
+bool
+CSVBatchReader::next(Dataset &batch) {
+  if (!this->pending.valid()) {
+    batch = Dataset();
+    return false;
+  }
+  this->pending.get();
+  batch = std::move(this->next_batch);
+  this->next_batch = Dataset();
+  if (batch.size() == 0) return false;
+  this->pending = std::async(std::launch::async,
+                             &CSVBatchReader::read_batch, this);
+  return true;
+}
+
+/**
+ * \brief read the next batch into next_batch. Runs on a background thread,
+ *        which is the only thing touching the stream, header and next_batch
+ *        until it's done. Types inferred for the first batch are kept in
+ *        the header so every later batch uses them too.
+ */
+void
+CSVBatchReader::read_batch() {
+  Dataset batch;
+  batch.set_numeric_storage(this->header.get_numeric_storage());
+  for (auto it = this->header.begin_attributes();
+       it != this->header.end_attributes(); ++it)
+    batch.add_attribute(**it);
+  this->loader.load_rows(this->strm, batch, this->batch_size, this->keep);
+  for (size_t k = 0; k < batch.num_attributes(); ++k) {
+    if (this->header.get_attribute_type(k) == NULL_ATTRIBUTE_TYPE)
+      this->header.set_attribute_type(k, batch.get_attribute_type(k));
+  }
+  this->next_batch = std::move(batch);
+}
@@ -0,0 +1,77 @@
+/* The following applies to this software package and all subparts therein
+ *
+ * Cognosco Copyright (C) 2015 Philip J. Uren
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or (at
+ * your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef CSV_BATCH_READER_HPP_
+#define CSV_BATCH_READER_HPP_
+
+// stl includes
+#include <string>
+#include <fstream>
+#include <future>
+#include <vector>
+
+// local Cognosco includes
+#include "CSVLoader.hpp"
+#include "Dataset.hpp"
+
+/**
+ * \brief Reads a delimited text file as a sequence of datasets of at most
+ *        batch_size rows each, so a file can be processed in memory
+ *        proportional to the batch size rather than the file. Every batch
+ *        has the attributes named in the file's header, less any columns
+ *        the loader doesn't select. Attributes that are also in the given
+ *        schema (normally the training set) take their types from it; any
+ *        others are inferred from the first batch and then kept for the
+ *        rest. Numeric values are held at the
+ *        schema's precision, except that quantized storage is read at
+ *        single precision, since each batch would otherwise be quantized
+ *        over its own range.
+ *
+ *        The next batch is parsed on a background thread while the current
+ *        one is being used, so reading overlaps with whatever the caller
+ *        does with each batch. At most two batches are held at a time.
+ */
+class CSVBatchReader {
+public:
+  // constructors and destructors
+  CSVBatchReader(const CSVLoader &loader, const std::string &filename,
+                 const Dataset &schema, const size_t batch_size);
+  CSVBatchReader(const CSVBatchReader &) = delete;
+  CSVBatchReader& operator=(const CSVBatchReader &) = delete;
+
+  // mutators
+  bool next(Dataset &batch);
+
+private:
+  // private instance variables; pending is declared last so that any
+  // batch still being read finishes before the rest is destroyed.
+  CSVLoader loader;
+  std::string filename;
+  std::ifstream strm;
+  size_t batch_size;
+  std::vector<bool> keep;
+  Dataset header;
+  Dataset next_batch;
+  std::future<void> pending;
+
+  // private mutators
+  void read_batch();
+};
+
+#endif
@@ -23,11 +23,23 @@
 #include <fstream>
 #include <iostream>
 #include <sstream>
+#include <cstring>
+#include <cstdlib>
+#include <cctype>
+#include <algorithm>
+#include <memory>
+#include <thread>
+#include <exception>
+#include <limits>
+
+// system includes
+#include <sys/stat.h>
 
 // local Cognosco includes
 #include "CSVLoader.hpp"
-#include "Dataset.hpp"
 #include "StringUtils.hpp"
+#include "MappedFile.hpp"
+#include "Dataset.hpp"
 #include "CognoscoError.hpp"
 
 // bring these into local namespace
@@ -37,73 +49,474 @@ using std::string;
 using std::vector;
 using std::ifstream;
 
+/**
+ * \brief the state carried from one line to the next while loading: which
+ *        fields (by position) the header said to load, and the buffers
+ *        re-used for each row. Nominal labels are copied into a buffer per
+ *        attribute; once those have grown to fit the longest label, they
+ *        don't allocate again.
+ */
+struct CSVLoader::LoadState {
+  LoadState() : first(true) {}
+  LoadState(const vector<bool> &keep, const size_t num_atts) :
+    first(false), keep(keep), labels(num_atts) {}
+  bool first;
+  vector<bool> keep;
+  vector<AttributeOccurrence> values;
+  vector<string> labels;
+};
+
+/*****************************************************************************
+ *                            COLUMN SELECTION                               *
+ *****************************************************************************/
+
+/**
+ * \brief load only the columns with the given header names or positions
+ *        (counted from 0); every one of them must be in the file.
+ */
 void
-CSVLoader::load(const std::string &filename, Dataset &dataset,
-                const bool VERBOSE) const {
-  ifstream strm(filename.c_str());
+CSVLoader::include_columns(const std::set<string> &names,
+                           const std::set<size_t> &indexes) {
+  this->include_only = true;
+  this->column_names = names;
+  this->column_indexes = indexes;
+}
+
+/**
+ * \brief load every column except those with the given header names or
+ *        positions (counted from 0); ones not in the file are ignored.
+ */
+void
+CSVLoader::exclude_columns(const std::set<string> &names,
+                           const std::set<size_t> &indexes) {
+  this->include_only = false;
+  this->column_names = names;
+  this->column_indexes = indexes;
+}
+
+/**
+ * \brief check whether the column with the given header name, at the given
+ *        position, is to be loaded.
+ */
+bool
+CSVLoader::selects(const string &name, const size_t index) const {
+  const bool listed =
+    (this->column_names.find(name) != this->column_names.end()) ||
+    (this->column_indexes.find(index) != this->column_indexes.end());
+  return listed == this->include_only;
+}
+
+/**
+ * \brief check that every column asked for by include_columns was found in
+ *        a header with the given number of fields, giving the dataset read
+ *        from it.
+ */
+void
+CSVLoader::check_included(const Dataset &dataset,
+                          const size_t num_fields) const {
+  if (!this->include_only) return;
+  for (auto &name : this->column_names) {
+    if (!dataset.has_attribute(name))
+      throw CognoscoError("cannot load column " + name + "; no such column");
+  }
+  for (auto index : this->column_indexes) {
+    if (index >= num_fields) {
+      std::stringstream ss;
+      ss << "cannot load column " << index << "; file has only "
+         << num_fields << " columns";
+      throw CognoscoError(ss.str());
+    }
+  }
+}
+
+/*****************************************************************************
+ *                               PARSING                                     *
+ *****************************************************************************/
+
+/**
+ * \brief narrow [begin, end) to exclude leading and trailing whitespace.
+ */
+static void
+strip(const char *&begin, const char *&end) {
+  while ((begin != end) && std::isspace(static_cast<unsigned char>(*begin)))
+    ++begin;
+  while ((end != begin) &&
+         std::isspace(static_cast<unsigned char>(*(end - 1))))
+    --end;
+}
 
+/**
+ * \brief find the end of the line starting at begin; either the next
+ *        newline, or end.
+ */
+static const char*
+line_end(const char *begin, const char *end) {
+  const char *eol = static_cast<const char*>(memchr(begin, '\n', end - begin));
+  return (eol == NULL) ? end : eol;
+}
+
+/**
+ * \brief find the next non-empty field of a line, starting from pos and
+ *        ending at end, and move pos past it and its separator.
+ * \return false if there are no more fields.
+ */
+bool
+CSVLoader::next_field(const char *&pos, const char *end,
+                      const char *&field_begin, const char *&field_end) const {
+  const size_t sep_len = this->seperator.size();
+  while (pos < end) {
+    if (sep_len == 1) {
+      field_end = static_cast<const char*>(
+        memchr(pos, this->seperator[0], end - pos));
+      if (field_end == NULL) field_end = end;
+    } else {
+      field_end = pos;
+      while ((field_end != end) &&
+             ((*field_end != this->seperator[0]) ||
+              (size_t(end - field_end) < sep_len) ||
+              (memcmp(field_end, this->seperator.data(), sep_len) != 0)))
+        ++field_end;
+    }
+    field_begin = pos;
+    pos = (field_end == end) ? end : field_end + sep_len;
+    if (field_begin != field_end) return true;
+  }
+  return false;
+}
+
+/**
+ * \brief fix the type of each attribute whose type isn't yet known, from a
+ *        sample of up to TYPE_SAMPLE_ROWS rows starting at begin: numeric if
+ *        every sampled value parses as a number, nominal otherwise. Doing
+ *        this before the bulk parse means a numeric-looking first value
+ *        doesn't make a column numeric when later values are labels.
+ *        Attributes with no values in the sample are typed by the first
+ *        value parsed. Only fields the header said to load are looked at.
+ */
+void
+CSVLoader::infer_types(const char *begin, const char *end, Dataset &dataset,
+                       const vector<bool> &keep) const {
+  const size_t n = dataset.num_attributes();
+  vector<bool> seen(n, false), numeric(n, true);
+  size_t rows = 0;
+  while ((begin < end) && (rows < TYPE_SAMPLE_ROWS)) {
+    const char *eol = line_end(begin, end);
+    const char *pos = begin, *field_begin, *field_end;
+    begin = eol + 1;
+    strip(pos, eol);
+    if (pos == eol) continue;
+
+    rows += 1;
+    double val;
+    size_t i = 0;
+    for (size_t f = 0;
+         (i < n) && this->next_field(pos, eol, field_begin, field_end); ++f) {
+      if ((f < keep.size()) && !keep[f]) continue;
+      seen[i] = true;
+      if (numeric[i] && !parse_double(field_begin, field_end, val))
+        numeric[i] = false;
+      i += 1;
+    }
+  }
+  for (size_t k = 0; k < n; ++k) {
+    if (seen[k] && (dataset.get_attribute_type(k) == NULL_ATTRIBUTE_TYPE))
+      dataset.set_attribute_type(k, numeric[k] ? NUMERIC : NOMINAL);
+  }
+}
+
+/**
+ * \brief parse one line of the file, given as [begin, end); the first
+ *        non-empty line is the header. Empty fields are skipped, and so are
+ *        fields in columns that aren't selected; those are only scanned
+ *        for the separator, never parsed or stored. Attribute
+ *        types are only set on the dataset while they're unknown, so once
+ *        types are inferred and the first row is loaded, lines can be
+ *        parsed from several threads at once.
+ * \return true if the line was a row of data, in which case its values are
+ *         in state.values.
+ */
+bool
+CSVLoader::parse_line(const char *begin, const char *end, Dataset &dataset,
+                      LoadState &state) const {
+  strip(begin, end);
+  if (begin == end) return false;
+
+  state.values.clear();
+  const char *field_begin, *field_end;
+  size_t i = 0, f = 0;
+  while (this->next_field(begin, end, field_begin, field_end)) {
+    if (state.first) {
+      // if this is the first line, use it to create attributes
+      strip(field_begin, field_end);
+      const string name(field_begin, field_end);
+      state.keep.push_back(this->selects(name, f++));
+      if (state.keep.back()) {
+        dataset.add_attribute(Attribute(name, NULL_ATTRIBUTE_TYPE));
+        state.labels.push_back(string());
+      }
+      continue;
+    }
+    // fields past the end of the header are kept, so the row is rejected
+    if ((f < state.keep.size()) && !state.keep[f++]) continue;
+
+    // if it's not the first line, then use it to create instances
+    const Attribute* ad_ptr = dataset.get_attribute_description_ptr(i);
+    const AttributeType att_type (dataset.get_attribute_type(i));
+    double d_val;
+    if ((att_type == NULL_ATTRIBUTE_TYPE) || (att_type == NUMERIC)) {
+      if (parse_double(field_begin, field_end, d_val)) {
+        state.values.push_back(AttributeOccurrence(ad_ptr, d_val));
+        if (att_type == NULL_ATTRIBUTE_TYPE)
+          dataset.set_attribute_type(i, NUMERIC);
+        i += 1;
+        continue;
+      }
+      if (att_type == NUMERIC) {
+        std::stringstream ss;
+        ss << "failed to parse " << string(field_begin, field_end)
+           << " as numeric";
+        throw CognoscoError(ss.str());
+      }
+      // if we fail to parse as a number, treat as nominal
+      dataset.set_attribute_type(i, NOMINAL);
+    } else if (att_type != NOMINAL) {
+      std::stringstream ss;
+      ss << "failed to parse " << string(field_begin, field_end)
+         << "; unknown attribute type";
+      throw CognoscoError(ss.str());
+    }
+    strip(field_begin, field_end);
+    state.labels[i].assign(field_begin, field_end);
+    state.values.push_back(AttributeOccurrence(ad_ptr, &(state.labels[i])));
+    i += 1;
+  }
+
+  if (!state.first) return true;
+  this->check_included(dataset, state.keep.size());
+  state.first = false;
+  return false;
+}
+
+/**
+ * \brief add a row of values to a set of columns, one per attribute.
+ */
+static void
+add_row(vector<Column> &cols, const vector<AttributeOccurrence> &values) {
+  if (values.size() != cols.size()) {
+    std::stringstream ss;
+    ss << "cannot add instance with " << values.size() << " attributes to "
+       << "dataset with " << cols.size() << " attributes";
+    throw CognoscoError(ss.str());
+  }
+  for (size_t k = 0; k < values.size(); ++k) {
+    if (values[k].is_numeric()) cols[k].push_back(values[k] * 1.0);
+    else cols[k].push_back(values[k].get_label());
+  }
+}
+
+/**
+ * \brief parse the rows in [begin, end), which must start at the beginning
+ *        of a line, into a new set of columns with the same types as the
+ *        dataset's. The columns share a string table of their own, and keep
+ *        numeric values at full precision unless the dataset doesn't.
+ */
+void
+CSVLoader::parse_chunk(const char *begin, const char *end, Dataset &dataset,
+                       const vector<bool> &keep,
+                       vector<Column> &cols) const {
+  std::shared_ptr<StringTable> strings(new StringTable());
+  const NumericStorage storage = (dataset.get_numeric_storage() ==
+                                  DOUBLE_STORAGE) ? DOUBLE_STORAGE :
+                                                    FLOAT_STORAGE;
+  for (size_t k = 0; k < dataset.num_attributes(); ++k) {
+    cols.push_back(Column(dataset.get_attribute_type(k), strings));
+    cols.back().set_storage(storage);
+  }
+
+  LoadState state(keep, dataset.num_attributes());
+  while (begin < end) {
+    const char *eol = line_end(begin, end);
+    if (this->parse_line(begin, eol, dataset, state))
+      add_row(cols, state.values);
+    begin = eol + 1;
+  }
+}
+
+
+/*****************************************************************************
+ *                               LOADING                                     *
+ *****************************************************************************/
+
+/**
+ * \brief load the dataset by memory-mapping the file and parsing each line
+ *        in place.
+ */
+void
+CSVLoader::load_mapped(const string &filename, Dataset &dataset) const {
+  MappedFile file(filename);
+  file.advise_sequential();
+  LoadState state;
+  const char *begin = file.data();
+  const char *end = begin + file.size();
+
+  // the header and first row fix the attributes and their types, so they
+  // are always loaded here; after that, the rest can be split into chunks.
+  // Types are inferred from a sample of rows once the header is read.
+  const size_t rows_before = dataset.size();
+  bool types_inferred = false;
+  while ((begin < end) &&
+         ((this->num_threads <= 1) || (dataset.size() == rows_before))) {
+    const char *eol = line_end(begin, end);
+    if (this->parse_line(begin, eol, dataset, state))
+      dataset.add_instance(state.values);
+    begin = eol + 1;
+    if (!state.first && !types_inferred) {
+      this->infer_types(begin, end, dataset, state.keep);
+      types_inferred = true;
+    }
+  }
+  if (begin < end) this->load_chunks(begin, end, dataset, state.keep);
+}
+
+/**
+ * \brief load the rows in [begin, end) on num_threads threads, each parsing
+ *        a line-aligned chunk of about the same size into its own columns.
+ *        The chunks are then appended to the dataset in order. If any chunk
+ *        fails, the error from the earliest is the one reported, which is
+ *        the one a serial load would have hit first.
+ */
+void
+CSVLoader::load_chunks(const char *begin, const char *end, Dataset &dataset,
+                       const vector<bool> &keep) const {
+  vector<const char*> bounds(1, begin);
+  for (size_t t = 1; t < this->num_threads; ++t) {
+    const char *split = std::max(bounds.back(),
+                                 begin + (end - begin) * t / this->num_threads);
+    const char *eol = line_end(split, end);
+    bounds.push_back((eol == end) ? end : eol + 1);
+  }
+  bounds.push_back(end);
+
+  vector<vector<Column> > chunks(this->num_threads);
+  vector<std::exception_ptr> errors(this->num_threads);
+  vector<std::thread> workers;
+  for (size_t t = 0; t < this->num_threads; ++t) {
+    workers.push_back(std::thread([&, t]() {
+      try {
+        this->parse_chunk(bounds[t], bounds[t + 1], dataset, keep,
+                          chunks[t]);
+      } catch (...) {
+        errors[t] = std::current_exception();
+      }
+    }));
+  }
+  for (auto &worker : workers) worker.join();
+  for (auto &error : errors)
+    if (error) std::rethrow_exception(error);
+
+  size_t total_rows = dataset.size();
+  for (auto &chunk : chunks)
+    if (!chunk.empty()) total_rows += chunk.front().size();
+  dataset.reserve(total_rows);
+  for (auto &chunk : chunks) {
+    dataset.append_columns(chunk);
+    vector<Column>().swap(chunk);
+  }
+}
+
+/**
+ * \brief load the dataset by reading the file a line at a time.
+ */
+void
+CSVLoader::load_stream(const string &filename, Dataset &dataset) const {
+  ifstream strm(filename.c_str());
   if (!strm.good()) {
     std::stringstream ss;
     ss << "failed to open file: " << filename;
     throw CognoscoError(ss.str());
   }
 
+  const vector<bool> keep(this->read_header(strm, dataset));
+  this->load_rows(strm, dataset, std::numeric_limits<size_t>::max(), keep);
+}
+
+/**
+ * \brief read lines from the stream up to and including the header (the
+ *        first non-empty line), and add the attributes it names to the
+ *        dataset.
+ * \return which fields of each line, by position, are to be loaded; this
+ *         must be given to load_rows.
+ */
+vector<bool>
+CSVLoader::read_header(std::istream &strm, Dataset &dataset) const {
+  LoadState state;
   string line;
-  bool first = true;
-  while (strm.good()) {
-    getline(strm, line);
-    line = strip(line);
-    if (line.empty()) continue;
-
-    vector<string> parts;
-    tokenize(line, parts, seperator);
-
-    if (first) {
-      // if this is the first line and we're expecting a header, use it to
-      // create attributes
-      for (size_t i = 0; i < parts.size(); ++i) {
-        // TODO remove assumption that everything is numeric...
-        dataset.add_attribute(Attribute(strip(parts[i]), NULL_ATTRIBUTE_TYPE));
-      }
-      first = false;
-    } else {
-      // if it's not the first line, then use it to create instances
-      Instance instance;
-      for (size_t i = 0; i < parts.size(); ++i) {
-        const Attribute* ad_ptr =\
-          dataset.get_attribute_description_ptr(i);
-        const AttributeType att_type (dataset.get_attribute_type(i));
-        if (att_type == NULL_ATTRIBUTE_TYPE) {
-          try {
-            // try to treat as a floating point number
-            double d_val (std::stof(parts[i]));
-            instance.add_attribute_occurrence(d_val, ad_ptr);
-            dataset.set_attribute_type(i, NUMERIC);
-          } catch (const std::invalid_argument &e) {
-            // if we fail to parse as a float, treat as nominal
-            instance.add_attribute_occurrence(strip(parts[i]), ad_ptr);
-            dataset.set_attribute_type(i, NOMINAL);
-          }
-        } else if (att_type == NOMINAL) {
-          instance.add_attribute_occurrence(strip(parts[i]), ad_ptr);
-        } else if (att_type == NUMERIC) {
-          try {
-            double d_val (std::stof(parts[i]));
-            instance.add_attribute_occurrence(d_val, ad_ptr);
-          } catch (const std::invalid_argument &e) {
-            std::stringstream ss;
-            ss << "failed to parse " << parts[i] << " as numeric";
-            throw CognoscoError(ss.str());
-          }
-        } else {
-          std::stringstream ss;
-          ss << "failed to parse " << parts[i] << "; unknown attribute type";
-          throw CognoscoError(ss.str());
-        }
+  while (state.first && getline(strm, line))
+    this->parse_line(line.data(), line.data() + line.size(), dataset, state);
+  return state.keep;
+}
+
+/**
+ * \brief add up to max_rows rows read from the stream to the dataset, which
+ *        must have the attributes named in the stream's header; keep is the
+ *        selection of fields read_header returned for it. If any
+ *        attribute types aren't known yet, a sample of rows is buffered
+ *        and types inferred from it before they're parsed.
+ * \return the number of rows added; fewer than max_rows only once the
+ *         stream is exhausted.
+ */
+size_t
+CSVLoader::load_rows(std::istream &strm, Dataset &dataset,
+                     const size_t max_rows, const vector<bool> &keep) const {
+  LoadState state(keep, dataset.num_attributes());
+  string line, sample;
+  size_t rows = 0;
+
+  bool types_known = true;
+  for (size_t k = 0; k < dataset.num_attributes(); ++k) {
+    if (dataset.get_attribute_type(k) == NULL_ATTRIBUTE_TYPE)
+      types_known = false;
+  }
+  if (!types_known) {
+    const size_t sample_rows =
+      (max_rows < TYPE_SAMPLE_ROWS) ? max_rows : TYPE_SAMPLE_ROWS;
+    for (size_t r = 0; (r < sample_rows) && getline(strm, line); ++r) {
+      sample += line;
+      sample += '\n';
+    }
+    this->infer_types(sample.data(), sample.data() + sample.size(), dataset,
+                      keep);
+    const char *begin = sample.data();
+    const char *end = begin + sample.size();
+    while (begin < end) {
+      const char *eol = line_end(begin, end);
+      if (this->parse_line(begin, eol, dataset, state)) {
+        dataset.add_instance(state.values);
+        rows += 1;
       }
-      dataset.add_instance(instance);
+      begin = eol + 1;
+    }
+  }
+
+  while ((rows < max_rows) && getline(strm, line)) {
+    if (this->parse_line(line.data(), line.data() + line.size(), dataset,
+                         state)) {
+      dataset.add_instance(state.values);
+      rows += 1;
     }
   }
+  return rows;
+}
+
+void
+CSVLoader::load(const std::string &filename, Dataset &dataset,
+                const bool VERBOSE) const {
+  struct stat st;
+  if (this->memory_mapped && (stat(filename.c_str(), &st) == 0) &&
+      S_ISREG(st.st_mode))
+    this->load_mapped(filename, dataset);
+  else
+    this->load_stream(filename, dataset);
 
   if (VERBOSE) {
     cerr << "loaded dataset from " << filename << endl;
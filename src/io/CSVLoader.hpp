@@ -24,18 +24,95 @@
 
 #include <string>
 #include <vector>
+#include <istream>
+#include <set>
 #include <unordered_map>
 
+/**
+ * \brief Loads datasets from delimited text files whose first line is a
+ *        header naming the attributes. Attribute types are inferred from
+ *        a sample of the first rows before the rest are parsed: attributes
+ *        whose sampled values all parse as numbers are numeric, and the
+ *        rest are nominal. Numbers are parsed without exceptions, by a
+ *        fast path for plain decimals that falls back to strtod.
+ *
+ *        By default, regular files are memory-mapped and each line is
+ *        parsed in place; fields are slices of the mapping that are
+ *        written straight into the dataset's columns, so loading does no
+ *        per-line or per-field allocation. Other files (pipes, for example),
+ *        or any file when memory mapping is turned off, are read a line at
+ *        a time into a re-used buffer and then parsed the same way.
+ *
+ *        Memory-mapped files can be loaded by several threads. The header,
+ *        type inference and first row are done first, which fixes the
+ *        attributes and their types; the rest of the file is then split
+ *        into line-aligned chunks that are parsed in parallel into separate
+ *        columns, and those are appended to the dataset in file order. Rows,
+ *        instance ids and any error reported are the same as for a serial
+ *        load, but the parsed values are briefly held twice.
+ *
+ *        Streams can also be read incrementally: read_header adds the
+ *        attributes named by the header to a dataset, and load_rows then
+ *        adds rows a bounded number at a time.
+ *
+ *        A loader can be restricted to a subset of a file's columns, given
+ *        by header name or by position. Fields in other columns are skipped
+ *        over without being parsed or stored, and the dataset only has
+ *        attributes for the selected columns.
+ */
 class CSVLoader {
 public:
-  CSVLoader() : seperator(",") {};
-  CSVLoader(const std::string &sep) : seperator(sep) {};
+  CSVLoader() : seperator(","), memory_mapped(true), num_threads(1),
+                include_only(false) {};
+  CSVLoader(const std::string &sep, const bool memory_mapped=true,
+            const size_t num_threads=1) :
+    seperator(sep), memory_mapped(memory_mapped), num_threads(num_threads),
+    include_only(false) {};
+
+  void include_columns(const std::set<std::string> &names,
+                       const std::set<size_t> &indexes=std::set<size_t>());
+  void exclude_columns(const std::set<std::string> &names,
+                       const std::set<size_t> &indexes=std::set<size_t>());
 
   void load(const std::string &filename, Dataset &dataset,
             const bool VERBOSE=false) const;
+  std::vector<bool> read_header(std::istream &strm, Dataset &dataset) const;
+  size_t load_rows(std::istream &strm, Dataset &dataset,
+                   const size_t max_rows, const std::vector<bool> &keep) const;
 private:
+  // types
+  struct LoadState;
+
+  // private constants -- the number of rows sampled to infer types from
+  static const size_t TYPE_SAMPLE_ROWS = 1000;
+
   bool expect_header;
   std::string seperator;
+  bool memory_mapped;
+  size_t num_threads;
+
+  // the columns to load; those listed if include_only, otherwise those
+  // not listed
+  bool include_only;
+  std::set<std::string> column_names;
+  std::set<size_t> column_indexes;
+
+  bool selects(const std::string &name, const size_t index) const;
+  void check_included(const Dataset &dataset, const size_t num_fields) const;
+
+  void load_mapped(const std::string &filename, Dataset &dataset) const;
+  void load_stream(const std::string &filename, Dataset &dataset) const;
+  void load_chunks(const char *begin, const char *end, Dataset &dataset,
+                   const std::vector<bool> &keep) const;
+  void parse_chunk(const char *begin, const char *end, Dataset &dataset,
+                   const std::vector<bool> &keep,
+                   std::vector<Column> &cols) const;
+  bool parse_line(const char *begin, const char *end, Dataset &dataset,
+                  LoadState &state) const;
+  bool next_field(const char *&pos, const char *end,
+                  const char *&field_begin, const char *&field_end) const;
+  void infer_types(const char *begin, const char *end, Dataset &dataset,
+                   const std::vector<bool> &keep) const;
 };
 
 #endif
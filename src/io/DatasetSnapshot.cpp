@@ -0,0 +1,449 @@
+/* The following applies to this software package and all subparts therein
+ *
+ * Cognosco Copyright (C) 2015 Philip J. Uren
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or (at
+ * your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+// stl includes
+#include <string>
+#include <vector>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <memory>
+#include <cstring>
+#include <cstdint>
+#include <cstdio>
+
+// system includes
+#include <sys/stat.h>
+
+// local Cognosco includes
+#include "DatasetSnapshot.hpp"
+#include "MappedFile.hpp"
+#include "Dataset.hpp"
+#include "Column.hpp"
+#include "MappableVector.hpp"
+#include "CognoscoError.hpp"
+
+// bring these into the local namespace
+using std::cerr;
+using std::endl;
+using std::string;
+using std::vector;
+using std::shared_ptr;
+
+/*****************************************************************************
+ *                              FILE LAYOUT                                  *
+ *****************************************************************************/
+
+static const char SNAPSHOT_MAGIC[8] = {'C', 'O', 'G', 'S', 'N', 'A', 'P', '\0'};
+static const uint32_t SNAPSHOT_VERSION = 1;
+static const uint32_t SNAPSHOT_BYTE_ORDER = 0x01020304;
+static const size_t SNAPSHOT_ALIGNMENT = 8;
+
+struct SnapshotHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t byte_order;
+  uint64_t num_rows;
+  uint64_t num_attributes;
+  uint32_t numeric_storage;
+  uint32_t reserved;
+};
+
+/**
+ * \brief the number of bytes each value takes at the given storage.
+ */
+static size_t
+value_size(const NumericStorage &storage) {
+  switch (storage) {
+    case DOUBLE_STORAGE: return sizeof(double);
+    case FLOAT_STORAGE: return sizeof(float);
+    case QUANTIZED_16_STORAGE: return sizeof(uint16_t);
+    default: return sizeof(uint8_t);
+  }
+}
+
+static const void*
+buffer_data(const NumericBuffer &buf) {
+  switch (buf.get_storage()) {
+    case DOUBLE_STORAGE: return buf.double_data();
+    case FLOAT_STORAGE: return buf.float_data();
+    case QUANTIZED_16_STORAGE: return buf.q16_data();
+    default: return buf.q8_data();
+  }
+}
+
+static NumericStorage
+to_numeric_storage(const uint32_t s, const string &filename) {
+  if (s > QUANTIZED_8_STORAGE) {
+    std::stringstream ss;
+    ss << "corrupt dataset snapshot " << filename << "; unknown numeric "
+       << "storage " << s;
+    throw CognoscoError(ss.str());
+  }
+  return static_cast<NumericStorage>(s);
+}
+
+/**
+ * \brief read and check the header of a snapshot.
+ * \return false if the file isn't a snapshot at all.
+ */
+static bool
+read_header(std::istream &in, SnapshotHeader &header) {
+  in.read(reinterpret_cast<char*>(&header), sizeof(header));
+  return in.good() &&
+    (memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) == 0);
+}
+
+static void
+check_header(const SnapshotHeader &header, const string &filename) {
+  if (header.byte_order != SNAPSHOT_BYTE_ORDER) {
+    throw CognoscoError("cannot load dataset snapshot " + filename + "; it "
+                        "was written on a machine with a different byte order");
+  }
+  if (header.version != SNAPSHOT_VERSION) {
+    std::stringstream ss;
+    ss << "cannot load dataset snapshot " << filename << "; unsupported "
+       << "version " << header.version;
+    throw CognoscoError(ss.str());
+  }
+  to_numeric_storage(header.numeric_storage, filename);
+}
+
+
+/*****************************************************************************
+ *                                 WRITING                                   *
+ *****************************************************************************/
+
+/**
+ * \brief writes the pieces of a snapshot, padding each one so the next
+ *        starts on an aligned offset.
+ */
+class SnapshotOutput {
+public:
+  SnapshotOutput(std::ostream &out) : out(out), pos(0) {}
+  template <typename T> void write(const T &val) {
+    this->write_bytes(&val, sizeof(T));
+  }
+  void write_bytes(const void *data, const size_t n) {
+    this->out.write(static_cast<const char*>(data), n);
+    this->pos += n;
+    const char zeros[SNAPSHOT_ALIGNMENT] = {0};
+    const size_t pad = (SNAPSHOT_ALIGNMENT - this->pos % SNAPSHOT_ALIGNMENT) %
+                       SNAPSHOT_ALIGNMENT;
+    this->out.write(zeros, pad);
+    this->pos += pad;
+  }
+  void write_string(const string &s) {
+    this->write(static_cast<uint64_t>(s.size()));
+    this->write_bytes(s.data(), s.size());
+  }
+private:
+  std::ostream &out;
+  size_t pos;
+};
+
+/**
+ * \brief write the values of a numeric buffer, preceded by its storage and
+ *        quantization parameters.
+ */
+static void
+write_values(SnapshotOutput &out, const NumericBuffer &buf) {
+  out.write(static_cast<uint32_t>(buf.get_storage()));
+  out.write(static_cast<uint32_t>(0));
+  out.write(buf.get_offset());
+  out.write(buf.get_scale());
+  out.write_bytes(buffer_data(buf), buf.size() * value_size(buf.get_storage()));
+}
+
+/**
+ * \brief write a snapshot of the given dataset. The snapshot is written to
+ *        a temporary file that replaces the named one once it's complete,
+ *        so a snapshot is never seen half-written.
+ */
+void
+SnapshotWriter::write(const Dataset &d, const string &filename) const {
+  const string tmp_fn(filename + ".tmp");
+  std::ofstream strm(tmp_fn.c_str(), std::ios::binary | std::ios::trunc);
+  if (!strm.good())
+    throw CognoscoError("failed to open file for writing: " + tmp_fn);
+
+  SnapshotHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+  header.version = SNAPSHOT_VERSION;
+  header.byte_order = SNAPSHOT_BYTE_ORDER;
+  header.num_rows = d.size();
+  header.num_attributes = d.num_attributes();
+  header.numeric_storage = d.get_numeric_storage();
+
+  SnapshotOutput out(strm);
+  out.write(header);
+  for (size_t k = 0; k < d.num_attributes(); ++k) {
+    const Column &col = d.get_column(k);
+    out.write_string(d.get_attribute_description_ptr(k)->get_name());
+    out.write(static_cast<uint32_t>(col.get_type()));
+    out.write(static_cast<uint32_t>(col.is_sparse()));
+    if (col.get_type() == NOMINAL) {
+      out.write(static_cast<uint64_t>(col.num_labels()));
+      for (uint32_t code = 0; code < col.num_labels(); ++code)
+        out.write_string(col.decode(code));
+      out.write_bytes(col.code_data(), col.size() * sizeof(uint32_t));
+    } else if (col.is_sparse()) {
+      const MappableVector<uint32_t> &rows = col.nonzero_rows();
+      out.write(static_cast<uint64_t>(rows.size()));
+      out.write_bytes(rows.data(), rows.size() * sizeof(uint32_t));
+      write_values(out, col.nonzero_values());
+    } else if (col.get_type() != NULL_ATTRIBUTE_TYPE) {
+      write_values(out, col.numeric_values());
+    }
+  }
+
+  strm.close();
+  if (strm.fail()) {
+    std::remove(tmp_fn.c_str());
+    throw CognoscoError("failed to write dataset snapshot " + filename);
+  }
+  if (std::rename(tmp_fn.c_str(), filename.c_str()) != 0) {
+    std::remove(tmp_fn.c_str());
+    throw CognoscoError("failed to write dataset snapshot " + filename);
+  }
+}
+
+
+/*****************************************************************************
+ *                                 LOADING                                   *
+ *****************************************************************************/
+
+/**
+ * \brief reads the pieces of a snapshot in place from its mapping, checking
+ *        that none of them runs past the end of the file.
+ */
+class SnapshotInput {
+public:
+  SnapshotInput(const MappedFile &file) : file(file), pos(0) {}
+  template <typename T> T read() {
+    T val;
+    memcpy(&val, this->read_bytes(sizeof(T)), sizeof(T));
+    return val;
+  }
+  const char* read_bytes(const size_t n) {
+    if ((n > this->file.size()) || (this->pos > this->file.size() - n)) {
+      throw CognoscoError("corrupt dataset snapshot " +
+                          this->file.get_filename() + "; file is truncated");
+    }
+    const char *res = this->file.data() + this->pos;
+    this->pos += n;
+    this->pos += (SNAPSHOT_ALIGNMENT - this->pos % SNAPSHOT_ALIGNMENT) %
+                 SNAPSHOT_ALIGNMENT;
+    return res;
+  }
+  string read_string() {
+    const uint64_t n = this->read<uint64_t>();
+    return string(this->read_bytes(n), n);
+  }
+  bool at_end() const { return this->pos >= this->file.size(); }
+  size_t remaining() const {
+    return this->at_end() ? 0 : this->file.size() - this->pos;
+  }
+private:
+  const MappedFile &file;
+  size_t pos;
+};
+
+/**
+ * \brief map the values of a numeric buffer, and its storage and
+ *        quantization parameters.
+ */
+static NumericBuffer
+read_values(SnapshotInput &in, const size_t n,
+            const shared_ptr<const MappedFile> &file) {
+  const NumericStorage storage =
+    to_numeric_storage(in.read<uint32_t>(), file->get_filename());
+  in.read<uint32_t>();
+  const double offset = in.read<double>();
+  const double scale = in.read<double>();
+  const size_t bytes = n * value_size(storage);
+  if (bytes / value_size(storage) != n) {
+    throw CognoscoError("corrupt dataset snapshot " + file->get_filename() +
+                        "; file is truncated");
+  }
+  NumericBuffer buf;
+  buf.map(storage, in.read_bytes(bytes), n, offset, scale, file);
+  return buf;
+}
+
+static MappableVector<uint32_t>
+read_codes(SnapshotInput &in, const size_t n,
+           const shared_ptr<const MappedFile> &file) {
+  if (n > file->size() / sizeof(uint32_t)) {
+    throw CognoscoError("corrupt dataset snapshot " + file->get_filename() +
+                        "; file is truncated");
+  }
+  const char *data = in.read_bytes(n * sizeof(uint32_t));
+  return MappableVector<uint32_t>(reinterpret_cast<const uint32_t*>(data),
+                                  n, file);
+}
+
+/**
+ * \brief check that every code of a nominal column names one of its
+ *        num_labels labels; columns don't check this themselves.
+ */
+static void
+check_codes(const MappableVector<uint32_t> &codes, const size_t num_labels,
+            const string &filename, const string &name) {
+  for (size_t i = 0; i < codes.size(); ++i) {
+    if (codes[i] >= num_labels) {
+      std::stringstream ss;
+      ss << "corrupt dataset snapshot " << filename << "; attribute " << name
+         << " has code " << codes[i] << " but only " << num_labels
+         << " values";
+      throw CognoscoError(ss.str());
+    }
+  }
+}
+
+/**
+ * \brief check that the non-zero rows of a sparse column are strictly
+ *        increasing and within its n rows, as lookups into it assume.
+ */
+static void
+check_sparse_rows(const MappableVector<uint32_t> &rows, const size_t n,
+                  const string &filename, const string &name) {
+  for (size_t i = 0; i < rows.size(); ++i) {
+    if ((rows[i] >= n) || ((i > 0) && (rows[i] <= rows[i - 1]))) {
+      std::stringstream ss;
+      ss << "corrupt dataset snapshot " << filename << "; attribute " << name
+         << " has non-zero rows out of order or out of range";
+      throw CognoscoError(ss.str());
+    }
+  }
+}
+
+/**
+ * \brief load a snapshot into the given dataset, which must be empty. The
+ *        dataset's columns refer straight into the mapped file, which stays
+ *        mapped for as long as the dataset (or a copy of it) uses it. The
+ *        nominal codes and sparse rows are checked once here, so a corrupt
+ *        snapshot is rejected rather than indexing out of bounds later.
+ */
+void
+SnapshotLoader::load(const string &filename, Dataset &dataset,
+                     const bool VERBOSE) const {
+  if (dataset.num_attributes() != 0) {
+    throw CognoscoError("cannot load dataset snapshot " + filename +
+                        " into a dataset that isn't empty");
+  }
+
+  shared_ptr<const MappedFile> file(new MappedFile(filename));
+  SnapshotInput in(*file);
+  if (file->size() < sizeof(SnapshotHeader))
+    throw CognoscoError("not a dataset snapshot: " + filename);
+  const SnapshotHeader header(in.read<SnapshotHeader>());
+  if (memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) != 0)
+    throw CognoscoError("not a dataset snapshot: " + filename);
+  check_header(header, filename);
+
+  const size_t n = header.num_rows;
+  vector<Column> cols;
+  for (size_t k = 0; k < header.num_attributes; ++k) {
+    const string name(in.read_string());
+    const uint32_t type = in.read<uint32_t>();
+    const bool sparse = in.read<uint32_t>() != 0;
+    if (type > NULL_ATTRIBUTE_TYPE) {
+      std::stringstream ss;
+      ss << "corrupt dataset snapshot " << filename << "; attribute " << name
+         << " has unknown type " << type;
+      throw CognoscoError(ss.str());
+    }
+    const AttributeType att_type = static_cast<AttributeType>(type);
+    dataset.add_attribute(Attribute(name, att_type));
+
+    Column col(att_type);
+    if (att_type == NOMINAL) {
+      // every label takes at least 8 bytes, which bounds how many there are
+      const uint64_t num_labels = in.read<uint64_t>();
+      if (num_labels > in.remaining() / SNAPSHOT_ALIGNMENT) {
+        throw CognoscoError("corrupt dataset snapshot " + filename +
+                            "; file is truncated");
+      }
+      vector<string> labels(num_labels);
+      for (auto &label : labels) label = in.read_string();
+      const MappableVector<uint32_t> codes(read_codes(in, n, file));
+      check_codes(codes, labels.size(), filename, name);
+      col.assign_nominal(labels, codes);
+    } else if (sparse) {
+      const size_t nnz = in.read<uint64_t>();
+      const MappableVector<uint32_t> rows(read_codes(in, nnz, file));
+      check_sparse_rows(rows, n, filename, name);
+      col.assign_sparse(n, rows, read_values(in, nnz, file));
+    } else if (att_type != NULL_ATTRIBUTE_TYPE) {
+      col.assign_dense(read_values(in, n, file));
+    }
+    cols.push_back(std::move(col));
+  }
+  if (!in.at_end()) {
+    throw CognoscoError("corrupt dataset snapshot " + filename +
+                        "; unexpected data after last attribute");
+  }
+
+  dataset.set_numeric_storage(static_cast<NumericStorage>(header.numeric_storage));
+  dataset.set_columns(cols);
+
+  if (VERBOSE) {
+    cerr << "loaded dataset snapshot from " << filename << endl;
+    cerr << "found " << dataset.num_attributes() << " attributes: ";
+    for (Dataset::const_attribute_iterator it = dataset.begin_attributes();
+         it != dataset.end_attributes(); ++it) {
+      if (it != dataset.begin_attributes()) cerr << ", ";
+      cerr << (*it)->get_name() << " ("
+           << (*it)->get_attribute_type_string() << ")";
+    }
+    cerr << endl;
+  }
+}
+
+/**
+ * \brief check whether the named file is a dataset snapshot (of any
+ *        version), by looking at its first few bytes. Snapshots are always
+ *        regular files; anything else (a pipe, say) isn't read from, so
+ *        none of its input is used up.
+ */
+bool
+SnapshotLoader::is_snapshot(const string &filename) {
+  struct stat st;
+  if ((stat(filename.c_str(), &st) != 0) || !S_ISREG(st.st_mode))
+    return false;
+  std::ifstream strm(filename.c_str(), std::ios::binary);
+  SnapshotHeader header;
+  return read_header(strm, header);
+}
+
+/**
+ * \brief get the precision of the numeric values held in the named
+ *        snapshot, without loading it.
+ */
+NumericStorage
+SnapshotLoader::get_numeric_storage(const string &filename) {
+  std::ifstream strm(filename.c_str(), std::ios::binary);
+  SnapshotHeader header;
+  if (!read_header(strm, header))
+    throw CognoscoError("not a dataset snapshot: " + filename);
+  check_header(header, filename);
+  return static_cast<NumericStorage>(header.numeric_storage);
+}
@@ -0,0 +1,61 @@
+/* The following applies to this software package and all subparts therein
+ *
+ * Cognosco Copyright (C) 2015 Philip J. Uren
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or (at
+ * your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef DATASET_SNAPSHOT_HPP_
+#define DATASET_SNAPSHOT_HPP_
+
+// stl includes
+#include <string>
+
+// local Cognosco includes
+#include "Dataset.hpp"
+#include "NumericBuffer.hpp"
+
+/**
+ * \brief Dataset snapshots are a binary format holding a dataset's schema,
+ *        the dictionaries of its nominal columns and its column storage
+ *        exactly as it's laid out in memory, including sparse columns and
+ *        the numeric storage precision. Every array in the file is 8-byte
+ *        aligned, so a loaded snapshot is just a memory-mapping of the file
+ *        with columns that refer into it; nothing is parsed or copied, and
+ *        pages are only read from disk as they're used. Values are stored
+ *        in the byte order of the machine that wrote the snapshot, and only
+ *        machines with the same byte order can load it.
+ *
+ *        The layout is a header (magic, version, byte order mark, number of
+ *        rows and attributes, numeric storage) followed by each attribute in
+ *        turn: its name and type, then for nominal attributes the column's
+ *        distinct labels and its codes, and for numeric attributes the
+ *        column's storage, quantization offset and scale and its values
+ *        (dense), or its non-zero rows and values (sparse).
+ */
+class SnapshotWriter {
+public:
+  void write(const Dataset &dataset, const std::string &filename) const;
+};
+
+class SnapshotLoader {
+public:
+  void load(const std::string &filename, Dataset &dataset,
+            const bool VERBOSE=false) const;
+  static bool is_snapshot(const std::string &filename);
+  static NumericStorage get_numeric_storage(const std::string &filename);
+};
+
+#endif
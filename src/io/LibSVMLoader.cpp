@@ -0,0 +1,436 @@
+/* The following applys to this software package and all subparts therein
+ *
+ * Cognosco Copyright (C) 2015 Philip J. Uren
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or (at
+ * your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+// stl includes
+#include <string>
+#include <vector>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <algorithm>
+#include <utility>
+#include <cstring>
+#include <cstdlib>
+#include <cctype>
+#include <cstdio>
+#include <memory>
+
+// system includes
+#include <sys/stat.h>
+
+// local Cognosco includes
+#include "LibSVMLoader.hpp"
+#include "StringUtils.hpp"
+#include "MappedFile.hpp"
+#include "Dataset.hpp"
+#include "Column.hpp"
+#include "CognoscoError.hpp"
+
+// bring these into local namespace
+using std::cerr;
+using std::endl;
+using std::string;
+using std::vector;
+using std::pair;
+using std::ifstream;
+
+const string LibSVMLoader::LABEL_ATTRIBUTE = "label";
+const string LibSVMLoader::QID_ATTRIBUTE = "qid";
+
+/**
+ * \brief the columns being loaded into, which are only moved into the
+ *        dataset once the whole file is read and the number of features is
+ *        known. Feature columns are added as larger indexes are seen, and
+ *        every column is only filled out to the current row when it's next
+ *        given a value.
+ */
+struct LibSVMLoader::LoadState {
+  LoadState(const NumericStorage storage) :
+    num_rows(0), has_qid(false), storage(storage),
+    strings(new StringTable()), labels(NOMINAL, strings),
+    qids(NUMERIC, strings) {
+    this->qids.set_storage(storage);
+  }
+  size_t num_rows;
+  bool has_qid;
+  NumericStorage storage;
+  std::shared_ptr<StringTable> strings;
+  Column labels;
+  Column qids;
+  vector<Column> features;
+  string label;
+};
+
+
+/*****************************************************************************
+ *                               PARSING                                     *
+ *****************************************************************************/
+
+static inline bool
+is_space(const char c) {
+  return std::isspace(static_cast<unsigned char>(c));
+}
+
+/**
+ * \brief find the next whitespace-separated token of a line, starting from
+ *        pos and ending at end, and move pos past it.
+ * \return false if there are no more tokens.
+ */
+static bool
+next_token(const char *&pos, const char *end,
+           const char *&tok_begin, const char *&tok_end) {
+  while ((pos != end) && is_space(*pos)) ++pos;
+  if (pos == end) return false;
+  tok_begin = pos;
+  while ((pos != end) && !is_space(*pos)) ++pos;
+  tok_end = pos;
+  return true;
+}
+
+/**
+ * \brief parse [begin, end) as a non-negative integer.
+ * \return false if it isn't one.
+ */
+static bool
+parse_index(const char *begin, const char *end, size_t &index) {
+  if (begin == end) return false;
+  index = 0;
+  for (; begin != end; ++begin) {
+    if ((*begin < '0') || (*begin > '9')) return false;
+    index = 10 * index + (*begin - '0');
+  }
+  return true;
+}
+
+/**
+ * \brief parse a line of the file, given by [begin, end) without its
+ *        newline, and add its values to the state's columns. Blank lines
+ *        and comments are skipped.
+ */
+void
+LibSVMLoader::parse_line(const char *begin, const char *end,
+                         LoadState &state) const {
+  const char *comment = static_cast<const char*>(memchr(begin, '#',
+                                                        end - begin));
+  if (comment != NULL) end = comment;
+  const char *tok_begin, *tok_end;
+  if (!next_token(begin, end, tok_begin, tok_end)) return;
+
+  state.label.assign(tok_begin, tok_end);
+  state.labels.push_back(state.label);
+  size_t next_index = 1;
+  while (next_token(begin, end, tok_begin, tok_end)) {
+    const char *colon = static_cast<const char*>(memchr(tok_begin, ':',
+                                                        tok_end - tok_begin));
+    if (colon == NULL) {
+      std::stringstream ss;
+      ss << "failed to parse " << string(tok_begin, tok_end) << " in row "
+         << state.num_rows << "; expected <index>:<value>";
+      throw CognoscoError(ss.str());
+    }
+    double val;
+    if (!parse_double(colon + 1, tok_end, val)) {
+      std::stringstream ss;
+      ss << "failed to parse " << string(colon + 1, tok_end)
+         << " as numeric in row " << state.num_rows;
+      throw CognoscoError(ss.str());
+    }
+
+    if ((colon - tok_begin == 3) && (next_index == 1) &&
+        (memcmp(tok_begin, "qid", 3) == 0)) {
+      state.has_qid = true;
+      state.qids.fill(state.num_rows);
+      state.qids.push_back(val);
+      continue;
+    }
+    size_t index;
+    if (!parse_index(tok_begin, colon, index) || (index < next_index)) {
+      std::stringstream ss;
+      ss << "bad feature index " << string(tok_begin, colon) << " in row "
+         << state.num_rows << "; indexes must count up from 1";
+      throw CognoscoError(ss.str());
+    }
+    while (state.features.size() < index) {
+      state.features.push_back(Column(NUMERIC, state.strings));
+      state.features.back().set_storage(state.storage);
+    }
+    Column &col = state.features[index - 1];
+    col.fill(state.num_rows);
+    col.push_back(val);
+    next_index = index + 1;
+  }
+  state.num_rows += 1;
+}
+
+/**
+ * \brief add the attributes for the columns that were loaded to the
+ *        dataset, pad every column out to the number of rows read, and move
+ *        them into the dataset.
+ */
+void
+LibSVMLoader::finish(Dataset &dataset, LoadState &state) const {
+  while (state.features.size() < this->num_features) {
+    state.features.push_back(Column(NUMERIC, state.strings));
+    state.features.back().set_storage(state.storage);
+  }
+
+  vector<Column> cols;
+  cols.reserve(state.features.size() + 2);
+  dataset.add_attribute(Attribute(LABEL_ATTRIBUTE, NOMINAL));
+  cols.push_back(Column());
+  std::swap(cols.back(), state.labels);
+  if (state.has_qid) {
+    dataset.add_attribute(Attribute(QID_ATTRIBUTE, NUMERIC));
+    state.qids.fill(state.num_rows);
+    cols.push_back(Column());
+    std::swap(cols.back(), state.qids);
+  }
+  for (size_t i = 0; i < state.features.size(); ++i) {
+    std::stringstream ss;
+    ss << (i + 1);
+    dataset.add_attribute(Attribute(ss.str(), NUMERIC));
+    state.features[i].fill(state.num_rows);
+    cols.push_back(Column());
+    std::swap(cols.back(), state.features[i]);
+  }
+  dataset.set_columns(cols);
+}
+
+
+/*****************************************************************************
+ *                               LOADING                                     *
+ *****************************************************************************/
+
+/**
+ * \brief parse the file by memory-mapping it and parsing each line in
+ *        place.
+ */
+void
+LibSVMLoader::load_mapped(const string &filename, LoadState &state) const {
+  MappedFile file(filename);
+  file.advise_sequential();
+  const char *begin = file.data();
+  const char *end = begin + file.size();
+  while (begin < end) {
+    const char *eol = static_cast<const char*>(memchr(begin, '\n',
+                                                      end - begin));
+    if (eol == NULL) eol = end;
+    this->parse_line(begin, eol, state);
+    begin = eol + 1;
+  }
+}
+
+/**
+ * \brief parse the file by reading it a line at a time.
+ */
+void
+LibSVMLoader::load_stream(const string &filename, LoadState &state) const {
+  ifstream strm(filename.c_str());
+  if (!strm.good()) {
+    std::stringstream ss;
+    ss << "failed to open file: " << filename;
+    throw CognoscoError(ss.str());
+  }
+  string line;
+  while (getline(strm, line))
+    this->parse_line(line.data(), line.data() + line.size(), state);
+}
+
+/**
+ * \brief load the dataset from the given LIBSVM file. The dataset must not
+ *        have any attributes yet, since they're determined by the file.
+ */
+void
+LibSVMLoader::load(const string &filename, Dataset &dataset,
+                   const bool VERBOSE) const {
+  if (dataset.num_attributes() != 0) {
+    throw CognoscoError("cannot load LIBSVM file " + filename + " into a "
+                        "dataset that already has attributes");
+  }
+  // numeric values are kept at full precision unless the dataset doesn't
+  // need it
+  LoadState state((dataset.get_numeric_storage() == DOUBLE_STORAGE) ?
+                  DOUBLE_STORAGE : FLOAT_STORAGE);
+  struct stat st;
+  if (this->memory_mapped && (stat(filename.c_str(), &st) == 0) &&
+      S_ISREG(st.st_mode))
+    this->load_mapped(filename, state);
+  else
+    this->load_stream(filename, state);
+  this->finish(dataset, state);
+
+  if (VERBOSE) {
+    cerr << "loaded dataset from " << filename << endl;
+    cerr << "found " << dataset.size() << " rows, "
+         << state.features.size() << " features"
+         << (state.has_qid ? " and qids" : "") << endl;
+  }
+}
+
+/**
+ * \brief check whether the named file is to be loaded as LIBSVM; that is,
+ *        whether it has a .libsvm, .svm or .svmlight extension. Nothing is
+ *        read from the file.
+ */
+bool
+LibSVMLoader::is_libsvm(const string &filename) {
+  const size_t dot = filename.find_last_of("./");
+  if ((dot == string::npos) || (filename[dot] != '.')) return false;
+  string ext(filename.substr(dot + 1));
+  std::transform(ext.begin(), ext.end(), ext.begin(),
+                 [](const unsigned char c) { return std::tolower(c); });
+  return (ext == "libsvm") || (ext == "svm") || (ext == "svmlight");
+}
+
+/**
+ * \brief get the number of features in a dataset loaded from a LIBSVM file;
+ *        that is, the largest attribute name that's a feature index. Other
+ *        LIBSVM files can be loaded with at least this many features, so
+ *        they have all of the same attributes.
+ */
+size_t
+LibSVMLoader::count_features(const Dataset &dataset) {
+  size_t num_features = 0;
+  for (size_t k = 0; k < dataset.num_attributes(); ++k) {
+    const string &name = dataset.get_attribute_description_ptr(k)->get_name();
+    size_t index;
+    if (parse_index(name.data(), name.data() + name.size(), index))
+      num_features = std::max(num_features, index);
+  }
+  return num_features;
+}
+
+
+/*****************************************************************************
+ *                               WRITING                                     *
+ *****************************************************************************/
+
+/**
+ * \brief write the dataset to the named file, one row per line.
+ */
+void
+LibSVMWriter::write(const Dataset &d, const string &filename) const {
+  if (!d.has_attribute(this->label_attribute)) {
+    throw CognoscoError("cannot write LIBSVM file " + filename + "; no "
+                        "label attribute " + this->label_attribute);
+  }
+  const size_t label_k = d.get_attribute_index(this->label_attribute);
+  const bool has_qid = d.has_attribute(LibSVMLoader::QID_ATTRIBUTE) &&
+    (d.get_attribute_type(d.get_attribute_index(LibSVMLoader::QID_ATTRIBUTE))
+     == NUMERIC);
+  const size_t qid_k = has_qid ?
+    d.get_attribute_index(LibSVMLoader::QID_ATTRIBUTE) : 0;
+
+  // the feature columns, with their indexes; by name if those are all
+  // distinct indexes, and otherwise by position
+  vector<pair<size_t, size_t> > features;
+  bool by_name = true;
+  for (size_t k = 0; k < d.num_attributes(); ++k) {
+    if ((k == label_k) || (has_qid && (k == qid_k))) continue;
+    const string &name = d.get_attribute_description_ptr(k)->get_name();
+    if (d.get_attribute_type(k) == NOMINAL) {
+      throw CognoscoError("cannot write nominal attribute " + name +
+                          " as a LIBSVM feature");
+    }
+    size_t index;
+    if (!parse_index(name.data(), name.data() + name.size(), index) ||
+        (index == 0))
+      by_name = false;
+    features.push_back(std::make_pair(by_name ? index : 0, k));
+  }
+  if (by_name) {
+    std::sort(features.begin(), features.end());
+    for (size_t i = 1; i < features.size(); ++i)
+      if (features[i].first == features[i - 1].first) by_name = false;
+  }
+  if (!by_name) {
+    std::sort(features.begin(), features.end(),
+              [](const pair<size_t, size_t> &a, const pair<size_t, size_t> &b)
+              { return a.second < b.second; });
+    for (size_t i = 0; i < features.size(); ++i) features[i].first = i + 1;
+  }
+
+  // the non-zeros of the sparse features, regrouped by row; the features
+  // are taken in index order, so each row's are too. Dense features are
+  // read row by row.
+  const size_t n = d.size();
+  vector<pair<size_t, const Column*> > dense;
+  vector<size_t> row_starts(n + 1, 0);
+  for (auto &f : features) {
+    const Column &col = d.get_column(f.second);
+    if (!col.is_sparse()) {
+      if (col.get_type() == NUMERIC)
+        dense.push_back(std::make_pair(f.first, &col));
+      continue;
+    }
+    const MappableVector<uint32_t> &rows = col.nonzero_rows();
+    for (size_t i = 0; i < rows.size(); ++i) row_starts[rows[i] + 1] += 1;
+  }
+  for (size_t r = 0; r < n; ++r) row_starts[r + 1] += row_starts[r];
+  vector<pair<size_t, double> > sparse_vals(row_starts[n]);
+  vector<size_t> next(row_starts.begin(), row_starts.end() - 1);
+  for (auto &f : features) {
+    const Column &col = d.get_column(f.second);
+    if (!col.is_sparse()) continue;
+    const MappableVector<uint32_t> &rows = col.nonzero_rows();
+    const NumericBuffer &vals = col.nonzero_values();
+    for (size_t i = 0; i < rows.size(); ++i)
+      sparse_vals[next[rows[i]]++] = std::make_pair(f.first, vals.get(i));
+  }
+
+  std::ofstream strm(filename.c_str(), std::ios::trunc);
+  if (!strm.good())
+    throw CognoscoError("failed to open file for writing: " + filename);
+  const Column &label_col = d.get_column(label_k);
+  vector<pair<size_t, double> > row_vals;
+  string line;
+  for (size_t r = 0; r < n; ++r) {
+    line.clear();
+    if (label_col.get_type() == NOMINAL) line += label_col.get_label(r);
+    else line += format_double(label_col.get_numeric(r));
+    if (has_qid) {
+      line += " qid:";
+      line += format_double(d.get_column(qid_k).get_numeric(r));
+    }
+
+    row_vals.clear();
+    for (auto &f : dense) {
+      const double val = f.second->get_numeric(r);
+      if (val != 0) row_vals.push_back(std::make_pair(f.first, val));
+    }
+    const size_t num_dense = row_vals.size();
+    row_vals.insert(row_vals.end(), sparse_vals.begin() + row_starts[r],
+                    sparse_vals.begin() + row_starts[r + 1]);
+    std::inplace_merge(row_vals.begin(), row_vals.begin() + num_dense,
+                       row_vals.end());
+
+    for (auto &v : row_vals) {
+      line += ' ';
+      line += std::to_string(v.first);
+      line += ':';
+      line += format_double(v.second);
+    }
+    line += '\n';
+    strm.write(line.data(), line.size());
+  }
+
+  strm.close();
+  if (strm.fail())
+    throw CognoscoError("failed to write LIBSVM file " + filename);
+}
@@ -0,0 +1,92 @@
+/* The following applys to this software package and all subparts therein
+ *
+ * Cognosco Copyright (C) 2015 Philip J. Uren
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or (at
+ * your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef LIBSVM_LOADER_HPP_
+#define LIBSVM_LOADER_HPP_
+
+// stl includes
+#include <string>
+
+// local Cognosco includes
+#include "Dataset.hpp"
+
+/**
+ * \brief Loads datasets from LIBSVM (SVMlight) sparse files, in which each
+ *        line is a label, an optional qid:<n>, and the non-zero features of
+ *        the row as <index>:<value> pairs with indexes in increasing order,
+ *        counted from 1; anything after a # is a comment. The dataset gets a
+ *        nominal "label" attribute, a numeric "qid" attribute if any row has
+ *        one, and a numeric attribute per feature, named by its index, up to
+ *        the largest index in the file (or num_features, if that's larger).
+ *
+ *        Values go straight into sparse columns; features a row leaves out
+ *        are zeros that cost nothing to add, so loading takes time and space
+ *        proportional to the number of non-zeros. Regular files are
+ *        memory-mapped and parsed in place; other files are read a line at
+ *        a time.
+ */
+class LibSVMLoader {
+public:
+  LibSVMLoader() : num_features(0), memory_mapped(true) {};
+  explicit LibSVMLoader(const size_t num_features,
+                        const bool memory_mapped=true) :
+    num_features(num_features), memory_mapped(memory_mapped) {};
+
+  void load(const std::string &filename, Dataset &dataset,
+            const bool VERBOSE=false) const;
+  static bool is_libsvm(const std::string &filename);
+  static size_t count_features(const Dataset &dataset);
+
+  static const std::string LABEL_ATTRIBUTE;
+  static const std::string QID_ATTRIBUTE;
+private:
+  // types
+  struct LoadState;
+
+  size_t num_features;
+  bool memory_mapped;
+
+  void load_mapped(const std::string &filename, LoadState &state) const;
+  void load_stream(const std::string &filename, LoadState &state) const;
+  void parse_line(const char *begin, const char *end, LoadState &state) const;
+  void finish(Dataset &dataset, LoadState &state) const;
+};
+
+/**
+ * \brief Writes datasets as LIBSVM files. The given label attribute gives
+ *        each line's label, a numeric "qid" attribute its qid, and every
+ *        other attribute, all of which must be numeric, a feature; only
+ *        non-zero values are written. Features are numbered by their
+ *        attribute names if those are all distinct positive integers (as
+ *        they are for datasets loaded by LibSVMLoader), and otherwise by
+ *        their order in the dataset, from 1. Sparse columns are written from
+ *        their non-zeros, without ever being made dense.
+ */
+class LibSVMWriter {
+public:
+  LibSVMWriter() : label_attribute(LibSVMLoader::LABEL_ATTRIBUTE) {};
+  explicit LibSVMWriter(const std::string &label_attribute) :
+    label_attribute(label_attribute) {};
+
+  void write(const Dataset &dataset, const std::string &filename) const;
+private:
+  std::string label_attribute;
+};
+
+#endif
@@ -0,0 +1,117 @@
+/* The following applies to this software package and all subparts therein
+ *
+ * Cognosco Copyright (C) 2015 Philip J. Uren
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or (at
+ * your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+// stl includes
+#include <string>
+#include <cstring>
+#include <cerrno>
+
+// system includes
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+// local Cognosco includes
+#include "MappedFile.hpp"
+#include "CognoscoError.hpp"
+
+// bring these into the local namespace
+using std::string;
+
+/*****************************************************************************
+ *                       CONSTRUCTORS AND DESTRUCTORS                        *
+ *****************************************************************************/
+
+/**
+ * \brief map the whole of the named file into memory. An empty file gives
+ *        an empty mapping.
+ */
+MappedFile::MappedFile(const string &filename) :
+  filename(filename), addr(NULL), length(0) {
+  const int fd = open(filename.c_str(), O_RDONLY);
+  if (fd < 0) {
+    throw CognoscoError("failed to open file: " + filename + " (" +
+                        strerror(errno) + ")");
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    const string err(strerror(errno));
+    close(fd);
+    throw CognoscoError("failed to stat file: " + filename + " (" + err + ")");
+  }
+  this->length = st.st_size;
+  if (this->length != 0) {
+    void *res = mmap(NULL, this->length, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (res == MAP_FAILED) {
+      const string err(strerror(errno));
+      close(fd);
+      throw CognoscoError("failed to map file: " + filename + " (" + err + ")");
+    }
+    this->addr = static_cast<const char*>(res);
+  }
+  // the mapping stays valid once the file is closed
+  close(fd);
+}
+
+MappedFile::~MappedFile() {
+  if (this->addr != NULL)
+    munmap(const_cast<char*>(this->addr), this->length);
+}
+
+
+/*****************************************************************************
+ *                               INSPECTORS                                  *
+ *****************************************************************************/
+
+/**
+ * \brief tell the kernel the mapping will be read from start to end, so it
+ *        reads ahead aggressively and drops pages once they've been passed.
+ *        This is only a hint; failure is ignored.
+ */
+void
+MappedFile::advise_sequential() const {
+  if (this->addr != NULL)
+    madvise(const_cast<char*>(this->addr), this->length, MADV_SEQUENTIAL);
+}
+
+
+/*****************************************************************************
+ *                            FILE MODIFICATION                              *
+ *****************************************************************************/
+
+/**
+ * \brief check whether the named file was modified after the named source
+ *        file, to the nanosecond; that is, whether a file derived from the
+ *        source (a snapshot, say) was written since the source last changed.
+ *        Files modified at the same recorded time don't count, since on
+ *        filesystems that only keep whole seconds that may just mean the
+ *        same second, and a derived file can always be rebuilt.
+ * \return false if either file can't be stat'ed.
+ */
+bool
+modified_after(const string &filename, const string &source) {
+  struct stat st, source_st;
+  if ((stat(filename.c_str(), &st) != 0) ||
+      (stat(source.c_str(), &source_st) != 0))
+    return false;
+  if (st.st_mtim.tv_sec != source_st.st_mtim.tv_sec)
+    return st.st_mtim.tv_sec > source_st.st_mtim.tv_sec;
+  return st.st_mtim.tv_nsec > source_st.st_mtim.tv_nsec;
+}
@@ -0,0 +1,55 @@
+/* The following applies to this software package and all subparts therein
+ *
+ * Cognosco Copyright (C) 2015 Philip J. Uren
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or (at
+ * your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef MAPPED_FILE_HPP_
+#define MAPPED_FILE_HPP_
+
+// stl includes
+#include <string>
+#include <cstddef>
+
+/**
+ * \brief A whole file mapped read-only into memory. The mapping lasts for
+ *        the lifetime of the object, which can't be copied; share it by
+ *        pointer instead.
+ */
+class MappedFile {
+public:
+  // constructors and destructors
+  explicit MappedFile(const std::string &filename);
+  MappedFile(const MappedFile &) = delete;
+  MappedFile& operator=(const MappedFile &) = delete;
+  ~MappedFile();
+
+  // inspectors
+  const char* data() const { return this->addr; }
+  size_t size() const { return this->length; }
+  const std::string& get_filename() const { return this->filename; }
+  void advise_sequential() const;
+
+private:
+  // private instance variables
+  std::string filename;
+  const char *addr;
+  size_t length;
+};
+
+bool modified_after(const std::string &filename, const std::string &source);
+
+#endif
@@ -0,0 +1,297 @@
+/* The following applys to this software package and all subparts therein
+ *
+ * Cognosco Copyright (C) 2015 Philip J. Uren
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or (at
+ * your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+// stl includes
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <memory>
+#include <cstring>
+#include <cstdint>
+#include <cstdio>
+
+// system includes
+#include <sys/stat.h>
+
+// local Cognosco includes
+#include "MatrixSnapshot.hpp"
+#include "MappedFile.hpp"
+#include "DistanceMatrix.hpp"
+#include "CognoscoError.hpp"
+
+// bring these into the local namespace
+using std::string;
+using std::vector;
+using std::shared_ptr;
+
+/*****************************************************************************
+ *                              FILE LAYOUT                                  *
+ *****************************************************************************/
+
+static const char MATRIX_MAGIC[8] = {'C', 'O', 'G', 'D', 'M', 'A', 'T', '\0'};
+static const uint32_t MATRIX_VERSION = 2;
+static const uint32_t MATRIX_BYTE_ORDER = 0x01020304;
+static const size_t MATRIX_ALIGNMENT = 8;
+
+struct MatrixHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t byte_order;
+  uint64_t num_points;
+  uint32_t condensed;
+  uint32_t storage;
+  double offset;
+  double scale;
+};
+
+static size_t
+value_size(const NumericStorage &storage) {
+  switch (storage) {
+    case DOUBLE_STORAGE: return sizeof(double);
+    case FLOAT_STORAGE: return sizeof(float);
+    case QUANTIZED_16_STORAGE: return sizeof(uint16_t);
+    default: return sizeof(uint8_t);
+  }
+}
+
+/**
+ * \brief read and check the header of a snapshot.
+ * \return false if the file isn't a snapshot at all.
+ */
+static bool
+read_header(std::istream &in, MatrixHeader &header) {
+  in.read(reinterpret_cast<char*>(&header), sizeof(header));
+  return in.good() &&
+    (memcmp(header.magic, MATRIX_MAGIC, sizeof(MATRIX_MAGIC)) == 0);
+}
+
+static void
+check_header(const MatrixHeader &header, const string &filename) {
+  if (header.byte_order != MATRIX_BYTE_ORDER) {
+    throw CognoscoError("cannot load matrix snapshot " + filename + "; it "
+                        "was written on a machine with a different byte order");
+  }
+  if (header.version != MATRIX_VERSION) {
+    std::stringstream ss;
+    ss << "cannot load matrix snapshot " << filename << "; unsupported "
+       << "version " << header.version;
+    throw CognoscoError(ss.str());
+  }
+  if (header.storage > QUANTIZED_8_STORAGE) {
+    std::stringstream ss;
+    ss << "corrupt matrix snapshot " << filename << "; unknown storage "
+       << header.storage;
+    throw CognoscoError(ss.str());
+  }
+}
+
+
+/*****************************************************************************
+ *                                 WRITING                                   *
+ *****************************************************************************/
+
+/**
+ * \brief writes the pieces of a snapshot, padding each one so the next
+ *        starts on an aligned offset.
+ */
+class MatrixOutput {
+public:
+  MatrixOutput(std::ostream &out) : out(out), pos(0) {}
+  template <typename T> void write(const T &val) {
+    this->write_bytes(&val, sizeof(T));
+  }
+  void write_bytes(const void *data, const size_t n) {
+    this->out.write(static_cast<const char*>(data), n);
+    this->pos += n;
+    const char zeros[MATRIX_ALIGNMENT] = {0};
+    const size_t pad = (MATRIX_ALIGNMENT - this->pos % MATRIX_ALIGNMENT) %
+                       MATRIX_ALIGNMENT;
+    this->out.write(zeros, pad);
+    this->pos += pad;
+  }
+  void write_string(const string &s) {
+    this->write(static_cast<uint64_t>(s.size()));
+    this->write_bytes(s.data(), s.size());
+  }
+private:
+  std::ostream &out;
+  size_t pos;
+};
+
+/**
+ * \brief write a snapshot of the given matrix. The snapshot is written to a
+ *        temporary file that replaces the named one once it's complete, so
+ *        a snapshot is never seen half-written.
+ */
+void
+MatrixSnapshotWriter::write(const DistanceMatrix &m,
+                            const string &filename) const {
+  const string tmp_fn(filename + ".tmp");
+  std::ofstream strm(tmp_fn.c_str(), std::ios::binary | std::ios::trunc);
+  if (!strm.good())
+    throw CognoscoError("failed to open file for writing: " + tmp_fn);
+
+  MatrixHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, MATRIX_MAGIC, sizeof(MATRIX_MAGIC));
+  header.version = MATRIX_VERSION;
+  header.byte_order = MATRIX_BYTE_ORDER;
+  header.num_points = m.size();
+  header.condensed = m.is_condensed();
+  header.storage = m.get_storage();
+  header.offset = m.get_offset();
+  header.scale = m.get_scale();
+
+  MatrixOutput out(strm);
+  out.write(header);
+  for (auto &name : m.get_names()) out.write_string(name);
+  out.write(static_cast<uint64_t>(m.num_entries()));
+  out.write_bytes(m.entry_data(),
+                  m.num_entries() * value_size(m.get_storage()));
+
+  strm.close();
+  if (strm.fail()) {
+    std::remove(tmp_fn.c_str());
+    throw CognoscoError("failed to write matrix snapshot " + filename);
+  }
+  if (std::rename(tmp_fn.c_str(), filename.c_str()) != 0) {
+    std::remove(tmp_fn.c_str());
+    throw CognoscoError("failed to write matrix snapshot " + filename);
+  }
+}
+
+
+/*****************************************************************************
+ *                                 LOADING                                   *
+ *****************************************************************************/
+
+/**
+ * \brief reads the pieces of a snapshot in place from its mapping, checking
+ *        that none of them runs past the end of the file.
+ */
+class MatrixInput {
+public:
+  MatrixInput(const MappedFile &file) : file(file), pos(0) {}
+  template <typename T> T read() {
+    T val;
+    memcpy(&val, this->read_bytes(sizeof(T)), sizeof(T));
+    return val;
+  }
+  const char* read_bytes(const size_t n) {
+    if ((n > this->file.size()) || (this->pos > this->file.size() - n)) {
+      throw CognoscoError("corrupt matrix snapshot " +
+                          this->file.get_filename() + "; file is truncated");
+    }
+    const char *res = this->file.data() + this->pos;
+    this->pos += n;
+    this->pos += (MATRIX_ALIGNMENT - this->pos % MATRIX_ALIGNMENT) %
+                 MATRIX_ALIGNMENT;
+    return res;
+  }
+  string read_string() {
+    const uint64_t n = this->read<uint64_t>();
+    return string(this->read_bytes(n), n);
+  }
+  bool at_end() const { return this->pos >= this->file.size(); }
+private:
+  const MappedFile &file;
+  size_t pos;
+};
+
+/**
+ * \brief load a snapshot into the given matrix, replacing its contents. The
+ *        matrix's distances refer straight into the mapped file, which stays
+ *        mapped for as long as the matrix uses it.
+ */
+void
+MatrixSnapshotLoader::load(const string &filename, DistanceMatrix &m) const {
+  shared_ptr<const MappedFile> file(new MappedFile(filename));
+  MatrixInput in(*file);
+  if (file->size() < sizeof(MatrixHeader))
+    throw CognoscoError("not a matrix snapshot: " + filename);
+  const MatrixHeader header(in.read<MatrixHeader>());
+  if (memcmp(header.magic, MATRIX_MAGIC, sizeof(MATRIX_MAGIC)) != 0)
+    throw CognoscoError("not a matrix snapshot: " + filename);
+  check_header(header, filename);
+
+  // every name takes at least 8 bytes, which bounds the number of points
+  // (and keeps n * n from overflowing below)
+  if (header.num_points > file->size() / MATRIX_ALIGNMENT) {
+    throw CognoscoError("corrupt matrix snapshot " + filename +
+                        "; file is truncated");
+  }
+  vector<string> names(header.num_points);
+  for (auto &name : names) name = in.read_string();
+
+  const NumericStorage storage = static_cast<NumericStorage>(header.storage);
+  const size_t n = names.size();
+  const size_t expected = !header.condensed ? n * n :
+                          (n == 0) ? 0 : n * (n - 1) / 2;
+  if (in.read<uint64_t>() != expected) {
+    throw CognoscoError("corrupt matrix snapshot " + filename +
+                        "; wrong number of distances");
+  }
+  if (expected > file->size() / value_size(storage)) {
+    throw CognoscoError("corrupt matrix snapshot " + filename +
+                        "; file is truncated");
+  }
+  const char *data = in.read_bytes(expected * value_size(storage));
+  if (!in.at_end()) {
+    throw CognoscoError("corrupt matrix snapshot " + filename +
+                        "; unexpected data after distances");
+  }
+
+  DistanceMatrix res;
+  res.map(names, header.condensed != 0, storage, data, header.offset,
+          header.scale, file);
+  m.swap(res);
+}
+
+/**
+ * \brief check whether the named file is a matrix snapshot (of any
+ *        version), by looking at its first few bytes. Snapshots are always
+ *        regular files; anything else (a pipe, say) isn't read from, so
+ *        none of its input is used up.
+ */
+bool
+MatrixSnapshotLoader::is_snapshot(const string &filename) {
+  struct stat st;
+  if ((stat(filename.c_str(), &st) != 0) || !S_ISREG(st.st_mode))
+    return false;
+  std::ifstream strm(filename.c_str(), std::ios::binary);
+  MatrixHeader header;
+  return read_header(strm, header);
+}
+
+/**
+ * \brief get whether the matrix held in the named snapshot is condensed,
+ *        and its storage, without loading it.
+ */
+void
+MatrixSnapshotLoader::get_layout(const string &filename, bool &condensed,
+                                 NumericStorage &storage) {
+  std::ifstream strm(filename.c_str(), std::ios::binary);
+  MatrixHeader header;
+  if (!read_header(strm, header))
+    throw CognoscoError("not a matrix snapshot: " + filename);
+  check_header(header, filename);
+  condensed = header.condensed != 0;
+  storage = static_cast<NumericStorage>(header.storage);
+}
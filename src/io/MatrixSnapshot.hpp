@@ -0,0 +1,58 @@
+/* The following applys to this software package and all subparts therein
+ *
+ * Cognosco Copyright (C) 2015 Philip J. Uren
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or (at
+ * your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef MATRIX_SNAPSHOT_HPP_
+#define MATRIX_SNAPSHOT_HPP_
+
+// stl includes
+#include <string>
+
+// local Cognosco includes
+#include "DistanceMatrix.hpp"
+
+/**
+ * \brief Matrix snapshots are a binary format holding a distance matrix's
+ *        point names and its distances exactly as they're laid out in
+ *        memory, full or condensed, at any numeric storage. The distances
+ *        are 8-byte aligned, so a loaded snapshot is a memory-mapping of
+ *        the file with a matrix that refers into it; only the names are
+ *        read, and pages of distances are only read from disk as they're
+ *        used. Values are stored in the byte order of the machine that
+ *        wrote the snapshot, and only machines with the same byte order can
+ *        load it.
+ *
+ *        The layout is a header (magic, version, byte order mark, number of
+ *        points, whether the matrix is condensed, its storage and
+ *        quantization offset and scale) followed by the name of each point,
+ *        then the number of distances and the distances themselves.
+ */
+class MatrixSnapshotWriter {
+public:
+  void write(const DistanceMatrix &m, const std::string &filename) const;
+};
+
+class MatrixSnapshotLoader {
+public:
+  void load(const std::string &filename, DistanceMatrix &m) const;
+  static bool is_snapshot(const std::string &filename);
+  static void get_layout(const std::string &filename, bool &condensed,
+                         NumericStorage &storage);
+};
+
+#endif
@@ -21,29 +21,359 @@
 #include <string>
 #include <vector>
 #include <fstream>
+#include <cctype>
+#include <unordered_map>
+#include <algorithm>
+#include <thread>
+#include <exception>
+#include <functional>
+#include <cstdint>
+#include <cstring>
+
+// system includes
+#include <sys/stat.h>
 
 // local Cognosco includes
 #include "PairwiseDistanceLoader.hpp"
+#include "StringUtils.hpp"
+#include "MappedFile.hpp"
+#include "TiledDistanceMatrix.hpp"
 #include "CognoscoError.hpp"
 
 // bring these into the local namespace
 using std::string;
+using std::vector;
+using std::unordered_map;
+
+/*****************************************************************************
+ *                                PARSING                                    *
+ *****************************************************************************/
+
+/**
+ * \brief a line of the file; the names of the two points, as slices of the
+ *        line, and the distance between them.
+ */
+struct PairwiseDistance {
+  const char *from;
+  const char *from_end;
+  const char *to;
+  const char *to_end;
+  double dist;
+};
+
+static inline bool
+is_space(const char c) {
+  return std::isspace(static_cast<unsigned char>(c));
+}
+
+/**
+ * \brief find the next whitespace-separated token of a line, starting from
+ *        pos and ending at end, and move pos past it.
+ * \return false if there are no more tokens.
+ */
+static bool
+next_token(const char *&pos, const char *end,
+           const char *&tok_begin, const char *&tok_end) {
+  while ((pos != end) && is_space(*pos)) ++pos;
+  if (pos == end) return false;
+  tok_begin = pos;
+  while ((pos != end) && !is_space(*pos)) ++pos;
+  tok_end = pos;
+  return true;
+}
+
+/**
+ * \brief parse the line [begin, end) as a triple. The distance is only
+ *        parsed if parse_dist is set.
+ * \return false if the line is blank.
+ */
+static bool
+parse_line(const char *begin, const char *end, const bool parse_dist,
+           PairwiseDistance &pd) {
+  const char *dist_begin, *dist_end, *extra, *extra_end;
+  if (!next_token(begin, end, pd.from, pd.from_end)) return false;
+  if (!next_token(begin, end, pd.to, pd.to_end) ||
+      !next_token(begin, end, dist_begin, dist_end) ||
+      next_token(begin, end, extra, extra_end)) {
+    throw CognoscoError("expected two names and a distance, found: " +
+                        string(pd.from, end));
+  }
+  if (parse_dist && !parse_double(dist_begin, dist_end, pd.dist)) {
+    throw CognoscoError("failed to parse distance " +
+                        string(dist_begin, dist_end));
+  }
+  return true;
+}
+
+/**
+ * \brief Resolves the names of points to their indexes in a dictionary,
+ *        adding them if add is set, and failing otherwise. Each line's first
+ *        point is checked against the previous line's, and its second
+ *        against the point after the previous line's, before the dictionary
+ *        is searched.
+ */
+class PointIndex {
+public:
+  PointIndex(unordered_map<string, uint32_t> &index, vector<string> &names,
+             const bool add) :
+    index(index), names(names), add(add), last_from(0), last_to(0) {}
+  uint32_t from(const char *begin, const char *end) {
+    if (!this->matches(this->last_from, begin, end))
+      this->last_from = this->lookup(begin, end);
+    return this->last_from;
+  }
+  uint32_t to(const char *begin, const char *end) {
+    if (!this->matches(this->last_to + 1, begin, end))
+      this->last_to = this->lookup(begin, end);
+    else
+      this->last_to += 1;
+    return this->last_to;
+  }
+private:
+  unordered_map<string, uint32_t> &index;
+  vector<string> &names;
+  bool add;
+  uint32_t last_from;
+  uint32_t last_to;
+  string buf;
+
+  bool matches(const uint32_t i, const char *begin, const char *end) const {
+    return (i < this->names.size()) &&
+      (this->names[i].size() == size_t(end - begin)) &&
+      (memcmp(this->names[i].data(), begin, end - begin) == 0);
+  }
+  uint32_t lookup(const char *begin, const char *end) {
+    this->buf.assign(begin, end);
+    auto it = this->index.find(this->buf);
+    if (it != this->index.end()) return it->second;
+    if (!this->add)
+      throw CognoscoError("no such point in distance matrix: " + this->buf);
+    this->index.emplace(this->buf, this->names.size());
+    this->names.push_back(this->buf);
+    return this->names.size() - 1;
+  }
+};
+
+
+/*****************************************************************************
+ *                                LOADING                                    *
+ *****************************************************************************/
+
+/**
+ * \brief call f(t, begin, end) on each of the chunks [bounds[t],
+ *        bounds[t + 1]), on a thread per chunk. If any fail, the error from
+ *        the earliest is the one reported, which is the one a serial load
+ *        would have hit first.
+ */
+static void
+for_each_chunk(const vector<const char*> &bounds,
+               const std::function<void(size_t, const char*,
+                                        const char*)> &f) {
+  const size_t num_chunks = bounds.size() - 1;
+  vector<std::exception_ptr> errors(num_chunks);
+  vector<std::thread> workers;
+  for (size_t t = 0; t < num_chunks; ++t) {
+    workers.push_back(std::thread([&, t]() {
+      try {
+        f(t, bounds[t], bounds[t + 1]);
+      } catch (...) {
+        errors[t] = std::current_exception();
+      }
+    }));
+  }
+  for (auto &worker : workers) worker.join();
+  for (auto &error : errors)
+    if (error) std::rethrow_exception(error);
+}
+
+/**
+ * \brief call f on each line of [begin, end).
+ */
+template <typename F> static void
+for_each_line(const char *begin, const char *end, F f) {
+  while (begin < end) {
+    const char *eol = static_cast<const char*>(memchr(begin, '\n',
+                                                      end - begin));
+    if (eol == NULL) eol = end;
+    f(begin, eol);
+    begin = eol + 1;
+  }
+}
+
+/**
+ * \brief split a mapped file into num_chunks chunks of whole lines.
+ */
+static vector<const char*>
+chunk_bounds(const MappedFile &file, const size_t num_chunks) {
+  const char *begin = file.data();
+  const char *end = begin + file.size();
+  vector<const char*> bounds(1, begin);
+  for (size_t t = 1; t < num_chunks; ++t) {
+    const char *split = std::max(bounds.back(),
+                                 begin + (end - begin) * t / num_chunks);
+    const char *eol = static_cast<const char*>(memchr(split, '\n',
+                                                      end - split));
+    bounds.push_back((eol == NULL) ? end : eol + 1);
+  }
+  bounds.push_back(end);
+  return bounds;
+}
+
+/**
+ * \brief find the points named in each chunk, in order of first appearance,
+ *        and combine them in chunk order.
+ */
+static void
+find_points(const vector<const char*> &bounds,
+            unordered_map<string, uint32_t> &index, vector<string> &names) {
+  vector<vector<string> > chunk_names(bounds.size() - 1);
+  for_each_chunk(bounds, [&](size_t t, const char *b, const char *e) {
+    unordered_map<string, uint32_t> chunk_index;
+    PointIndex points(chunk_index, chunk_names[t], true);
+    PairwiseDistance pd;
+    for_each_line(b, e, [&](const char *line, const char *eol) {
+      if (!parse_line(line, eol, false, pd)) return;
+      points.from(pd.from, pd.from_end);
+      points.to(pd.to, pd.to_end);
+    });
+  });
+  for (auto &chunk : chunk_names) {
+    for (auto &name : chunk)
+      if (index.emplace(name, names.size()).second) names.push_back(name);
+    vector<string>().swap(chunk);
+  }
+}
+
+/**
+ * \brief load the matrix by memory-mapping the file and reading it twice,
+ *        in chunks parsed in parallel; once to find the points, and again
+ *        to fill in their distances.
+ */
+void
+PairwiseDistanceLoader::load_mapped(const string &filename,
+                                    DistanceMatrix &d) const {
+  MappedFile file(filename);
+  file.advise_sequential();
+  const size_t num_chunks = std::max(this->num_threads, size_t(1));
+  const vector<const char*> bounds(chunk_bounds(file, num_chunks));
+  unordered_map<string, uint32_t> index;
+  vector<string> names;
+  find_points(bounds, index, names);
+
+  // fill in the distances. In a condensed matrix, (a, b) and (b, a) are the
+  // same entry, which two chunks mustn't set at once; so with more than one
+  // chunk, distances in the lower triangle are set in a second pass, and
+  // only where the upper triangle's are missing.
+  DistanceMatrix res(names, this->condensed, this->build_storage());
+  const bool defer_lower = this->condensed && (num_chunks > 1);
+  vector<char> has_lower(num_chunks, false);
+  auto fill = [&](const bool lower) {
+    for_each_chunk(bounds, [&](size_t t, const char *b, const char *e) {
+      if (lower && !has_lower[t]) return;
+      PointIndex points(index, names, false);
+      PairwiseDistance pd;
+      for_each_line(b, e, [&](const char *line, const char *eol) {
+        if (!parse_line(line, eol, true, pd)) return;
+        const uint32_t from = points.from(pd.from, pd.from_end);
+        const uint32_t to = points.to(pd.to, pd.to_end);
+        if (lower) {
+          if ((from > to) && !res.has(from, to)) res.set(from, to, pd.dist);
+        } else if (defer_lower && (from > to)) {
+          has_lower[t] = true;
+        } else {
+          res.set(from, to, pd.dist);
+        }
+      });
+    });
+  };
+  fill(false);
+  if (std::find(has_lower.begin(), has_lower.end(), true) != has_lower.end())
+    fill(true);
+  res.set_storage(this->storage);
+  d.swap(res);
+}
+
+/**
+ * \brief load the distances into a new tiled matrix in the named file,
+ *        rather than into memory, in blocks of rows_per_block rows (or of
+ *        about 64MB, if that's 0). The file must be a regular file. Points
+ *        are found on num_threads threads, as for a matrix in memory, but
+ *        distances are written on one, in the order the file gives them; a
+ *        file that lists each point's distances together writes the tiled
+ *        matrix a block at a time. Tiled matrices are always full, and at
+ *        single precision.
+ */
+void
+PairwiseDistanceLoader::load_tiled(const string &filename,
+                                   const string &tiled_filename,
+                                   const size_t rows_per_block) const {
+  struct stat st;
+  if ((stat(filename.c_str(), &st) != 0) || !S_ISREG(st.st_mode)) {
+    throw CognoscoError("cannot build a tiled distance matrix from " +
+                        filename + "; it is not a regular file");
+  }
+  MappedFile file(filename);
+  file.advise_sequential();
+  const size_t num_chunks = std::max(this->num_threads, size_t(1));
+  unordered_map<string, uint32_t> index;
+  vector<string> names;
+  find_points(chunk_bounds(file, num_chunks), index, names);
+
+  TiledDistanceMatrix::create(tiled_filename, names, rows_per_block);
+  TiledDistanceMatrix res(tiled_filename, 2, true);
+  PointIndex points(index, names, false);
+  PairwiseDistance pd;
+  for_each_line(file.data(), file.data() + file.size(),
+                [&](const char *line, const char *eol) {
+    if (!parse_line(line, eol, true, pd)) return;
+    const uint32_t from = points.from(pd.from, pd.from_end);
+    res.set(from, points.to(pd.to, pd.to_end), pd.dist);
+  });
+}
 
 void
 PairwiseDistanceLoader::load(const string &fn, DistanceMatrix &d) const {
+  struct stat st;
+  if ((stat(fn.c_str(), &st) == 0) && S_ISREG(st.st_mode)) {
+    this->load_mapped(fn, d);
+    return;
+  }
   std::ifstream strm(fn.c_str());
   if (!strm.good()) throw CognoscoError("Failed to open " + fn);
 
   load(strm, d);
 }
 
+/**
+ * \brief read every triple in the stream, then build the matrix once the
+ *        number of points is known.
+ */
 void
 PairwiseDistanceLoader::load(std::istream &in, DistanceMatrix &d) const {
-  d.clear();
-  string n1, n2;
-  double dist;
-  while(in.good()){
-    in >> n1 >> n2 >> dist;
-    d[std::make_pair(n1,n2)] = dist;
+  struct IndexedDistance {
+    uint32_t from;
+    uint32_t to;
+    double dist;
+  };
+  unordered_map<string, uint32_t> index;
+  vector<string> names;
+  PointIndex points(index, names, true);
+  vector<IndexedDistance> dists;
+  PairwiseDistance pd;
+  string line;
+  while (getline(in, line)) {
+    if (!parse_line(line.data(), line.data() + line.size(), true, pd))
+      continue;
+    IndexedDistance id;
+    id.from = points.from(pd.from, pd.from_end);
+    id.to = points.to(pd.to, pd.to_end);
+    id.dist = pd.dist;
+    dists.push_back(id);
   }
+
+  DistanceMatrix res(names, this->condensed, this->build_storage());
+  for (auto &id : dists) res.set(id.from, id.to, id.dist);
+  vector<IndexedDistance>().swap(dists);
+  res.set_storage(this->storage);
+  d.swap(res);
 }
@@ -29,10 +29,56 @@
 // Cognosco includes
 #include "DistanceMatrix.hpp"
 
+/**
+ * \brief Loads a distance matrix from a text file of triples, one per line,
+ *        each giving the names of two points and the distance from the
+ *        first to the second, separated by whitespace. The matrix has a
+ *        point for every name in the file, in order of first appearance;
+ *        pairs the file doesn't give are missing. If a pair is given more
+ *        than once, the last distance is used when loading on one thread; on
+ *        several, which one is used is unspecified.
+ *
+ *        The matrix is full unless condensed is set, in which case the
+ *        distances must be symmetric; (a, b) and (b, a) are then the same
+ *        entry, and a file can give either or both. If it gives both and is
+ *        loaded on several threads, the one from the point that comes first
+ *        is used. Distances are read at double precision if that's the
+ *        storage asked for, and at single precision otherwise, and quantized
+ *        once they're all loaded.
+
+ *        Regular files are memory-mapped and read in two passes over
+ *        line-aligned chunks, on num_threads threads: the first finds the
+ *        points, so the matrix can be allocated, and the second writes each
+ *        distance straight into it. Files normally list each point's
+ *        distances together, to the other points in the same order each
+ *        time, so names are compared with the previous line's before the
+ *        dictionary of points is searched. Other files, and streams, are
+ *        read a line at a time, keeping the distances until the number of
+ *        points is known. Regular files can also be loaded into a
+ *        TiledDistanceMatrix on disk, for matrices too large for memory.
+ */
 class PairwiseDistanceLoader {
 public:
+  explicit PairwiseDistanceLoader(
+      const size_t num_threads=1, const bool condensed=false,
+      const NumericStorage &storage=DOUBLE_STORAGE) :
+    num_threads(num_threads), condensed(condensed), storage(storage) {}
+
   void load(const std::string &filename, DistanceMatrix &d)  const;
   void load(std::istream &in, DistanceMatrix &d) const;
+  void load_tiled(const std::string &filename,
+                  const std::string &tiled_filename,
+                  const size_t rows_per_block=0) const;
+private:
+  size_t num_threads;
+  bool condensed;
+  NumericStorage storage;
+
+  NumericStorage build_storage() const {
+    return (this->storage == DOUBLE_STORAGE) ? DOUBLE_STORAGE : FLOAT_STORAGE;
+  }
+
+  void load_mapped(const std::string &filename, DistanceMatrix &d) const;
 };
 
 #endif
@@ -0,0 +1,383 @@
+/* The following applys to this software package and all subparts therein
+ *
+ * Cognosco Copyright (C) 2015 Philip J. Uren
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or (at
+ * your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+// stl includes
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <memory>
+#include <limits>
+#include <algorithm>
+#include <cstring>
+#include <cstdint>
+#include <cstdio>
+#include <cerrno>
+
+// system includes
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+// local Cognosco includes
+#include "TiledDistanceMatrix.hpp"
+#include "CognoscoError.hpp"
+
+// bring these into the local namespace
+using std::string;
+using std::vector;
+using std::shared_ptr;
+
+/*****************************************************************************
+ *                              FILE LAYOUT                                  *
+ *****************************************************************************/
+
+static const char TILES_MAGIC[8] = {'C', 'O', 'G', 'T', 'I', 'L', 'E', '\0'};
+static const uint32_t TILES_VERSION = 1;
+static const uint32_t TILES_BYTE_ORDER = 0x01020304;
+// blocks are mapped individually, so must start on a page boundary; this is
+// a multiple of every page size in use
+static const size_t TILES_BLOCK_ALIGNMENT = 65536;
+static const size_t DEFAULT_BLOCK_SIZE = 64 << 20;
+
+struct TilesHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t byte_order;
+  uint64_t num_points;
+  uint64_t rows_per_block;
+  uint64_t block_stride;
+  uint64_t data_offset;
+};
+
+static size_t
+align(const size_t n, const size_t alignment) {
+  return (n + alignment - 1) / alignment * alignment;
+}
+
+/**
+ * \brief read and check the header of a tiled file.
+ * \return false if the file isn't a tiled matrix at all.
+ */
+static bool
+read_header(std::istream &in, TilesHeader &header) {
+  in.read(reinterpret_cast<char*>(&header), sizeof(header));
+  return in.good() &&
+    (memcmp(header.magic, TILES_MAGIC, sizeof(TILES_MAGIC)) == 0);
+}
+
+static void
+check_header(const TilesHeader &header, const string &filename) {
+  if (header.byte_order != TILES_BYTE_ORDER) {
+    throw CognoscoError("cannot load tiled distance matrix " + filename +
+                        "; it was written on a machine with a different "
+                        "byte order");
+  }
+  if (header.version != TILES_VERSION) {
+    std::stringstream ss;
+    ss << "cannot load tiled distance matrix " << filename << "; unsupported "
+       << "version " << header.version;
+    throw CognoscoError(ss.str());
+  }
+  if ((header.rows_per_block == 0) ||
+      (header.data_offset % TILES_BLOCK_ALIGNMENT != 0) ||
+      (header.block_stride % TILES_BLOCK_ALIGNMENT != 0) ||
+      (header.block_stride / sizeof(float) / header.rows_per_block <
+       header.num_points)) {
+    throw CognoscoError("corrupt tiled distance matrix " + filename +
+                        "; bad block layout");
+  }
+}
+
+
+/*****************************************************************************
+ *                                  BLOCKS                                   *
+ *****************************************************************************/
+
+TiledDistanceMatrix::Block::Block(float *values, const size_t length,
+                                  const size_t first_row,
+                                  const size_t num_rows,
+                                  const size_t row_length) :
+  values(values), length(length), first_row(first_row), num_rows(num_rows),
+  row_length(row_length) {}
+
+TiledDistanceMatrix::Block::~Block() {
+  munmap(this->values, this->length);
+}
+
+
+/*****************************************************************************
+ *                       CONSTRUCTORS AND DESTRUCTORS                        *
+ *****************************************************************************/
+
+/**
+ * \brief open a tiled matrix, keeping at most cache_blocks blocks mapped at
+ *        once. If writable is set, distances can be set, and are written
+ *        back to the file.
+ */
+TiledDistanceMatrix::TiledDistanceMatrix(const string &filename,
+                                         const size_t cache_blocks,
+                                         const bool writable) :
+  filename(filename), fd(-1), writable(writable), rows_per_block(1),
+  block_stride(0), data_offset(0),
+  cache_blocks(std::max(cache_blocks, size_t(1))) {
+  std::ifstream strm(filename.c_str(), std::ios::binary);
+  TilesHeader header;
+  if (!read_header(strm, header))
+    throw CognoscoError("not a tiled distance matrix: " + filename);
+  check_header(header, filename);
+  this->rows_per_block = header.rows_per_block;
+  this->block_stride = header.block_stride;
+  this->data_offset = header.data_offset;
+
+  // the names follow the header, each preceded by its length
+  for (uint64_t i = 0; i < header.num_points; ++i) {
+    uint64_t n;
+    strm.read(reinterpret_cast<char*>(&n), sizeof(n));
+    if (!strm.good() || (n > header.data_offset)) {
+      throw CognoscoError("corrupt tiled distance matrix " + filename +
+                          "; file is truncated");
+    }
+    string name(n, '\0');
+    strm.read(&name[0], n);
+    this->names.push_back(name);
+    if (!this->index.emplace(name, i).second) {
+      throw CognoscoError("duplicate point in tiled distance matrix: " +
+                          name);
+    }
+  }
+  if (!strm.good() || (static_cast<size_t>(strm.tellg()) > this->data_offset))
+    throw CognoscoError("corrupt tiled distance matrix " + filename +
+                        "; file is truncated");
+
+  this->fd = open(filename.c_str(), writable ? O_RDWR : O_RDONLY);
+  if (this->fd < 0) {
+    throw CognoscoError("failed to open file: " + filename + " (" +
+                        strerror(errno) + ")");
+  }
+  struct stat st;
+  if ((fstat(this->fd, &st) != 0) || (static_cast<size_t>(st.st_size) <
+      this->data_offset + this->num_blocks() * this->block_stride)) {
+    close(this->fd);
+    throw CognoscoError("corrupt tiled distance matrix " + filename +
+                        "; file is truncated");
+  }
+}
+
+TiledDistanceMatrix::~TiledDistanceMatrix() {
+  // blocks still referred to elsewhere stay mapped after the file is closed
+  this->cache.clear();
+  close(this->fd);
+}
+
+/**
+ * \brief create a tiled matrix between the named points, with every
+ *        distance missing, in blocks of rows_per_block rows; if that's 0,
+ *        blocks hold as many rows as fit in about 64MB. The file is written
+ *        to a temporary file that replaces the named one once it's
+ *        complete.
+ */
+void
+TiledDistanceMatrix::create(const string &filename,
+                            const vector<string> &names,
+                            const size_t rows_per_block) {
+  const string tmp_fn(filename + ".tmp");
+  std::ofstream strm(tmp_fn.c_str(), std::ios::binary | std::ios::trunc);
+  if (!strm.good())
+    throw CognoscoError("failed to open file for writing: " + tmp_fn);
+
+  const size_t n = names.size();
+  TilesHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, TILES_MAGIC, sizeof(TILES_MAGIC));
+  header.version = TILES_VERSION;
+  header.byte_order = TILES_BYTE_ORDER;
+  header.num_points = n;
+  header.rows_per_block = rows_per_block;
+  if (rows_per_block == 0) {
+    header.rows_per_block =
+      std::max(DEFAULT_BLOCK_SIZE / std::max(n * sizeof(float), size_t(1)),
+               size_t(1));
+  }
+  header.block_stride = std::max(
+    align(header.rows_per_block * n * sizeof(float), TILES_BLOCK_ALIGNMENT),
+    TILES_BLOCK_ALIGNMENT);
+  size_t pos = sizeof(header);
+  for (auto &name : names) pos += sizeof(uint64_t) + name.size();
+  header.data_offset = align(pos, TILES_BLOCK_ALIGNMENT);
+
+  strm.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  for (auto &name : names) {
+    const uint64_t len = name.size();
+    strm.write(reinterpret_cast<const char*>(&len), sizeof(len));
+    strm.write(name.data(), len);
+  }
+  const vector<char> zeros(TILES_BLOCK_ALIGNMENT, 0);
+  strm.write(zeros.data(), header.data_offset - pos);
+
+  // every row starts out missing; the padding after each block is zeros
+  const vector<float> missing(n, std::numeric_limits<float>::quiet_NaN());
+  for (size_t first = 0; first < n; first += header.rows_per_block) {
+    const size_t rows = std::min(header.rows_per_block, n - first);
+    for (size_t r = 0; r < rows; ++r) {
+      strm.write(reinterpret_cast<const char*>(missing.data()),
+                 n * sizeof(float));
+    }
+    size_t pad = header.block_stride - rows * n * sizeof(float);
+    for (; pad > 0; pad -= std::min(pad, zeros.size()))
+      strm.write(zeros.data(), std::min(pad, zeros.size()));
+  }
+
+  strm.close();
+  if (strm.fail()) {
+    std::remove(tmp_fn.c_str());
+    throw CognoscoError("failed to write tiled distance matrix " + filename);
+  }
+  if (std::rename(tmp_fn.c_str(), filename.c_str()) != 0) {
+    std::remove(tmp_fn.c_str());
+    throw CognoscoError("failed to write tiled distance matrix " + filename);
+  }
+}
+
+
+/*****************************************************************************
+ *                                INSPECTORS                                 *
+ *****************************************************************************/
+
+/**
+ * \brief find the index of the named point.
+ * \return false if there's no such point.
+ */
+bool
+TiledDistanceMatrix::find_index(const string &name, size_t &i) const {
+  auto it = this->index.find(name);
+  if (it == this->index.end()) return false;
+  i = it->second;
+  return true;
+}
+
+/**
+ * \brief get the index of the named point, which must be in the matrix.
+ */
+size_t
+TiledDistanceMatrix::get_index(const string &name) const {
+  size_t i;
+  if (!this->find_index(name, i))
+    throw CognoscoError("no such point in distance matrix: " + name);
+  return i;
+}
+
+size_t
+TiledDistanceMatrix::num_blocks() const {
+  return (this->size() + this->rows_per_block - 1) / this->rows_per_block;
+}
+
+/**
+ * \brief get block b, mapping it if it isn't in the cache; this makes it the
+ *        most recently used block, and unmaps the least recently used if
+ *        the cache is full. The block stays mapped for as long as the
+ *        pointer returned (or a copy of it) is held, even once it's left the
+ *        cache.
+ */
+shared_ptr<const TiledDistanceMatrix::Block>
+TiledDistanceMatrix::get_block(const size_t b) const {
+  auto it = this->cache.find(b);
+  if (it != this->cache.end()) {
+    this->lru.splice(this->lru.begin(), this->lru, it->second.second);
+    return it->second.first;
+  }
+
+  shared_ptr<const Block> block(this->map_block(b));
+  if (this->cache.size() >= this->cache_blocks) {
+    this->cache.erase(this->lru.back());
+    this->lru.pop_back();
+  }
+  this->lru.push_front(b);
+  this->cache.emplace(b, CacheEntry(block, this->lru.begin()));
+  return block;
+}
+
+/**
+ * \brief get the distance from point i to point j; NaN if it's missing.
+ */
+double
+TiledDistanceMatrix::get(const size_t i, const size_t j) const {
+  return this->get_block(i / this->rows_per_block)->row(i)[j];
+}
+
+/**
+ * \brief check whether the named file is a tiled distance matrix (of any
+ *        version), by looking at its first few bytes.
+ */
+bool
+TiledDistanceMatrix::is_tiled(const string &filename) {
+  struct stat st;
+  if ((stat(filename.c_str(), &st) != 0) || !S_ISREG(st.st_mode))
+    return false;
+  std::ifstream strm(filename.c_str(), std::ios::binary);
+  TilesHeader header;
+  return read_header(strm, header);
+}
+
+/**
+ * \brief map block b of the file, asking the kernel to start reading it in.
+ */
+shared_ptr<const TiledDistanceMatrix::Block>
+TiledDistanceMatrix::map_block(const size_t b) const {
+  if (b >= this->num_blocks()) {
+    std::stringstream ss;
+    ss << "no such block in tiled distance matrix " << this->filename << ": "
+       << b;
+    throw CognoscoError(ss.str());
+  }
+  const int prot = this->writable ? (PROT_READ | PROT_WRITE) : PROT_READ;
+  const int flags = this->writable ? MAP_SHARED : MAP_PRIVATE;
+  void *res = mmap(NULL, this->block_stride, prot, flags, this->fd,
+                   this->data_offset + b * this->block_stride);
+  if (res == MAP_FAILED) {
+    throw CognoscoError("failed to map file: " + this->filename + " (" +
+                        strerror(errno) + ")");
+  }
+  madvise(res, this->block_stride, MADV_WILLNEED);
+  const size_t first_row = b * this->rows_per_block;
+  return shared_ptr<const Block>(
+    new Block(static_cast<float*>(res), this->block_stride, first_row,
+              std::min(this->rows_per_block, this->size() - first_row),
+              this->size()));
+}
+
+
+/*****************************************************************************
+ *                                 MUTATORS                                  *
+ *****************************************************************************/
+
+/**
+ * \brief set the distance from point i to point j. The matrix must have
+ *        been opened for writing.
+ */
+void
+TiledDistanceMatrix::set(const size_t i, const size_t j, const double dist) {
+  if (!this->writable) {
+    throw CognoscoError("cannot set distances in tiled distance matrix " +
+                        this->filename + "; it was opened read-only");
+  }
+  shared_ptr<const Block> block(this->get_block(i / this->rows_per_block));
+  block->values[(i - block->first_row) * block->row_length + j] = dist;
+}
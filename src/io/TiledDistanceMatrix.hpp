@@ -0,0 +1,130 @@
+/* The following applys to this software package and all subparts therein
+ *
+ * Cognosco Copyright (C) 2015 Philip J. Uren
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or (at
+ * your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef TILED_DISTANCE_MATRIX_HPP_
+#define TILED_DISTANCE_MATRIX_HPP_
+
+// stl includes
+#include <string>
+#include <vector>
+#include <list>
+#include <unordered_map>
+#include <memory>
+
+/**
+ * \brief A full matrix of distances between a fixed set of named points,
+ *        held in a file rather than in memory, for matrices too large to fit
+ *        there. The file holds the distances at single precision, in
+ *        fixed-size blocks of consecutive rows; row i holds the distances
+ *        from point i to every point. Blocks are memory-mapped as they're
+ *        needed, and a fixed number of them are kept mapped in a
+ *        least-recently-used cache, so memory use is bounded by the size of
+ *        the cache however large the matrix. Reading rows in order reads
+ *        the file sequentially; each block is mapped once.
+ *
+ *        Points are numbered from 0 in the order their names were given,
+ *        as in a DistanceMatrix. Entries that have never been set are
+ *        missing, and are NaN. The file is created with every distance
+ *        missing, and distances can only be set if it's opened for writing.
+ *        Values are stored in the byte order of the machine that wrote the
+ *        file, and only machines with the same byte order can read it.
+ *
+ *        The layout is a header (magic, version, byte order mark, number of
+ *        points, rows per block, the space each block takes and the offset
+ *        of the first) followed by the name of each point, then the blocks,
+ *        each starting on a 64KB boundary so it can be mapped on its own.
+ *
+ *        The cache is not safe to use from more than one thread at once.
+ */
+class TiledDistanceMatrix {
+public:
+  /**
+   * \brief a block of rows, mapped for as long as the block is referred to.
+   */
+  class Block {
+  public:
+    Block(float *values, const size_t length, const size_t first_row,
+          const size_t num_rows, const size_t row_length);
+    Block(const Block &) = delete;
+    Block& operator=(const Block &) = delete;
+    ~Block();
+    size_t get_first_row() const { return this->first_row; }
+    size_t get_end_row() const { return this->first_row + this->num_rows; }
+    const float* row(const size_t i) const {
+      return this->values + (i - this->first_row) * this->row_length;
+    }
+  private:
+    friend class TiledDistanceMatrix;
+    float *values;
+    size_t length;
+    size_t first_row;
+    size_t num_rows;
+    size_t row_length;
+  };
+
+  // constructors and destructors
+  TiledDistanceMatrix(const std::string &filename, const size_t cache_blocks,
+                      const bool writable=false);
+  TiledDistanceMatrix(const TiledDistanceMatrix &) = delete;
+  TiledDistanceMatrix& operator=(const TiledDistanceMatrix &) = delete;
+  ~TiledDistanceMatrix();
+  static void create(const std::string &filename,
+                     const std::vector<std::string> &names,
+                     const size_t rows_per_block);
+
+  // inspectors
+  size_t size() const { return this->names.size(); }
+  const std::vector<std::string>& get_names() const { return this->names; }
+  const std::string& get_name(const size_t i) const { return this->names[i]; }
+  bool find_index(const std::string &name, size_t &i) const;
+  size_t get_index(const std::string &name) const;
+  size_t get_rows_per_block() const { return this->rows_per_block; }
+  size_t num_blocks() const;
+  std::shared_ptr<const Block> get_block(const size_t b) const;
+  double get(const size_t i, const size_t j) const;
+  static bool is_tiled(const std::string &filename);
+
+  // mutators
+  void set(const size_t i, const size_t j, const double dist);
+
+private:
+  typedef std::pair<std::shared_ptr<const Block>,
+                    std::list<size_t>::iterator> CacheEntry;
+
+  // private instance variables
+  std::string filename;
+  int fd;
+  bool writable;
+  std::vector<std::string> names;
+  std::unordered_map<std::string, size_t> index;
+  size_t rows_per_block;
+  size_t block_stride;
+  size_t data_offset;
+  size_t cache_blocks;
+
+  // the cache; blocks in order of use, most recent first, and the mapped
+  // blocks by number
+  mutable std::list<size_t> lru;
+  mutable std::unordered_map<size_t, CacheEntry> cache;
+
+  // private inspectors
+  std::shared_ptr<const Block> map_block(const size_t b) const;
+};
+
+#endif
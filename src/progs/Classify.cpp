@@ -25,11 +25,17 @@
 
 // local Cognosco includes -- core
 #include "Dataset.hpp"
+#include "DatasetView.hpp"
 #include "CognoscoError.hpp"
 // local Cognosco includes -- ui
 #include "CLI.hpp"
 // local Cognosco includes -- io
 #include "CSVLoader.hpp"
+#include "DatasetSnapshot.hpp"
+#include "CSVBatchReader.hpp"
+#include "ArffLoader.hpp"
+#include "LibSVMLoader.hpp"
+#include "MappedFile.hpp"
 // local Cognosco includes -- classifiers
 #include "NaiveBayes.hpp"
 #include "KMedoidsClassifier.hpp"
@@ -89,7 +95,7 @@ output_classification(const Instance &inst, const Classifier &clsfr,
                       const set<string> &exclude_atts) {
   for (size_t j = 0; j < att_names.size(); j++) {
     if (j != 0) cout << "\t";
-    cout << inst.get_att_occurrence(att_names[j])->to_string();
+    cout << inst.get_att_occurrence(att_names[j]).to_string();
   }
   cout << "\t" << clsfr.class_probability(inst, pos_class_val,
                                           exclude_atts) << endl;
@@ -111,6 +117,120 @@ output_classification(const Dataset &d, const Classifier &clsfr,
 }
 
 
+/**
+ * \brief output the classification of every instance read by a batch
+ *        reader, one batch at a time.
+ */
+static void
+output_classification(CSVBatchReader &reader, const Classifier &clsfr,
+                      const string &pos_class_val,
+                      const set<string> &exclude_atts) {
+  Dataset batch;
+  while (reader.next(batch))
+    output_classification(batch, clsfr, pos_class_val, exclude_atts);
+}
+
+
+/*****************************************************************************
+ *                                 LOADING                                   *
+ *****************************************************************************/
+
+/**
+ * \brief restrict a loader to the given columns to load, or else to all but
+ *        the given columns to drop. Columns are given by name, or by
+ *        position if all digits.
+ */
+static void
+select_columns(CSVLoader &loader, const set<string> &load_atts,
+               const set<string> &drop_atts) {
+  if (!load_atts.empty() && !drop_atts.empty())
+    throw CognoscoError("cannot give both columns to load and to drop");
+  const set<string> &cols = load_atts.empty() ? drop_atts : load_atts;
+  if (cols.empty()) return;
+  set<string> names;
+  set<size_t> indexes;
+  for (auto &col : cols) {
+    if (col.empty()) continue;
+    if (col.find_first_not_of("0123456789") == string::npos)
+      indexes.insert(strtoul(col.c_str(), NULL, 10));
+    else
+      names.insert(col);
+  }
+  if (load_atts.empty()) loader.exclude_columns(names, indexes);
+  else loader.include_columns(names, indexes);
+}
+
+/**
+ * \brief check whether a snapshot of a dataset can stand in for the file it
+ *        was taken from; it must have been written after the file was last
+ *        modified, and hold numeric values at the requested precision.
+ */
+static bool
+snapshot_is_current(const string &fn, const string &snapshot_fn,
+                    const NumericStorage &storage) {
+  if (!modified_after(snapshot_fn, fn) ||
+      !SnapshotLoader::is_snapshot(snapshot_fn))
+    return false;
+  try {
+    return SnapshotLoader::get_numeric_storage(snapshot_fn) == storage;
+  } catch (const CognoscoError &e) {
+    return false;
+  }
+}
+
+/**
+ * \brief load a dataset, storing its numeric values at the given precision.
+ *        Quantized datasets are loaded at single precision and quantized
+ *        once all of their values are known. The file can be a dataset
+ *        snapshot, an ARFF file (named .arff) or a LIBSVM file (named
+ *        .libsvm, .svm or .svmlight) instead of CSV; LIBSVM files are given
+ *        at least num_features features. If use_snapshot is set, a snapshot
+ *        of a text file is kept alongside it and loaded in place of it on
+ *        later runs, for as long as it stays current.
+ */
+static void
+load_dataset(const CSVLoader &loader, const string &fn, Dataset &d,
+             const NumericStorage &storage, const bool use_snapshot,
+             const bool VERBOSE, const size_t num_features=0) {
+  if (SnapshotLoader::is_snapshot(fn)) {
+    SnapshotLoader().load(fn, d, VERBOSE);
+    d.set_numeric_storage(storage);
+    return;
+  }
+
+  const string snapshot_fn(fn + ".snapshot");
+  if (use_snapshot && snapshot_is_current(fn, snapshot_fn, storage)) {
+    SnapshotLoader().load(snapshot_fn, d, VERBOSE);
+    return;
+  }
+
+  if (storage == DOUBLE_STORAGE) d.set_numeric_storage(DOUBLE_STORAGE);
+  else d.set_numeric_storage(FLOAT_STORAGE);
+  if (ArffLoader::is_arff(fn)) ArffLoader().load(fn, d, VERBOSE);
+  else if (LibSVMLoader::is_libsvm(fn))
+    LibSVMLoader(num_features).load(fn, d, VERBOSE);
+  else loader.load(fn, d, VERBOSE);
+  d.set_numeric_storage(storage);
+  if (use_snapshot) {
+    SnapshotWriter().write(d, snapshot_fn);
+    if (VERBOSE) cerr << "wrote dataset snapshot to " << snapshot_fn << endl;
+  }
+}
+
+/**
+ * \brief write a dataset, as loaded, to the named LIBSVM file with the
+ *        class attribute as each line's label. Every other attribute
+ *        becomes a feature, so must be numeric; the columns loaded can be
+ *        chosen to make that so.
+ */
+static void
+write_libsvm(const Dataset &d, const string &class_label, const string &fn,
+             const bool VERBOSE) {
+  LibSVMWriter(class_label).write(d, fn);
+  if (VERBOSE) cerr << "wrote LIBSVM file " << fn << endl;
+}
+
+
 /*****************************************************************************
  *                             CROSS-VALIDATION                              *
  *****************************************************************************/
@@ -151,14 +271,15 @@ k_fold_cross_validation(Classifier *clsfr, const Dataset &d,
     set<string> exclude_atts_expanded(exclude_atts.begin(), exclude_atts.end());
     if (!ex_atts_with_id_val.empty()) {
       for (auto e_i_it = exclude_insts.begin(); e_i_it != exclude_insts.end(); ++e_i_it) {
-        string att_val = d[*e_i_it][ex_atts_with_id_val]->to_string();
+        string att_val = d[*e_i_it][ex_atts_with_id_val].to_string();
         if (d.has_attribute(att_val)) {
           cerr << "adding " << att_val << " to excluded attributes" << endl;
           exclude_atts_expanded.insert(att_val);
         }
       }
     }
-    clsfr->learn(d, class_label, exclude_insts, exclude_atts_expanded);
+    clsfr->learn(DatasetView(d, exclude_insts), class_label,
+                 exclude_atts_expanded);
     if (VERBOSE)
       cerr << clsfr->to_string() << endl;
     for (Dataset::const_iterator inst = d.begin(); inst != d.end(); ++inst) {
@@ -194,7 +315,7 @@ leave_one_out_cross_validation(Classifier *clsfr, const Dataset &d,
   for (Dataset::const_iterator inst = d.begin(); inst != d.end(); ++inst) {
     set<string> exclude_atts_expanded(exclude_atts.begin(), exclude_atts.end());
     if (!ex_atts_with_id_val.empty()) {
-      string att_val = (*inst)[ex_atts_with_id_val]->to_string();
+      string att_val = (*inst)[ex_atts_with_id_val].to_string();
       if (d.has_attribute(att_val)) {
         cerr << "adding " << att_val << " to excluded attributes" << endl;
         exclude_atts_expanded.insert(att_val);
@@ -204,7 +325,8 @@ leave_one_out_cross_validation(Classifier *clsfr, const Dataset &d,
     set<size_t> exclude_insts;
     exclude_insts.insert(inst->get_instance_id());
     clsfr->clear();
-    clsfr->learn(d, class_label, exclude_insts, exclude_atts_expanded);
+    clsfr->learn(DatasetView(d, exclude_insts), class_label,
+                 exclude_atts_expanded);
     output_classification(*inst, *clsfr, att_names,
                           pos_class_val, exclude_atts_expanded);
   }
@@ -243,10 +365,33 @@ get_cli(const string &prog_name) {
   cli.add_stringlist_option("exclude-attributes", 'e', "do not use these "
                             "attribtues for model training; if more than one, "
                             "provide as a quoted comma-separated list", "");
+  cli.add_stringlist_option("load-attributes", 'l', "load only these "
+                            "columns from CSV input files, given by name or "
+                            "by position from 0; if more than one, provide "
+                            "as a quoted comma-separated list", "");
+  cli.add_stringlist_option("drop-attributes", 'd', "do not load these "
+                            "columns from CSV input files, given by name or "
+                            "by position from 0; if more than one, provide "
+                            "as a quoted comma-separated list", "");
+  cli.add_string_option("numeric-storage", 's', "precision to store numeric "
+                        "values at", set<string>{"double", "float",
+                        "quantized16", "quantized8"}, "double");
+  cli.add_size_option("threads", 't', "number of threads to load CSV files "
+                      "with", 1);
+  cli.add_size_option("batch-size", 'z', "score CSV test sets this many "
+                      "rows at a time, rather than loading them whole; 0 "
+                      "loads them whole", 10000);
+  cli.add_boolean_option("snapshot", 'b', "keep a binary snapshot of each "
+                         "input file alongside it, and load that instead on "
+                         "later runs unless the file has changed", false);
   cli.add_string_option("exclude-att-val", 'x', "do not use attributes "
                         "for training if their name is the same as the "
                         "value of this attribute in a held-out instance",
                         "");
+  cli.add_string_option("libsvm-output", 'o', "also write the training "
+                        "dataset, as loaded, to this LIBSVM file, labelled "
+                        "by the class attribute; every other column loaded "
+                        "must be numeric", "");
   return cli;
 }
 
@@ -255,6 +400,9 @@ main(int argc, const char* argv[]) {
   try {
     bool VERBOSE = true;
     bool whitespace_sep;
+    bool use_snapshot;
+    size_t num_threads;
+    size_t batch_size;
     string classifier;
     string cross_validation_method;
     string class_attribute_name;
@@ -262,8 +410,12 @@ main(int argc, const char* argv[]) {
     string training_dataset_fn;
     string testing_dataset_fn = "";
     set<string> exclude_atts;
+    set<string> load_atts;
+    set<string> drop_atts;
     string exclude_att_val = "";
     string misclass_matr_str;
+    string numeric_storage_str;
+    string libsvm_output_fn;
 
     // process general options/arguments from command line.
     CommandlineInterface cli (get_cli(argv[0]));
@@ -278,7 +430,14 @@ main(int argc, const char* argv[]) {
       cli.consume('w', cmdline, whitespace_sep);
       cli.consume('e', cmdline, exclude_atts);
       cli.consume('x', cmdline, exclude_att_val);
+      cli.consume('l', cmdline, load_atts);
+      cli.consume('d', cmdline, drop_atts);
       cli.consume('m', cmdline, misclass_matr_str);
+      cli.consume('s', cmdline, numeric_storage_str);
+      cli.consume('b', cmdline, use_snapshot);
+      cli.consume('t', cmdline, num_threads);
+      cli.consume('z', cmdline, batch_size);
+      cli.consume('o', cmdline, libsvm_output_fn);
       cli.consume(cmdline, 0, training_dataset_fn);
       if (cmdline.num_arguments() > 1) {
         cli.consume(cmdline, 1, testing_dataset_fn);
@@ -302,10 +461,17 @@ main(int argc, const char* argv[]) {
         cerr << "\tclasifier: " << classifier << endl;
         cerr << "\tclass_att_name: " << class_attribute_name << endl;
         cerr << "\tpos val: " << positive_class_value << endl;
+        cerr << "\tnumeric storage: " << numeric_storage_str << endl;
+        cerr << "\tuse dataset snapshots? " << use_snapshot << endl;
+        cerr << "\tloading threads: " << num_threads << endl;
+        cerr << "\ttest batch size: " << batch_size << endl;
         cerr << "\tattributes to exclude from training: "
              << join(exclude_atts, ",") << endl;
+        cerr << "\tcolumns to load: " << join(load_atts, ",") << endl;
+        cerr << "\tcolumns to drop: " << join(drop_atts, ",") << endl;
         cerr << "\ttrain fn: " << training_dataset_fn << endl;
         cerr << "\ttest fn: " << testing_dataset_fn << endl;
+        cerr << "\tLIBSVM output fn: " << libsvm_output_fn << endl;
         cerr << endl;
       }
     } catch (const OptionError &e) {
@@ -319,13 +485,24 @@ main(int argc, const char* argv[]) {
     // prepare for loading
     string sep = ",";
     if (whitespace_sep) sep = "\t";
-    CSVLoader csv_loader(sep);
+    CSVLoader csv_loader(sep, true, num_threads);
+    const NumericStorage storage(parse_numeric_storage(numeric_storage_str));
+    select_columns(csv_loader, load_atts, drop_atts);
+    if (use_snapshot && !(load_atts.empty() && drop_atts.empty())) {
+      // a snapshot would only hold this run's selection of columns
+      if (VERBOSE)
+        cerr << "not using dataset snapshots, as columns are selected" << endl;
+      use_snapshot = false;
+    }
 
 
     if (testing_dataset_fn.empty()) {
       cerr << "got here" << endl;
       Dataset d;
-      csv_loader.load(training_dataset_fn, d, VERBOSE);
+      load_dataset(csv_loader, training_dataset_fn, d, storage,
+                   use_snapshot, VERBOSE);
+      if (!libsvm_output_fn.empty())
+        write_libsvm(d, class_attribute_name, libsvm_output_fn, VERBOSE);
 
       assert(cross_validation_method == "stratified_ten_fold" ||
              cross_validation_method == "hold-one-out");
@@ -338,13 +515,36 @@ main(int argc, const char* argv[]) {
                                        positive_class_value, exclude_atts,
                                        exclude_att_val, VERBOSE);
     } else {
-      Dataset train, test;
-      csv_loader.load(training_dataset_fn, train, VERBOSE);
-      csv_loader.load(testing_dataset_fn, test, VERBOSE);
-      set<size_t> exclude_insts;
-      clsfr->learn(train, class_attribute_name, exclude_insts, exclude_atts);
+      Dataset train;
+      load_dataset(csv_loader, training_dataset_fn, train, storage,
+                   use_snapshot, VERBOSE);
+      if (!libsvm_output_fn.empty())
+        write_libsvm(train, class_attribute_name, libsvm_output_fn, VERBOSE);
+      clsfr->learn(train, class_attribute_name, exclude_atts);
       cerr << clsfr->to_string() << endl;
-      output_classification(test, *clsfr, positive_class_value, exclude_atts);
+
+      // CSV test sets are streamed in batches unless they're to be kept as
+      // snapshots; those have to be loaded whole.
+      if ((batch_size != 0) && !use_snapshot &&
+          !SnapshotLoader::is_snapshot(testing_dataset_fn) &&
+          !ArffLoader::is_arff(testing_dataset_fn) &&
+          !LibSVMLoader::is_libsvm(testing_dataset_fn)) {
+        if (VERBOSE)
+          cerr << "streaming test set from " << testing_dataset_fn << endl;
+        CSVBatchReader reader(csv_loader, testing_dataset_fn, train,
+                              batch_size);
+        output_classification(reader, *clsfr, positive_class_value,
+                              exclude_atts);
+      } else {
+        // a LIBSVM test set is given all of the training set's features,
+        // even those it has no non-zeros for
+        Dataset test;
+        load_dataset(csv_loader, testing_dataset_fn, test, storage,
+                     use_snapshot, VERBOSE,
+                     LibSVMLoader::count_features(train));
+        output_classification(test, *clsfr, positive_class_value,
+                              exclude_atts);
+      }
     }
 
     // we're done... cleanup
@@ -24,13 +24,25 @@
 #include <string>
 #include <sstream>
 #include <set>
+#include <algorithm>
 
 // local Cognosco includes
 #include "Dataset.hpp"
 #include "DistanceMatrix.hpp"
 #include "PairwiseDistanceLoader.hpp"
+#include "MatrixSnapshot.hpp"
+#include "TiledDistanceMatrix.hpp"
+#include "DistanceEngine.hpp"
+#include "CSVLoader.hpp"
+#include "ArffLoader.hpp"
+#include "LibSVMLoader.hpp"
+#include "DatasetSnapshot.hpp"
+#include "MappedFile.hpp"
 #include "CognoscoError.hpp"
+#include "StringUtils.hpp"
+#include "CLI.hpp"
 #include "KMedoids.hpp"
+#include "TiledKMedoids.hpp"
 
 // bring these into the current namespace..
 using std::cerr;
@@ -40,49 +52,283 @@ using std::string;
 using std::vector;
 using std::set;
 
+/**
+ * \brief check whether a snapshot of a distance matrix can stand in for the
+ *        file it was taken from; it must have been written after the file
+ *        was last modified, and hold the matrix in the requested layout.
+ */
+static bool
+snapshot_is_current(const string &fn, const string &snapshot_fn,
+                    const bool condensed, const NumericStorage &storage) {
+  if (!modified_after(snapshot_fn, fn) ||
+      !MatrixSnapshotLoader::is_snapshot(snapshot_fn))
+    return false;
+  try {
+    bool snapshot_condensed;
+    NumericStorage snapshot_storage;
+    MatrixSnapshotLoader::get_layout(snapshot_fn, snapshot_condensed,
+                                     snapshot_storage);
+    return (snapshot_condensed == condensed) && (snapshot_storage == storage);
+  } catch (const CognoscoError &e) {
+    return false;
+  }
+}
+
+/**
+ * \brief load a distance matrix, condensed if the distances are symmetric,
+ *        at the given storage. The file can be a matrix snapshot instead of
+ *        pairwise distances, in which case it's used as it is. If
+ *        use_snapshot is set, a snapshot of a text file is kept alongside it
+ *        and loaded in place of it on later runs, for as long as it stays
+ *        current.
+ */
+static void
+load_matrix(const string &fn, DistanceMatrix &d, const size_t num_threads,
+            const bool symmetric, const NumericStorage &storage,
+            const bool use_snapshot, const bool VERBOSE) {
+  if (MatrixSnapshotLoader::is_snapshot(fn)) {
+    MatrixSnapshotLoader().load(fn, d);
+    if (VERBOSE) cerr << "loaded matrix snapshot from " << fn << endl;
+    return;
+  }
+
+  const string snapshot_fn(fn + ".snapshot");
+  if (use_snapshot &&
+      snapshot_is_current(fn, snapshot_fn, symmetric, storage)) {
+    MatrixSnapshotLoader().load(snapshot_fn, d);
+    if (VERBOSE) cerr << "loaded matrix snapshot from " << snapshot_fn << endl;
+    return;
+  }
+
+  PairwiseDistanceLoader(num_threads, symmetric, storage).load(fn, d);
+  if (VERBOSE)
+    cerr << "loaded distances between " << d.size() << " points" << endl;
+  if (use_snapshot) {
+    MatrixSnapshotWriter().write(d, snapshot_fn);
+    if (VERBOSE) cerr << "wrote matrix snapshot to " << snapshot_fn << endl;
+  }
+}
+
+/**
+ * \brief compute a distance matrix from the numeric attributes of the
+ *        dataset in the named file, which can be a dataset snapshot, an ARFF
+ *        file, a LIBSVM file or CSV. Points are named by the values of the
+ *        name attribute, which isn't used as a coordinate, or by their row
+ *        numbers from 1 if there isn't one. Numeric names are written in as
+ *        many digits as it takes to tell them apart, as LibSVMWriter does.
+ */
+static void
+compute_matrix(const string &fn, DistanceMatrix &m,
+               const DistanceMetric &metric, const DistanceMethod &method,
+               const string &name_att, const size_t num_threads,
+               const bool symmetric, const NumericStorage &storage,
+               const bool VERBOSE) {
+  // numeric names are kept at double precision, so they're read exactly
+  Dataset d;
+  if ((storage != DOUBLE_STORAGE) && name_att.empty())
+    d.set_numeric_storage(FLOAT_STORAGE);
+  if (SnapshotLoader::is_snapshot(fn)) SnapshotLoader().load(fn, d, VERBOSE);
+  else if (ArffLoader::is_arff(fn)) ArffLoader().load(fn, d, VERBOSE);
+  else if (LibSVMLoader::is_libsvm(fn)) LibSVMLoader().load(fn, d, VERBOSE);
+  else CSVLoader(",", true, num_threads).load(fn, d, VERBOSE);
+
+  const size_t name_k = name_att.empty() ? d.num_attributes()
+                                         : d.get_attribute_index(name_att);
+  vector<size_t> attributes;
+  for (size_t k = 0; k < d.num_attributes(); ++k) {
+    if ((k != name_k) && (d.get_attribute_type(k) == NUMERIC))
+      attributes.push_back(k);
+  }
+  vector<string> names;
+  for (size_t i = 0; i < d.size(); ++i) {
+    if (name_k == d.num_attributes()) {
+      names.push_back(std::to_string(i + 1));
+    } else if (d.get_attribute_type(name_k) == NUMERIC) {
+      names.push_back(format_double(d.get_column(name_k).get_numeric(i)));
+    } else {
+      names.push_back(d.get_column(name_k).get_label(i));
+    }
+  }
+
+  DistanceEngine(metric, num_threads, symmetric, storage, method).compute(
+      d, attributes, names, m);
+  if (VERBOSE) {
+    cerr << "computed distances between " << m.size() << " points from "
+         << attributes.size() << " attributes" << endl;
+  }
+}
+
+/**
+ * \brief get the name of a tiled matrix of the distances in the named file.
+ *        A tiled file is used as it is; otherwise one is kept alongside the
+ *        file, and built from it in blocks of block_rows rows unless it's
+ *        already there and was written after the file was last modified.
+ */
+static string
+tiled_matrix(const string &fn, const size_t num_threads,
+             const size_t block_rows, const bool VERBOSE) {
+  if (TiledDistanceMatrix::is_tiled(fn)) return fn;
+  const string tiled_fn(fn + ".tiles");
+  if (modified_after(tiled_fn, fn) &&
+      TiledDistanceMatrix::is_tiled(tiled_fn))
+    return tiled_fn;
+  PairwiseDistanceLoader(num_threads).load_tiled(fn, tiled_fn, block_rows);
+  if (VERBOSE) cerr << "wrote tiled distance matrix to " << tiled_fn << endl;
+  return tiled_fn;
+}
+
+/**
+ * \brief print each instance's distance to each medoid, one instance per
+ *        line; dists holds them by instance, then medoid.
+ */
+static void
+print_distances(const vector<string> &instance_ids, const size_t k,
+                const vector<double> &dists) {
+  for (size_t i = 0; i < instance_ids.size(); ++i) {
+    cout << instance_ids[i] << "\t";
+    for (size_t j = 0; j < k; ++j) cout << dists[i * k + j] << "\t";
+    cout << endl;
+  }
+}
+
+static CommandlineInterface
+get_cli(const string &prog_name) {
+  const size_t MIN_ARGS = 2;
+  const size_t MAX_ARGS = 2;
+  CommandlineInterface cli (prog_name, "cluster the points of a distance "
+                            "matrix around num_clusters medoids",
+                            MIN_ARGS, MAX_ARGS);
+  cli.add_boolean_option("verbose", 'v', "output additional status messages "
+                         "during run to stderr", false);
+  cli.add_size_option("threads", 't', "number of threads to load or "
+                      "compute the distance matrix with", 1);
+  cli.add_string_option("metric", 'm', "the file is a dataset, not a "
+                        "distance matrix; compute the distances between its "
+                        "instances from their numeric attributes using this "
+                        "metric (euclidean, sqeuclidean, manhattan, cosine or "
+                        "pearson)", "");
+  cli.add_string_option("name-attribute", 'a', "with --metric, name points "
+                        "by this attribute rather than by row number", "");
+  cli.add_string_option("distance-method", 'g', "with --metric, compute each "
+                        "distance directly from the pair of instances, or "
+                        "from their dot product (gemm), which is much faster "
+                        "with many attributes; auto picks one",
+                        set<string>{"auto", "direct", "gemm"}, "auto");
+  cli.add_boolean_option("symmetric", 'y', "the distances are symmetric, so "
+                         "only hold one of d(a, b) and d(b, a)", false);
+  cli.add_string_option("distance-storage", 'q', "precision to store "
+                        "distances at", set<string>{"double", "float",
+                        "quantized16", "quantized8"}, "double");
+  cli.add_boolean_option("snapshot", 'b', "keep a binary snapshot of the "
+                         "distance matrix alongside it, and load that instead "
+                         "on later runs unless the file has changed", false);
+  cli.add_boolean_option("tiled", 'l', "hold the distance matrix on disk "
+                         "rather than in memory, in a tiled file kept "
+                         "alongside it, and used instead on later runs "
+                         "unless the file has changed", false);
+  cli.add_size_option("block-rows", 'n', "rows in each block of a tiled "
+                      "distance matrix; 0 picks blocks of about 64MB", 0);
+  cli.add_size_option("cache-blocks", 'c', "blocks of a tiled distance "
+                      "matrix to keep in memory at once", 16);
+  cli.add_boolean_option("swap", 's', "improve the initial medoids by "
+                         "swapping them with other points for as long as "
+                         "that lowers the cost", false);
+  return cli;
+}
+
 int
 main(int argc, const char* argv[]) {
   try {
-    if (argc != 3) {
-      cout << "USAGE: ./cluster num_clusters distance_matrix.dat" << endl;
-    } else {
-      // get k
-      int k;
-      try {
-        k = std::stoi(argv[1]);
-      } catch (const std::invalid_argument &e) {
-        std::stringstream ss;
-        ss << "not a valid value for number of clusters: " << argv[2] << endl;
-        throw CognoscoError(ss.str());
-      }
+    bool VERBOSE;
+    bool use_snapshot;
+    bool symmetric;
+    bool tiled;
+    bool swap;
+    size_t num_threads;
+    size_t block_rows;
+    size_t cache_blocks;
+    string storage_str;
+    string metric_str;
+    string name_att;
+    string method_str;
+    string k_str;
+    string matrix_fn;
 
-      // load distance matrix
-      DistanceMatrix d;
-      PairwiseDistanceLoader loader;
-      loader.load(argv[2], d);
+    CommandlineInterface cli (get_cli(argv[0]));
+    Commandline cmdline (argc, argv);
+    try {
+      cli.consume('v', cmdline, VERBOSE);
+      cli.consume('t', cmdline, num_threads);
+      cli.consume('y', cmdline, symmetric);
+      cli.consume('q', cmdline, storage_str);
+      cli.consume('m', cmdline, metric_str);
+      cli.consume('a', cmdline, name_att);
+      cli.consume('g', cmdline, method_str);
+      cli.consume('b', cmdline, use_snapshot);
+      cli.consume('l', cmdline, tiled);
+      cli.consume('n', cmdline, block_rows);
+      cli.consume('c', cmdline, cache_blocks);
+      cli.consume('s', cmdline, swap);
+      cli.consume(cmdline, 0, k_str);
+      cli.consume(cmdline, 1, matrix_fn);
+    } catch (const OptionError &e) {
+      cerr << e.what() << endl << endl;
+      cerr << cli.usage() << endl << endl;
+      return EXIT_FAILURE;
+    }
 
-      set<string> instance_ids_s;
+    // get k
+    int k;
+    try {
+      k = std::stoi(k_str);
+    } catch (const std::invalid_argument &e) {
+      std::stringstream ss;
+      ss << "not a valid value for number of clusters: " << k_str << endl;
+      throw CognoscoError(ss.str());
+    }
 
-      for(auto kv : d) instance_ids_s.insert(kv.first.first);
-      vector<string> instance_ids;
-      instance_ids.reserve(instance_ids_s.size());
-      for (set<string>::iterator it = instance_ids_s.begin(); it != instance_ids_s.end(); ++it) {
-        instance_ids.push_back(*it);
+    if (!metric_str.empty() && (tiled || use_snapshot)) {
+      throw CognoscoError("distances computed from a dataset are held in "
+                          "memory, not kept in a tiled file or snapshot");
+    }
+
+    if (tiled || TiledDistanceMatrix::is_tiled(matrix_fn)) {
+      // the matrix stays on disk, and is read a block of rows at a time
+      const TiledDistanceMatrix d(tiled_matrix(matrix_fn, num_threads,
+                                               block_rows, VERBOSE),
+                                  cache_blocks);
+      vector<string> instance_ids(d.get_names());
+      std::sort(instance_ids.begin(), instance_ids.end());
+
+      TiledKMedoidsClusterer clstr(k, d, instance_ids);
+      if (swap) clstr.train();
+      print_distances(instance_ids, clstr.get_medoids().size(),
+                      clstr.get_medoid_distances());
+    } else {
+      DistanceMatrix d;
+      if (!metric_str.empty()) {
+        compute_matrix(matrix_fn, d, parse_distance_metric(metric_str),
+                       parse_distance_method(method_str), name_att,
+                       num_threads, symmetric,
+                       parse_numeric_storage(storage_str), VERBOSE);
+      } else {
+        load_matrix(matrix_fn, d, num_threads, symmetric,
+                    parse_numeric_storage(storage_str), use_snapshot,
+                    VERBOSE);
       }
-      //std::cerr << "got " << instance_ids.size() << " instance ids from distance matrix" << endl;
+      vector<string> instance_ids(d.get_names());
+      std::sort(instance_ids.begin(), instance_ids.end());
 
       KMedoidsClusterer clstr(k, d, instance_ids);
-
+      if (swap) clstr.train();
       set<string> m(clstr.get_medoids());
       vector<string> medoids(m.begin(), m.end());
+      vector<double> dists;
       for (size_t i = 0; i < instance_ids.size(); ++i) {
-        cout << instance_ids[i] << "\t";
-        for (size_t j = 0; j < medoids.size(); ++j) {
-          double dist(clstr.get_distance(instance_ids[i], medoids[j]));
-          cout << dist << "\t";
-        }
-        cout << endl;
+        for (size_t j = 0; j < medoids.size(); ++j)
+          dists.push_back(clstr.get_distance(instance_ids[i], medoids[j]));
       }
+      print_distances(instance_ids, medoids.size(), dists);
     }
   } catch (const CognoscoError &e) {
     cerr << "ERROR:\t" << e.what() << endl;
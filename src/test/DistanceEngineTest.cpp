@@ -0,0 +1,172 @@
+/* The following applys to this software package and all subparts therein
+ *
+ * Cognosco Copyright (C) 2015 Philip J. Uren
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or (at
+ * your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+// stl includes
+#include <cstdlib>
+#include <cstdio>
+#include <cmath>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <random>
+#include <algorithm>
+
+// local Cognosco includes
+#include "Dataset.hpp"
+#include "DistanceMatrix.hpp"
+#include "DistanceEngine.hpp"
+#include "CSVLoader.hpp"
+#include "CognoscoError.hpp"
+
+// bring these into the current namespace..
+using std::cerr;
+using std::endl;
+using std::string;
+using std::vector;
+
+static const string CSV_FN("DistanceEngineTest.csv.tmp");
+
+// the GEMM method works in single precision from dot products, so is only
+// expected to agree with the direct method to within float rounding;
+// without its cancellation fallback, distances between near-duplicate rows
+// are far outside this.
+static const double RELATIVE_TOLERANCE = 1e-4;
+static const double ABSOLUTE_TOLERANCE = 1e-5;
+
+/**
+ * \brief write a dataset of n rows and num_atts attributes, plus a name,
+ *        with values well away from zero so dot products are large. It has
+ *        a row of zeros and a constant row (the cosine and Pearson special
+ *        cases), rows with a missing value, and rows that duplicate or
+ *        nearly duplicate earlier ones, which make the GEMM method fall
+ *        back to computing directly.
+ */
+static void
+write_dataset(const size_t n, const size_t num_atts) {
+  std::mt19937_64 rng(20151017);
+  std::normal_distribution<double> value(10, 3);
+  std::uniform_real_distribution<double> nudge(-1e-4, 1e-4);
+  vector<vector<double> > rows;
+  for (size_t i = 0; i < n; ++i) {
+    vector<double> row(num_atts);
+    if (i == 1) std::fill(row.begin(), row.end(), 0);
+    else if (i == 2) std::fill(row.begin(), row.end(), 7);
+    else if ((i > 10) && (i % 17 == 0)) row = rows[i / 2];
+    else if ((i > 10) && (i % 13 == 0)) {
+      row = rows[i - 7];
+      for (auto &v : row) v += nudge(rng);
+    } else {
+      for (auto &v : row) v = value(rng);
+    }
+    rows.push_back(row);
+  }
+
+  std::ofstream strm(CSV_FN.c_str(), std::ios::trunc);
+  strm.precision(9);
+  strm << "name";
+  for (size_t k = 0; k < num_atts; ++k) strm << ",a" << k;
+  strm << "\n";
+  for (size_t i = 0; i < n; ++i) {
+    strm << "p" << i;
+    for (size_t k = 0; k < num_atts; ++k) {
+      if ((i % 29 == 5) && (k == i % num_atts)) strm << ",nan";
+      else strm << "," << rows[i][k];
+    }
+    strm << "\n";
+  }
+}
+
+/**
+ * \brief compute the distances between the rows of the dataset by the
+ *        direct and GEMM methods, and check they agree; the same pairs
+ *        must be missing, and the rest must be equal to within tolerance.
+ * \return the number of distances that differ.
+ */
+static size_t
+compare_methods(const Dataset &d, const DistanceMetric &metric,
+                const string &metric_name, const size_t num_threads,
+                const bool condensed) {
+  vector<size_t> attributes;
+  vector<string> names;
+  for (size_t k = 1; k < d.num_attributes(); ++k) attributes.push_back(k);
+  for (size_t i = 0; i < d.size(); ++i)
+    names.push_back(d.get_column(0).get_label(i));
+
+  DistanceMatrix direct, gemm;
+  DistanceEngine(metric, num_threads, condensed, DOUBLE_STORAGE,
+                 DIRECT_METHOD).compute(d, attributes, names, direct);
+  DistanceEngine(metric, num_threads, condensed, DOUBLE_STORAGE,
+                 GEMM_METHOD).compute(d, attributes, names, gemm);
+
+  size_t failures = 0;
+  for (size_t i = 0; i < d.size(); ++i) {
+    for (size_t j = 0; j < d.size(); ++j) {
+      const double a = direct.get(i, j), b = gemm.get(i, j);
+      const bool same = (std::isnan(a) && std::isnan(b)) ||
+        (std::fabs(a - b) <= ABSOLUTE_TOLERANCE +
+         RELATIVE_TOLERANCE * std::max(std::fabs(a), std::fabs(b)));
+      if (same) continue;
+      if (failures < 10) {
+        cerr.precision(9);
+        cerr << metric_name << " distance from " << names[i] << " to "
+             << names[j] << " is " << a << " directly but " << b
+             << " by GEMM (" << num_threads << " threads"
+             << (condensed ? ", condensed)" : ")") << endl;
+      }
+      failures += 1;
+    }
+  }
+  return failures;
+}
+
+int
+main(int argc, const char* argv[]) {
+  // more rows than two GEMM tiles, and neither rows nor attributes a
+  // multiple of the micro-kernel's panel sizes
+  const size_t NUM_ROWS = 517;
+  const size_t NUM_ATTRIBUTES = 45;
+  const DistanceMetric metrics[] = {EUCLIDEAN_DISTANCE,
+                                    SQUARED_EUCLIDEAN_DISTANCE,
+                                    COSINE_DISTANCE, PEARSON_DISTANCE};
+  const char *metric_names[] = {"euclidean", "sqeuclidean", "cosine",
+                                "pearson"};
+  size_t failures = 0;
+  try {
+    write_dataset(NUM_ROWS, NUM_ATTRIBUTES);
+    Dataset d;
+    CSVLoader(",").load(CSV_FN, d);
+    for (size_t m = 0; m < 4; ++m) {
+      failures += compare_methods(d, metrics[m], metric_names[m], 1, false);
+      failures += compare_methods(d, metrics[m], metric_names[m], 3, true);
+    }
+  } catch (const CognoscoError &e) {
+    cerr << "ERROR:\t" << e.what() << endl;
+    failures += 1;
+  }
+  std::remove(CSV_FN.c_str());
+  if (failures != 0) {
+    cerr << "FAIL: GEMM and direct distances differed in " << failures
+         << " entries" << endl;
+    return EXIT_FAILURE;
+  }
+  cerr << "PASS: GEMM and direct distances agreed for every metric" << endl;
+  return EXIT_SUCCESS;
+}
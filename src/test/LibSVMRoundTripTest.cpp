@@ -0,0 +1,167 @@
+/* The following applys to this software package and all subparts therein
+ *
+ * Cognosco Copyright (C) 2015 Philip J. Uren
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or (at
+ * your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+// stl includes
+#include <cstdlib>
+#include <cstdio>
+#include <iostream>
+#include <fstream>
+#include <string>
+
+// local Cognosco includes
+#include "Dataset.hpp"
+#include "CSVLoader.hpp"
+#include "LibSVMLoader.hpp"
+#include "CognoscoError.hpp"
+
+// bring these into the current namespace..
+using std::cerr;
+using std::endl;
+using std::string;
+
+static const string CSV_FN("LibSVMRoundTripTest.csv.tmp");
+static const string IN_FN("LibSVMRoundTripTest.in.libsvm.tmp");
+static const string OUT_FN("LibSVMRoundTripTest.out.libsvm.tmp");
+
+static void
+write_file(const string &fn, const string &contents) {
+  std::ofstream strm(fn.c_str(), std::ios::trunc);
+  strm << contents;
+}
+
+/**
+ * \brief check that column k of a has the same values as column k2 of b,
+ *        to the bit for numbers.
+ * \return the number of rows that differ.
+ */
+static size_t
+compare_columns(const Dataset &a, const size_t k, const Dataset &b,
+                const size_t k2) {
+  const Column &a_col = a.get_column(k);
+  const Column &b_col = b.get_column(k2);
+  const string &name = a.get_attribute_description_ptr(k)->get_name();
+  size_t failures = 0;
+  for (size_t r = 0; r < a.size(); ++r) {
+    const bool same = (a_col.get_type() == NOMINAL) ?
+      (a_col.get_label(r) == b_col.get_label(r)) :
+      (a_col.get_numeric(r) == b_col.get_numeric(r));
+    if (!same) {
+      cerr << "attribute " << name << " differs in row " << r << endl;
+      failures += 1;
+    }
+  }
+  return failures;
+}
+
+/**
+ * \brief a CSV dataset, written as LIBSVM and loaded back, must have the
+ *        same labels and values; its features are numbered by position,
+ *        since its attribute names aren't indexes.
+ */
+static size_t
+check_csv_round_trip() {
+  write_file(CSV_FN, "a,cls,b,c\n"
+             "0.1,good,0,-1e-300\n"
+             "0.30000000000000004,poor,1.7976931348623157e308,0\n"
+             "-0,good,123456789012345678,2.2250738585072014e-308\n"
+             "3.141592653589793,poor,0,0\n");
+  Dataset csv;
+  CSVLoader(",").load(CSV_FN, csv);
+  LibSVMWriter("cls").write(csv, OUT_FN);
+  Dataset svm;
+  LibSVMLoader().load(OUT_FN, svm);
+
+  size_t failures = 0;
+  if (svm.size() != csv.size()) {
+    cerr << "CSV round trip has " << svm.size() << " rows, not "
+         << csv.size() << endl;
+    return 1;
+  }
+  failures += compare_columns(csv, csv.get_attribute_index("cls"), svm,
+                              svm.get_attribute_index(
+                                LibSVMLoader::LABEL_ATTRIBUTE));
+  const char *features[] = {"a", "b", "c"};
+  for (size_t i = 0; i < 3; ++i) {
+    failures += compare_columns(csv, csv.get_attribute_index(features[i]),
+                                svm,
+                                svm.get_attribute_index(std::to_string(i + 1)));
+  }
+  return failures;
+}
+
+/**
+ * \brief a LIBSVM file, loaded, written and loaded again, must have the same
+ *        attributes, labels, qids and values, with features keeping their
+ *        indexes.
+ */
+static size_t
+check_libsvm_round_trip() {
+  write_file(IN_FN, "# comment line\n"
+             "+1 qid:3 1:0.5 4:-2.25 # trailing comment\n"
+             "-1 qid:3 2:1e-10 3:12345678.901234567\n"
+             "\n"
+             "+1 qid:7\n"
+             "2 qid:7 4:1 7:0.1\n");
+  Dataset in;
+  LibSVMLoader().load(IN_FN, in);
+  LibSVMWriter().write(in, OUT_FN);
+  Dataset out;
+  LibSVMLoader().load(OUT_FN, out);
+
+  if ((out.size() != in.size()) ||
+      (out.num_attributes() != in.num_attributes())) {
+    cerr << "LIBSVM round trip has " << out.size() << " rows and "
+         << out.num_attributes() << " attributes, not " << in.size()
+         << " and " << in.num_attributes() << endl;
+    return 1;
+  }
+  size_t failures = 0;
+  for (size_t k = 0; k < in.num_attributes(); ++k) {
+    const string &name = in.get_attribute_description_ptr(k)->get_name();
+    if (!out.has_attribute(name)) {
+      cerr << "LIBSVM round trip lost attribute " << name << endl;
+      failures += 1;
+      continue;
+    }
+    failures += compare_columns(in, k, out, out.get_attribute_index(name));
+  }
+  return failures;
+}
+
+int
+main(int argc, const char* argv[]) {
+  size_t failures = 0;
+  try {
+    failures += check_csv_round_trip();
+    failures += check_libsvm_round_trip();
+  } catch (const CognoscoError &e) {
+    cerr << "ERROR:\t" << e.what() << endl;
+    failures += 1;
+  }
+  std::remove(CSV_FN.c_str());
+  std::remove(IN_FN.c_str());
+  std::remove(OUT_FN.c_str());
+  if (failures != 0) {
+    cerr << "FAIL: LIBSVM round trip differed in " << failures
+         << " values" << endl;
+    return EXIT_FAILURE;
+  }
+  cerr << "PASS: LIBSVM round trip kept every label and value" << endl;
+  return EXIT_SUCCESS;
+}
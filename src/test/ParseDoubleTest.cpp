@@ -0,0 +1,147 @@
+/* The following applys to this software package and all subparts therein
+ *
+ * Cognosco Copyright (C) 2015 Philip J. Uren
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or (at
+ * your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+// stl includes
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <cmath>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <random>
+
+// local Cognosco includes
+#include "StringUtils.hpp"
+
+// bring these into the current namespace..
+using std::cerr;
+using std::endl;
+using std::string;
+using std::vector;
+
+/**
+ * \brief check that parse_double gives exactly what strtod does for the
+ *        given field, both the value (to the bit, with any NaN matching any
+ *        other) and whether a number was found at all. The field is parsed
+ *        from a slice followed by more digits, so a fast path that reads
+ *        past the end of the slice is caught too.
+ * \return true if the two agree.
+ */
+static bool
+matches_strtod(const string &field) {
+  char *parsed_end;
+  const double expected = strtod(field.c_str(), &parsed_end);
+  const bool expected_ok = parsed_end != field.c_str();
+
+  const string padded(field + "9");
+  double val = 0;
+  const bool ok = parse_double(padded.data(), padded.data() + field.size(),
+                               val);
+  const bool same_val = (std::isnan(expected) && std::isnan(val)) ||
+                        (memcmp(&expected, &val, sizeof(double)) == 0);
+  if ((ok == expected_ok) && (!ok || same_val)) return true;
+  cerr.precision(17);
+  cerr << "parse_double(\"" << field << "\") gave " << val
+       << (ok ? "" : " (no number)") << "; strtod gave " << expected
+       << (expected_ok ? "" : " (no number)") << endl;
+  return false;
+}
+
+/**
+ * \brief fields at the edges of the exact fast path: mantissas either side
+ *        of 2^53, exponents either side of +/-22, signed zeros, surrounding
+ *        whitespace, and the special values that must go to strtod.
+ */
+static vector<string>
+boundary_fields() {
+  vector<string> res = {
+    "0", "-0", "+0", "0.0", "-0.0", "-0e5", "0e-30", "-.0",
+    "1", "-1", "1.5", ".5", "5.", "-.5e1",
+    "123456789012345", "1234567890123456", "12345678901234567",
+    "0.123456789012345", "0.1234567890123456", "0.12345678901234567",
+    "9007199254740991", "9007199254740992", "9007199254740993",
+    "9007199254740991e-22", "9007199254740993e-22", "900719925474099.1",
+    "9999999999999999", "99999999999999999", "9999999999999999999",
+    "12345678901234567890", "1234567890123456789012345",
+    "0.1", "0.2", "0.3", "1.7976931348623157e308", "2.2250738585072014e-308",
+    "4.9e-324", "1e308", "1e309", "1e-400",
+    "1e22", "1e23", "1e-22", "1e-23", "1e21", "1e-21",
+    "123e20", "123e21", "123e-20", "123e-21", "3.14159e22", "3.14159e-22",
+    "8.98846567431158e22", "1.5e+22", "1.5E-22", "7e-23", "7E+23",
+    " 1.5", "\t-2.5", "\n 3 ", "4.5 \t", "  -0  ", "1.5abc", "2e", "2e+",
+    "2e-x", "2E", "1,5", "1.5.5", "--1", "+-1", "-", "+", ".", "", " ",
+    "e5", "abc", "inf", "-inf", "Infinity", "INF", "nan", "-nan", "NaN",
+    "nan(123)", "0x1p3", "0X1.8p1", "0x", "1e5000", "1e-5000",
+    "00000000000000000000001", "0.00000000000000000000001",
+    "1000000000000000000000", "0.0000000000000000000001",
+    "\xc3\xa9", "1\xc3\xa9", "\xa0" "1"
+  };
+  return res;
+}
+
+/**
+ * \brief random plain decimals with 1 to 20 digits and exponents around
+ *        the fast path's limits, from a fixed seed so failures repeat.
+ */
+static vector<string>
+random_fields(const size_t n) {
+  std::mt19937_64 rng(20151017);
+  std::uniform_int_distribution<int> num_digits(1, 20);
+  std::uniform_int_distribution<int> digit(0, 9);
+  std::uniform_int_distribution<int> exponent(-26, 26);
+  std::uniform_int_distribution<int> coin(0, 3);
+  vector<string> res;
+  for (size_t i = 0; i < n; ++i) {
+    std::stringstream ss;
+    if (coin(rng) == 0) ss << '-';
+    const int digits = num_digits(rng);
+    const int point = coin(rng) == 0 ? -1 :
+      std::uniform_int_distribution<int>(0, digits)(rng);
+    for (int d = 0; d < digits; ++d) {
+      if (d == point) ss << '.';
+      ss << digit(rng);
+    }
+    if (coin(rng) != 0) ss << 'e' << exponent(rng);
+    res.push_back(ss.str());
+  }
+  return res;
+}
+
+int
+main(int argc, const char* argv[]) {
+  size_t failures = 0, checked = 0;
+  for (auto &field : boundary_fields()) {
+    failures += matches_strtod(field) ? 0 : 1;
+    checked += 1;
+  }
+  for (auto &field : random_fields(1000000)) {
+    failures += matches_strtod(field) ? 0 : 1;
+    checked += 1;
+  }
+  if (failures != 0) {
+    cerr << "FAIL: parse_double differed from strtod on " << failures
+         << " of " << checked << " fields" << endl;
+    return EXIT_FAILURE;
+  }
+  cerr << "PASS: parse_double matched strtod on " << checked << " fields"
+       << endl;
+  return EXIT_SUCCESS;
+}
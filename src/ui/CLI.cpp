@@ -380,6 +380,8 @@ Commandline::Commandline(int argc, const char* argv[]) {
       }
     }
   }
+  if (!option_name.empty())
+    op_insts.push_back(OptionInstance(option_name, "true"));
 }
 
 
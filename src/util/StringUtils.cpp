@@ -20,6 +20,11 @@
 // stl includes
 #include <string>
 #include <sstream>
+#include <cstring>
+#include <cstdlib>
+#include <cstdint>
+#include <cctype>
+#include <cstdio>
 
 // local incudes
 #include "StringUtils.hpp"
@@ -45,3 +50,118 @@ std::string
 strip(const std::string &s) {
   return rstrip(lstrip(s));
 }
+
+
+/**
+ * \brief parse a number from the start of [begin, end) with strtod. The
+ *        field is copied to a buffer on the stack first (unless it's long),
+ *        since the slice isn't NUL-terminated.
+ */
+static bool
+parse_double_strtod(const char *begin, const char *end, double &val) {
+  const size_t BUF_SIZE = 64;
+  const size_t len = end - begin;
+  char buf[BUF_SIZE];
+  std::string long_field;
+  const char *field = buf;
+  if (len < BUF_SIZE) {
+    memcpy(buf, begin, len);
+    buf[len] = '\0';
+  } else {
+    long_field.assign(begin, end);
+    field = long_field.c_str();
+  }
+  char *parsed_end;
+  val = strtod(field, &parsed_end);
+  return parsed_end != field;
+}
+
+/**
+ * \brief parse a number from the start of [begin, end), the way std::stod
+ *        does: leading whitespace is skipped and anything after the number
+ *        is ignored, but failure is reported by return value rather than by
+ *        exception. Plain decimals with at most 19 significant digits whose
+ *        value is an integer below 2^53 scaled by a power of ten no larger
+ *        than 10^22 are converted directly; both of those are exact doubles,
+ *        so one multiply or divide gives the correctly rounded result. Every
+ *        other number (more digits, large exponents, hex, inf, nan) goes to
+ *        strtod, so results are always identical to strtod's.
+ * \return false if the field doesn't start with a number.
+ */
+bool
+parse_double(const char *begin, const char *end, double &val) {
+  static const double POW10[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8,
+                                 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15,
+                                 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+  const uint64_t MAX_EXACT_MANTISSA = uint64_t(1) << 53;
+
+  const char *p = begin;
+  while ((p != end) && std::isspace(static_cast<unsigned char>(*p))) ++p;
+  const bool negative = (p != end) && (*p == '-');
+  if ((p != end) && ((*p == '-') || (*p == '+'))) ++p;
+
+  uint64_t mantissa = 0;
+  int sig_digits = 0, exp10 = 0;
+  bool any_digits = false, truncated = false;
+  for (; (p != end) && (*p >= '0') && (*p <= '9'); ++p) {
+    any_digits = true;
+    if (sig_digits < 19) {
+      mantissa = mantissa * 10 + (*p - '0');
+      if (mantissa != 0) sig_digits += 1;
+    } else {
+      exp10 += 1;
+      truncated = true;
+    }
+  }
+  if ((p != end) && (*p == '.')) {
+    for (++p; (p != end) && (*p >= '0') && (*p <= '9'); ++p) {
+      any_digits = true;
+      if (sig_digits < 19) {
+        mantissa = mantissa * 10 + (*p - '0');
+        if (mantissa != 0) sig_digits += 1;
+        exp10 -= 1;
+      } else {
+        truncated = true;
+      }
+    }
+  }
+  if ((p != end) && ((*p == 'e') || (*p == 'E'))) {
+    const char *q = p + 1;
+    const bool exp_negative = (q != end) && (*q == '-');
+    if ((q != end) && ((*q == '-') || (*q == '+'))) ++q;
+    if ((q != end) && (*q >= '0') && (*q <= '9')) {
+      int e = 0;
+      for (; (q != end) && (*q >= '0') && (*q <= '9'); ++q)
+        if (e < 10000) e = e * 10 + (*q - '0');
+      exp10 += exp_negative ? -e : e;
+      p = q;
+    }
+  }
+
+  // anything unusual -- including a number followed by letters, which
+  // might really be hex, inf or nan -- is left to strtod.
+  if (!any_digits || truncated || (mantissa > MAX_EXACT_MANTISSA) ||
+      (exp10 < -22) || (exp10 > 22) ||
+      ((p != end) && std::isalpha(static_cast<unsigned char>(*p))))
+    return parse_double_strtod(begin, end, val);
+
+  val = static_cast<double>(mantissa);
+  if (exp10 < 0) val /= POW10[-exp10];
+  else val *= POW10[exp10];
+  if (negative) val = -val;
+  return true;
+}
+
+/**
+ * \brief format a number in the fewest digits (15, or failing that 17)
+ *        that read back as the same double, so distinct values always give
+ *        distinct strings and integers are written without an exponent
+ *        unless they're very large.
+ */
+string
+format_double(const double val) {
+  char buf[32];
+  snprintf(buf, sizeof(buf), "%.15g", val);
+  if (strtod(buf, NULL) != val) snprintf(buf, sizeof(buf), "%.17g", val);
+  return buf;
+}
@@ -99,4 +99,12 @@ join(const std::set<T> &parts, const std::string &sep) {
   return res.str();
 }
 
+
+/******************************************************************************
+ *                        NUMBER PARSING AND FORMATTING                       *
+ ******************************************************************************/
+
+bool parse_double(const char *begin, const char *end, double &val);
+std::string format_double(const double val);
+
 #endif